@@ -3,14 +3,19 @@
 #include "activation.hpp"
 
 #include "item_updater.hpp"
+#include "paths.hpp"
 
 #include <phosphor-logging/elog-errors.hpp>
 #include <phosphor-logging/elog.hpp>
 #include <phosphor-logging/log.hpp>
 #include <sdbusplus/exception.hpp>
+#include <sdbusplus/message.hpp>
 #include <sdbusplus/server.hpp>
+#include <sdeventplus/event.hpp>
 #include <xyz/openbmc_project/Common/error.hpp>
 
+#include <chrono>
+#include <cstdint>
 #include <filesystem>
 
 #ifdef WANT_SIGNATURE_VERIFY
@@ -81,12 +86,29 @@ auto Activation::requestedActivation(RequestedActivations value)
         (softwareServer::Activation::requestedActivation() !=
          softwareServer::Activation::RequestedActivations::Active))
     {
+        if (parent.resetInProgress())
+        {
+            log<level::ERR>("Factory reset in progress, activation rejected",
+                            entry("VERSIONID=%s", versionId.c_str()));
+            return softwareServer::Activation::requestedActivation();
+        }
         if ((softwareServer::Activation::activation() ==
              softwareServer::Activation::Activations::Ready) ||
             (softwareServer::Activation::activation() ==
              softwareServer::Activation::Activations::Failed))
         {
-            activation(softwareServer::Activation::Activations::Activating);
+            // Content that is already installed needs no flash writes
+            if (parent.activateInstalledCopy(versionId))
+            {
+                deleteImageManagerObject();
+                softwareServer::Activation::activation(
+                    softwareServer::Activation::Activations::Active);
+            }
+            else
+            {
+                activation(
+                    softwareServer::Activation::Activations::Activating);
+            }
         }
     }
     return softwareServer::Activation::requestedActivation(value);
@@ -236,11 +258,141 @@ uint8_t RedundancyPriority::priority(uint8_t value)
     return softwareServer::RedundancyPriority::priority(value);
 }
 
+namespace
+{
+
+/** @brief How often the progress is estimated */
+constexpr auto progressInterval = std::chrono::seconds(1);
+
+/** @brief The least time between two published progress updates */
+constexpr auto publishInterval = std::chrono::seconds(5);
+
+/** @brief The progress when the stages start and when they are done */
+constexpr uint8_t progressStart = 10;
+constexpr uint8_t progressEnd = 90;
+
+} // namespace
+
+const sdbusplus::vtable::vtable_t ActivationProgress::vtable[] = {
+    sdbusplus::vtable::start(),
+    sdbusplus::vtable::property("RemainingSeconds", "t",
+                                ActivationProgress::getProperty,
+                                sdbusplus::vtable::property_::emits_change),
+    sdbusplus::vtable::end()};
+
+ActivationProgress::ActivationProgress(sdbusplus::bus::bus& bus,
+                                       const std::string& path) :
+    ActivationProgressInherit(bus, path.c_str(), action::emit_interface_added),
+    versionId(std::filesystem::path(path).filename()),
+    estimate(bus, path.c_str(), activationEstimateIntf, vtable, this),
+    timer(sdeventplus::Event(bus.get_event()), [this](auto&) { update(); })
+{
+    progress(0);
+}
+
+ActivationProgress::~ActivationProgress()
+{
+    if (model)
+    {
+        recordHistory(false);
+    }
+}
+
+void ActivationProgress::start(std::vector<ProgressStage> stages, Poll poll)
+{
+    auto now = ProgressModel::Clock::now();
+    history.emplace("Activate", versionId);
+    model.emplace(std::move(stages), restoreThroughput(), now);
+    this->poll = std::move(poll);
+    published = now;
+    progress(progressStart);
+    timer.restart(progressInterval);
+}
+
+void ActivationProgress::finish()
+{
+    timer.setEnabled(false);
+    if (model)
+    {
+        model->advance(SIZE_MAX, 0, ProgressModel::Clock::now());
+        storeThroughput(model->throughput());
+        recordHistory(true);
+        model.reset();
+    }
+    poll = {};
+    remainingSeconds = 0;
+    estimate.property_changed("RemainingSeconds");
+    progress(progressEnd);
+}
+
+void ActivationProgress::update()
+{
+    if (!model)
+    {
+        return;
+    }
+    auto now = ProgressModel::Clock::now();
+    if (poll)
+    {
+        poll(*model);
+    }
+
+    // Publish at a bounded rate, each update emits PropertiesChanged
+    if (now - published < publishInterval)
+    {
+        return;
+    }
+    published = now;
+
+    auto value = static_cast<uint8_t>(
+        progressStart + (progressEnd - progressStart) * model->fraction(now));
+    if (value > progress())
+    {
+        progress(value);
+    }
+    auto remaining = static_cast<uint64_t>(model->remaining(now).count());
+    if (remaining != remainingSeconds)
+    {
+        remainingSeconds = remaining;
+        estimate.property_changed("RemainingSeconds");
+    }
+}
+
+void ActivationProgress::recordHistory(bool success)
+{
+    if (!history)
+    {
+        return;
+    }
+    const auto& stages = model->stageList();
+    const auto& durations = model->durations();
+    for (size_t i = 0; i < stages.size(); i++)
+    {
+        history->addStage(stages[i].name, stages[i].bytes, durations[i]);
+        if (stages[i].writes && success)
+        {
+            history->addWritten(stages[i].bytes);
+        }
+    }
+    history->finish(success);
+    history.reset();
+}
+
+int ActivationProgress::getProperty(sd_bus*, const char*, const char*,
+                                    const char*, sd_bus_message* reply,
+                                    void* context, sd_bus_error*)
+{
+    auto self = static_cast<ActivationProgress*>(context);
+    auto m = sdbusplus::message::message(reply);
+    m.append(self->remainingSeconds);
+    return 1;
+}
+
 #ifdef WANT_SIGNATURE_VERIFY
 bool Activation::validateSignature(const std::string& pnorFileName)
 {
     using Signature = openpower::software::image::Signature;
-    std::filesystem::path imageDir(IMG_DIR);
+    std::filesystem::path imageDir(paths::imgDir());
 
     Signature signature(imageDir / versionId, pnorFileName,
                         PNOR_SIGNED_IMAGE_CONF_PATH);
@@ -2,17 +2,27 @@
 
 #include "config.h"
 
+#include "history.hpp"
+#include "progress.hpp"
 #include "utils.hpp"
 #include "xyz/openbmc_project/Software/ActivationProgress/server.hpp"
 #include "xyz/openbmc_project/Software/ExtendedVersion/server.hpp"
 #include "xyz/openbmc_project/Software/RedundancyPriority/server.hpp"
 
 #include <sdbusplus/server.hpp>
+#include <sdbusplus/server/interface.hpp>
+#include <sdbusplus/vtable.hpp>
+#include <sdeventplus/clock.hpp>
+#include <sdeventplus/utility/timer.hpp>
 #include <xyz/openbmc_project/Association/Definitions/server.hpp>
 #include <xyz/openbmc_project/Software/Activation/server.hpp>
 #include <xyz/openbmc_project/Software/ActivationBlocksTransition/server.hpp>
+#include <xyz/openbmc_project/State/Decorator/OperationalStatus/server.hpp>
 
+#include <functional>
+#include <optional>
 #include <string>
+#include <vector>
 
 namespace openpower
 {
@@ -34,6 +44,9 @@ using RedundancyPriorityInherit = sdbusplus::server::object::object<
     sdbusplus::xyz::openbmc_project::Software::server::RedundancyPriority>;
 using ActivationProgressInherit = sdbusplus::server::object::object<
     sdbusplus::xyz::openbmc_project::Software::server::ActivationProgress>;
+using OperationalStatusInherit = sdbusplus::server::object::object<
+    sdbusplus::xyz::openbmc_project::State::Decorator::server::
+        OperationalStatus>;
 
 constexpr auto applyTimeImmediate =
     "xyz.openbmc_project.Software.ApplyTime.RequestedApplyTimes.Immediate";
@@ -42,6 +55,9 @@ constexpr auto dbusPropIntf = "org.freedesktop.DBus.Properties";
 constexpr auto applyTimeObjPath = "/xyz/openbmc_project/software/apply_time";
 constexpr auto applyTimeProp = "RequestedApplyTime";
 
+constexpr auto activationEstimateIntf =
+    "org.open_power.Software.Host.ActivationEstimate";
+
 constexpr auto hostStateIntf = "xyz.openbmc_project.State.Host";
 constexpr auto hostStateObjPath = "/xyz/openbmc_project/state/host0";
 constexpr auto hostStateRebootProp = "RequestedHostTransition";
@@ -118,19 +134,105 @@ class ActivationBlocksTransition : public ActivationBlocksTransitionInherit
     {}
 };
 
+/** @class ActivationProgress
+ *  @brief OpenBMC ActivationProgress implementation.
+ *  @details A concrete implementation for
+ *  xyz.openbmc_project.Software.ActivationProgress DBus API. The progress
+ *  from 10 to 90 is estimated by a ProgressModel, and the time left is
+ *  published by the ActivationEstimate interface. Both are updated at most
+ *  every few seconds.
+ */
 class ActivationProgress : public ActivationProgressInherit
 {
   public:
+    /** @brief Reads the progress of the stages into the model */
+    using Poll = std::function<void(ProgressModel&)>;
+
     /** @brief Constructs ActivationProgress.
      *
      * @param[in] bus    - The Dbus bus object
      * @param[in] path   - The Dbus object path
      */
-    ActivationProgress(sdbusplus::bus::bus& bus, const std::string& path) :
-        ActivationProgressInherit(bus, path.c_str(),
-                                  action::emit_interface_added)
+    ActivationProgress(sdbusplus::bus::bus& bus, const std::string& path);
+
+    /** @brief Records an activation that did not finish as failed */
+    ~ActivationProgress();
+
+    /** @brief Start estimating the progress of the activation stages
+     *
+     * @param[in] stages - The stages of the activation, in order
+     * @param[in] poll   - Reads the progress of the stages, if they report it
+     */
+    void start(std::vector<ProgressStage> stages, Poll poll = {});
+
+    /** @brief Stop estimating and store the throughput measured by the
+     *  activation.
+     */
+    void finish();
+
+  private:
+    /** @brief Update the progress and the time left */
+    void update();
+
+    /** @brief Append the record of the activation to the history
+     *
+     *  @param[in] success - Whether the activation succeeded
+     */
+    void recordHistory(bool success);
+
+    /** @brief sd-bus property getter for the ActivationEstimate interface */
+    static int getProperty(sd_bus* bus, const char* path,
+                           const char* interface, const char* property,
+                           sd_bus_message* reply, void* context,
+                           sd_bus_error* error);
+
+    /** @brief The ActivationEstimate interface description */
+    static const sdbusplus::vtable::vtable_t vtable[];
+
+    /** @brief The version being activated */
+    std::string versionId;
+
+    /** @brief The progress model of the running stages */
+    std::optional<ProgressModel> model;
+
+    /** @brief The history record of the activation */
+    std::optional<HistoryEntry> history;
+
+    /** @brief Reads the progress of the stages */
+    Poll poll;
+
+    /** @brief The estimated seconds left */
+    uint64_t remainingSeconds = 0;
+
+    /** @brief When the progress was last published */
+    ProgressModel::Clock::time_point published;
+
+    /** @brief The ActivationEstimate interface */
+    sdbusplus::server::interface::interface estimate;
+
+    /** @brief Timer for the progress updates */
+    sdeventplus::utility::Timer<sdeventplus::ClockId::Monotonic> timer;
+};
+
+/** @class OperationalStatus
+ *  @brief OpenBMC OperationalStatus implementation.
+ *  @details A concrete implementation for
+ *  xyz.openbmc_project.State.Decorator.OperationalStatus DBus API, used to
+ *  flag an installed image that no longer matches what was activated.
+ */
+class OperationalStatus : public OperationalStatusInherit
+{
+  public:
+    /** @brief Constructs OperationalStatus.
+     *
+     * @param[in] bus    - The Dbus bus object
+     * @param[in] path   - The Dbus object path
+     */
+    OperationalStatus(sdbusplus::bus::bus& bus, const std::string& path) :
+        OperationalStatusInherit(bus, path.c_str(),
+                                 action::emit_interface_added)
     {
-        progress(0);
+        functional(false);
     }
 };
 
@@ -227,9 +329,19 @@ class Activation : public ActivationInherit
     /** @brief Persistent RedundancyPriority dbus object */
     std::unique_ptr<RedundancyPriority> redundancyPriority;
 
+    /** @brief OperationalStatus dbus object, only present once the installed
+     *  image failed integrity verification */
+    std::unique_ptr<OperationalStatus> operationalStatus;
+
     /** @brief Used to subscribe to dbus systemd signals **/
     sdbusplus::bus::match_t systemdSignals;
 
+    /**
+     * @brief Deletes the version from Image Manager and the
+     *        untar image from image upload dir.
+     */
+    void deleteImageManagerObject();
+
     /**
      * @brief Determine the configured image apply time value
      *
@@ -255,12 +367,6 @@ class Activation : public ActivationInherit
      */
     virtual void unitStateChange(sdbusplus::message::message& msg) = 0;
 
-    /**
-     * @brief Deletes the version from Image Manager and the
-     *        untar image from image upload dir.
-     */
-    void deleteImageManagerObject();
-
     /** @brief Member function for clarity & brevity at activation start */
     virtual void startActivation() = 0;
 
@@ -0,0 +1,769 @@
+#include "config.h"
+
+#include "bench.hpp"
+
+#include "flash_device.hpp"
+
+#include <fcntl.h>
+#include <linux/if_alg.h>
+#include <mtd/mtd-user.h>
+#include <mtd/ubi-user.h>
+#include <openssl/evp.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/utsname.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+namespace openpower
+{
+namespace software
+{
+namespace updater
+{
+
+namespace fs = std::filesystem;
+using json = nlohmann::json;
+using Clock = std::chrono::steady_clock;
+
+namespace
+{
+
+constexpr size_t chunkSize = 64 * 1024;
+constexpr size_t digestChunkSize = 1024 * 1024;
+constexpr size_t smallFileSize = 4096;
+constexpr auto scratchSubdir = "bench";
+constexpr auto scratchVolume = "bench-scratch";
+
+/** @brief MTD partitions that are never erased, even when named as the
+ *  scratch device.
+ */
+constexpr std::array<std::string_view, 7> protectedMtds = {
+    "pnor", "bmc", "u-boot", "u-boot-env", "kernel", "rofs", "rwfs"};
+
+#ifdef UBIFS_LAYOUT
+constexpr auto layoutName = "ubi";
+#elif defined MMC_LAYOUT
+constexpr auto layoutName = "mmc";
+#else
+constexpr auto layoutName = "static";
+#endif
+
+json skipped(const std::string& reason)
+{
+    return {{"skipped", reason}};
+}
+
+json failed(const std::string& what, int err)
+{
+    return {{"error", what + ": " + std::strerror(err)}};
+}
+
+double mibPerSecond(uint64_t bytes, Clock::duration elapsed)
+{
+    auto seconds = std::chrono::duration<double>(elapsed).count();
+    if (seconds <= 0)
+    {
+        return 0;
+    }
+    return (static_cast<double>(bytes) / (1024 * 1024)) / seconds;
+}
+
+double microseconds(Clock::duration elapsed)
+{
+    return std::chrono::duration<double, std::micro>(elapsed).count();
+}
+
+std::string readFirstLine(const fs::path& path)
+{
+    std::ifstream file(path);
+    std::string line;
+    std::getline(file, line);
+    // Device tree strings carry their terminating NUL
+    line.erase(std::find(line.begin(), line.end(), '\0'), line.end());
+    return line;
+}
+
+/** @brief Random data, so that UBIFS compression does not flatter the
+ *  write results.
+ */
+std::vector<char> patternBuffer(size_t size)
+{
+    std::vector<char> buffer(size);
+    std::mt19937 gen(size);
+    std::generate(buffer.begin(), buffer.end(),
+                  [&gen]() { return static_cast<char>(gen()); });
+    return buffer;
+}
+
+json systemInfo()
+{
+    json info;
+    struct utsname name = {};
+    if (uname(&name) == 0)
+    {
+        info["kernel"] = std::string(name.release);
+        info["arch"] = std::string(name.machine);
+    }
+    info["model"] = readFirstLine("/proc/device-tree/model");
+
+    std::ifstream osRelease("/etc/os-release");
+    std::string line;
+    while (std::getline(osRelease, line))
+    {
+        constexpr std::string_view key = "VERSION_ID=";
+        if (line.rfind(key, 0) == 0)
+        {
+            auto value = line.substr(key.size());
+            value.erase(std::remove(value.begin(), value.end(), '"'),
+                        value.end());
+            info["bmcVersion"] = value;
+        }
+    }
+    return info;
+}
+
+json measureOpensslDigest(const char* algorithm, const std::vector<char>& data,
+                          uint64_t size)
+{
+    auto md = EVP_get_digestbyname(algorithm);
+    if (md == nullptr)
+    {
+        return skipped("not available");
+    }
+
+    std::unique_ptr<EVP_MD_CTX, decltype(&::EVP_MD_CTX_free)> ctx(
+        EVP_MD_CTX_new(), ::EVP_MD_CTX_free);
+    std::array<unsigned char, EVP_MAX_MD_SIZE> digest{};
+    unsigned int digestLen = 0;
+
+    auto start = Clock::now();
+    EVP_DigestInit_ex(ctx.get(), md, nullptr);
+    for (uint64_t done = 0; done < size; done += data.size())
+    {
+        EVP_DigestUpdate(ctx.get(), data.data(), data.size());
+    }
+    EVP_DigestFinal_ex(ctx.get(), digest.data(), &digestLen);
+    return mibPerSecond(size, Clock::now() - start);
+}
+
+/** @brief Digest through the kernel crypto API, which is where a hash
+ *  engine of the BMC SoC shows up.
+ */
+json measureKernelDigest(const char* algorithm, const std::vector<char>& data,
+                         uint64_t size)
+{
+    int tfm = socket(AF_ALG, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (tfm < 0)
+    {
+        return failed("socket", errno);
+    }
+
+    struct sockaddr_alg sa = {};
+    sa.salg_family = AF_ALG;
+    strncpy(reinterpret_cast<char*>(sa.salg_type), "hash",
+            sizeof(sa.salg_type) - 1);
+    strncpy(reinterpret_cast<char*>(sa.salg_name), algorithm,
+            sizeof(sa.salg_name) - 1);
+    if (bind(tfm, reinterpret_cast<struct sockaddr*>(&sa), sizeof(sa)) != 0)
+    {
+        close(tfm);
+        return skipped("not available");
+    }
+
+    int op = accept4(tfm, nullptr, nullptr, SOCK_CLOEXEC);
+    if (op < 0)
+    {
+        auto err = errno;
+        close(tfm);
+        return failed("accept", err);
+    }
+
+    auto start = Clock::now();
+    uint64_t done = 0;
+    while (done < size)
+    {
+        auto rc = send(op, data.data(), data.size(), MSG_MORE);
+        if (rc < 0)
+        {
+            auto err = errno;
+            close(op);
+            close(tfm);
+            return failed("send", err);
+        }
+        done += rc;
+    }
+
+    // Reading the result finalizes the digest
+    std::array<unsigned char, EVP_MAX_MD_SIZE> digest{};
+    auto rc = read(op, digest.data(), digest.size());
+    auto elapsed = Clock::now() - start;
+    auto err = errno;
+    close(op);
+    close(tfm);
+    if (rc <= 0)
+    {
+        return failed("read", err);
+    }
+    return mibPerSecond(done, elapsed);
+}
+
+json measureDigests(uint64_t size)
+{
+    auto data = patternBuffer(digestChunkSize);
+    json results;
+    for (auto algorithm : {"sha256", "sha384", "sha512"})
+    {
+        results["openssl"][algorithm] =
+            measureOpensslDigest(algorithm, data, size);
+        results["kernel"][algorithm] =
+            measureKernelDigest(algorithm, data, size);
+    }
+    return results;
+}
+
+json measureRead(const fs::path& device, uint64_t size)
+{
+    int fd = open(device.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return failed("open " + device.string(), errno);
+    }
+    // Measure the device, not the page cache
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+
+    std::vector<char> buffer(chunkSize);
+    uint64_t done = 0;
+    auto start = Clock::now();
+    while (done < size)
+    {
+        auto want =
+            static_cast<size_t>(std::min<uint64_t>(buffer.size(), size - done));
+        auto rc = read(fd, buffer.data(), want);
+        if (rc < 0)
+        {
+            auto err = errno;
+            close(fd);
+            return failed("read " + device.string(), err);
+        }
+        if (rc == 0)
+        {
+            break;
+        }
+        done += rc;
+    }
+    auto elapsed = Clock::now() - start;
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+
+    return {{"device", device.string()},
+            {"bytes", done},
+            {"readMiBps", mibPerSecond(done, elapsed)}};
+}
+
+/** @brief Find the MTD device of a partition from /proc/mtd, whose lines
+ *  look like: mtd6: 04000000 00010000 "pnor"
+ */
+fs::path findMtd(const std::string& partition)
+{
+    std::ifstream mtdFile("/proc/mtd");
+    std::string line;
+    while (std::getline(mtdFile, line))
+    {
+        if (line.find("\"" + partition + "\"") != std::string::npos)
+        {
+            return fs::path("/dev") / line.substr(0, line.find(':'));
+        }
+    }
+    return {};
+}
+
+/** @brief Find a UBI volume by name
+ *
+ *  @param[in] prefix - The start of the volume name
+ *
+ *  @return The volume device, such as /dev/ubi0_3, or empty if not found
+ */
+fs::path findUbiVolume(const std::string& prefix)
+{
+    std::error_code ec;
+    for (const auto& entry : fs::directory_iterator("/sys/class/ubi", ec))
+    {
+        auto name = readFirstLine(entry.path() / "name");
+        if (!name.empty() && name.rfind(prefix, 0) == 0)
+        {
+            return fs::path("/dev") / entry.path().filename();
+        }
+    }
+    return {};
+}
+
+fs::path defaultReadDevice()
+{
+#ifdef UBIFS_LAYOUT
+    return findUbiVolume("pnor-ro-");
+#elif defined MMC_LAYOUT
+    return fs::path(MEDIA_DIR) / "hostfw" / "hostfw-a";
+#else
+    return findMtd("pnor");
+#endif
+}
+
+/** @brief Get the name of an MTD device that may be erased, empty if it is
+ *  one of the protected ones or not an MTD device.
+ */
+std::string scratchMtdName(const fs::path& device)
+{
+    auto name = readFirstLine(fs::path("/sys/class/mtd") / device.filename() /
+                              "name");
+    if (std::find(protectedMtds.begin(), protectedMtds.end(), name) !=
+        protectedMtds.end())
+    {
+        return {};
+    }
+    return name;
+}
+
+json measureMtdWrite(const fs::path& device, uint64_t size)
+{
+    auto name = scratchMtdName(device);
+    if (name.empty())
+    {
+        return {{"error", "refusing to erase " + device.string() + " (" +
+                              name + ")"}};
+    }
+
+    int fd = open(device.c_str(), O_RDWR | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return failed("open " + device.string(), errno);
+    }
+
+    mtd_info_t info = {};
+    if (ioctl(fd, MEMGETINFO, &info) != 0)
+    {
+        auto err = errno;
+        close(fd);
+        return failed("MEMGETINFO", err);
+    }
+    size = std::min<uint64_t>(size, info.size);
+    size -= size % info.erasesize;
+
+    auto start = Clock::now();
+    for (uint64_t offset = 0; offset < size; offset += info.erasesize)
+    {
+        erase_info_t erase = {};
+        erase.start = offset;
+        erase.length = info.erasesize;
+        if (ioctl(fd, MEMERASE, &erase) != 0)
+        {
+            auto err = errno;
+            close(fd);
+            return failed("MEMERASE", err);
+        }
+    }
+    auto eraseElapsed = Clock::now() - start;
+
+    auto data = patternBuffer(chunkSize);
+    start = Clock::now();
+    for (uint64_t offset = 0; offset < size; offset += data.size())
+    {
+        auto want =
+            static_cast<size_t>(std::min<uint64_t>(data.size(), size - offset));
+        if (pwrite(fd, data.data(), want, offset) != static_cast<ssize_t>(want))
+        {
+            auto err = errno;
+            close(fd);
+            return failed("write " + device.string(), err);
+        }
+    }
+    auto writeElapsed = Clock::now() - start;
+    close(fd);
+
+    auto results = measureRead(device, size);
+    results["name"] = name;
+    results["eraseMiBps"] = mibPerSecond(size, eraseElapsed);
+    results["writeMiBps"] = mibPerSecond(size, writeElapsed);
+    return results;
+}
+
+json measureImageProgram(const fs::path& image, const fs::path& device)
+{
+    std::ifstream input(image, std::ios::binary);
+    std::vector<char> data((std::istreambuf_iterator<char>(input)),
+                           std::istreambuf_iterator<char>());
+    if (data.empty())
+    {
+        return {{"error", "unable to read " + image.string()}};
+    }
+
+    // The erased pages, as checked when programming
+    constexpr size_t pageSize = 4096;
+    uint64_t erased = 0;
+    auto start = Clock::now();
+    for (size_t pos = 0; pos < data.size(); pos += pageSize)
+    {
+        auto page = std::min(pageSize, data.size() - pos);
+        if (isErased(data.data() + pos, page))
+        {
+            erased += page;
+        }
+    }
+    auto scanElapsed = Clock::now() - start;
+
+    json results = {{"image", image.string()},
+                    {"bytes", data.size()},
+                    {"erasedBytes", erased},
+                    {"scanMiBps", mibPerSecond(data.size(), scanElapsed)}};
+    if (device.empty())
+    {
+        results["program"] = skipped("no scratch MTD device given");
+        return results;
+    }
+    if (scratchMtdName(device).empty())
+    {
+        results["program"] = {{"error", "refusing to erase " +
+                                            device.string()}};
+        return results;
+    }
+
+    // Program the image, or as much as fits, with and without skipping
+    FlashDevice flash(device);
+    if (!flash)
+    {
+        results["program"] = failed("open " + device.string(), errno);
+        return results;
+    }
+    auto size = static_cast<size_t>(
+        std::min<uint64_t>(data.size(), flash.size()));
+    json program = {{"bytes", size}};
+    for (auto skip : {false, true})
+    {
+        if (!flash.erase(0, size))
+        {
+            results["program"] = failed("MEMERASE", errno);
+            return results;
+        }
+        ProgramStats stats;
+        start = Clock::now();
+        for (size_t pos = 0; pos < size; pos += chunkSize)
+        {
+            auto count = std::min(chunkSize, size - pos);
+            if (!flash.program(pos, data.data() + pos, count, stats, skip))
+            {
+                results["program"] = failed("program " + device.string(),
+                                            errno);
+                return results;
+            }
+        }
+        auto elapsed = Clock::now() - start;
+        program[skip ? "skipErased" : "full"] = {
+            {"ms", std::chrono::duration<double, std::milli>(elapsed).count()},
+            {"writtenBytes", stats.written},
+            {"skippedBytes", stats.skipped}};
+    }
+    program["savedMs"] = program["full"]["ms"].get<double>() -
+                         program["skipErased"]["ms"].get<double>();
+    results["program"] = program;
+    return results;
+}
+
+/** @brief Whether a UBI device holds the host volumes, whose names start
+ *  with pnor-
+ *
+ *  @param[in] ubi - The UBI device, such as /dev/ubi1
+ */
+bool holdsPnorVolumes(const fs::path& ubi)
+{
+    std::error_code ec;
+    auto sysfs = fs::path("/sys/class/ubi") / ubi.filename();
+    for (const auto& entry : fs::directory_iterator(sysfs, ec))
+    {
+        if ((entry.path().filename().string().rfind(
+                 ubi.filename().string() + "_", 0) == 0) &&
+            (readFirstLine(entry.path() / "name").rfind("pnor-", 0) == 0))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+json measureUbiScratch(const fs::path& ubi, uint64_t size)
+{
+    // The BMC may have UBI devices of its own, only the one holding the
+    // host volumes is written
+    if (!holdsPnorVolumes(ubi))
+    {
+        return {{"error", ubi.string() + " holds no pnor volume"}};
+    }
+
+    int fd = open(ubi.c_str(), O_RDWR | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return failed("open " + ubi.string(), errno);
+    }
+
+    struct ubi_mkvol_req req = {};
+    req.vol_id = UBI_VOL_NUM_AUTO;
+    req.alignment = 1;
+    req.bytes = size;
+    req.vol_type = UBI_DYNAMIC_VOLUME;
+    req.name_len = strlen(scratchVolume);
+    strncpy(req.name, scratchVolume, UBI_MAX_VOLUME_NAME);
+    if (ioctl(fd, UBI_IOCMKVOL, &req) != 0)
+    {
+        auto err = errno;
+        close(fd);
+        return failed("create scratch volume on " + ubi.string(), err);
+    }
+    int32_t volumeId = req.vol_id;
+    auto volume = fs::path(ubi.string() + "_" + std::to_string(volumeId));
+
+    json results;
+    auto data = patternBuffer(chunkSize);
+    int volumeFd = open(volume.c_str(), O_RDWR | O_CLOEXEC);
+    if (volumeFd < 0)
+    {
+        results = failed("open " + volume.string(), errno);
+    }
+    else
+    {
+        int64_t bytes = size;
+        auto start = Clock::now();
+        auto rc = ioctl(volumeFd, UBI_IOCVOLUP, &bytes);
+        for (uint64_t done = 0; (rc == 0) && (done < size);
+             done += data.size())
+        {
+            auto want = static_cast<size_t>(
+                std::min<uint64_t>(data.size(), size - done));
+            rc = (write(volumeFd, data.data(), want) ==
+                  static_cast<ssize_t>(want))
+                     ? 0
+                     : -1;
+        }
+        auto elapsed = Clock::now() - start;
+        auto err = errno;
+        close(volumeFd);
+
+        if (rc != 0)
+        {
+            results = failed("write " + volume.string(), err);
+        }
+        else
+        {
+            results = measureRead(volume, size);
+            results["writeMiBps"] = mibPerSecond(size, elapsed);
+        }
+    }
+
+    if (ioctl(fd, UBI_IOCRMVOL, &volumeId) != 0)
+    {
+        results["cleanupError"] = std::string(std::strerror(errno));
+    }
+    close(fd);
+    return results;
+}
+
+json measureSmallFiles(const fs::path& dir, size_t count)
+{
+    std::error_code ec;
+    fs::create_directories(dir, ec);
+    if (ec)
+    {
+        return failed("create " + dir.string(), ec.value());
+    }
+
+    auto data = patternBuffer(smallFileSize);
+    std::vector<double> latencies;
+    for (size_t i = 0; i < count; i++)
+    {
+        auto path = dir / std::to_string(i);
+        auto start = Clock::now();
+        int fd = open(path.c_str(), O_CREAT | O_WRONLY | O_TRUNC | O_CLOEXEC,
+                      0644);
+        if (fd < 0)
+        {
+            return failed("open " + path.string(), errno);
+        }
+        auto rc = write(fd, data.data(), data.size());
+        auto err = errno;
+        if ((rc == static_cast<ssize_t>(data.size())) && (fsync(fd) != 0))
+        {
+            rc = -1;
+            err = errno;
+        }
+        close(fd);
+        if (rc != static_cast<ssize_t>(data.size()))
+        {
+            return failed("write " + path.string(), err);
+        }
+        latencies.push_back(microseconds(Clock::now() - start));
+    }
+
+    if (latencies.empty())
+    {
+        return skipped("no files to write");
+    }
+    std::sort(latencies.begin(), latencies.end());
+    return {{"dir", dir.string()},
+            {"files", latencies.size()},
+            {"fileBytes", smallFileSize},
+            {"p50us", latencies[latencies.size() / 2]},
+            {"p99us", latencies[(latencies.size() * 99) / 100]},
+            {"maxus", latencies.back()}};
+}
+
+json measureCopy(const fs::path& source, const fs::path& dir)
+{
+    std::error_code ec;
+    if (!fs::is_directory(source, ec))
+    {
+        return skipped("no copy source");
+    }
+
+    std::vector<fs::path> files;
+    uint64_t bytes = 0;
+    for (const auto& entry : fs::directory_iterator(source, ec))
+    {
+        if (entry.is_regular_file(ec))
+        {
+            files.push_back(entry.path());
+            bytes += entry.file_size(ec);
+        }
+    }
+
+    // Keep a margin so the measurement never fills up the file system
+    auto space = fs::space(dir.parent_path(), ec);
+    if (ec || (space.available / 2 < bytes))
+    {
+        return skipped("not enough space to copy " + source.string());
+    }
+
+    fs::create_directories(dir, ec);
+    if (ec)
+    {
+        return failed("create " + dir.string(), ec.value());
+    }
+
+    for (const auto& file : files)
+    {
+        int fd = open(file.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd >= 0)
+        {
+            posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+            close(fd);
+        }
+    }
+
+    auto start = Clock::now();
+    for (const auto& file : files)
+    {
+        auto target = dir / file.filename();
+        fs::copy_file(file, target, ec);
+        if (ec)
+        {
+            return failed("copy " + file.string(), ec.value());
+        }
+        int fd = open(target.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd >= 0)
+        {
+            fsync(fd);
+            close(fd);
+        }
+    }
+    auto elapsed = Clock::now() - start;
+
+    return {{"source", source.string()},
+            {"files", files.size()},
+            {"bytes", bytes},
+            {"copyMiBps", mibPerSecond(bytes, elapsed)}};
+}
+
+} // namespace
+
+json runBench(const BenchOptions& options)
+{
+    uint64_t size = static_cast<uint64_t>(options.sizeMiB) * 1024 * 1024;
+
+    json report;
+    report["format"] = benchFormat;
+    report["layout"] = std::string(layoutName);
+    report["system"] = systemInfo();
+    report["sizeMiB"] = options.sizeMiB;
+    report["digest"] = measureDigests(size);
+
+    auto readDevice = options.readDevice.empty()
+                          ? defaultReadDevice()
+                          : fs::path(options.readDevice);
+    report["read"] = readDevice.empty() ? skipped("no flash device found")
+                                        : measureRead(readDevice, size);
+
+    report["mtdWrite"] = options.scratchMtd.empty()
+                             ? skipped("no scratch MTD device given")
+                             : measureMtdWrite(options.scratchMtd, size);
+
+    report["imageProgram"] =
+        options.image.empty()
+            ? skipped("no image given")
+            : measureImageProgram(options.image, options.scratchMtd);
+
+    report["ubiScratch"] =
+        options.ubiScratch.empty()
+            ? skipped("no pnor UBI device given")
+            : measureUbiScratch(options.ubiScratch, size);
+
+    // The small files and copies are only measured on a directory given, as
+    // the BMC's own filesystems would tell nothing about the host ones
+    if (options.scratchDir.empty())
+    {
+        report["smallFile"] = skipped("no scratch directory given");
+        report["copy"] = skipped("no scratch directory given");
+        return report;
+    }
+    auto scratch = fs::path(options.scratchDir) / scratchSubdir;
+    std::error_code ec;
+    if (fs::exists(scratch, ec))
+    {
+        // Never remove something this subcommand did not create
+        auto error = json{{"error", scratch.string() + " already exists"}};
+        report["smallFile"] = error;
+        report["copy"] = error;
+        return report;
+    }
+
+    report["smallFile"] = measureSmallFiles(scratch / "small",
+                                            options.smallFiles);
+
+    fs::path copySource = options.copySource;
+#ifdef MMC_LAYOUT
+    if (copySource.empty())
+    {
+        copySource = fs::path(MEDIA_DIR) / "hostfw" / "running-ro";
+    }
+#endif
+    report["copy"] = copySource.empty()
+                         ? skipped("no copy source given")
+                         : measureCopy(copySource, scratch / "copy");
+
+    fs::remove_all(scratch, ec);
+    return report;
+}
+
+} // namespace updater
+} // namespace software
+} // namespace openpower
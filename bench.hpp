@@ -0,0 +1,65 @@
+#pragma once
+
+#include <nlohmann/json.hpp>
+
+#include <cstddef>
+#include <string>
+
+namespace openpower
+{
+namespace software
+{
+namespace updater
+{
+
+/** @brief Version of the bench report layout, bumped whenever a field is
+ *  renamed or its unit changes so reports stay comparable.
+ */
+constexpr auto benchFormat = 1;
+
+/** @struct BenchOptions
+ *  @brief What the bench subcommand measures. The defaults only read from
+ *  the flash, anything destructive has to be asked for explicitly.
+ */
+struct BenchOptions
+{
+    /** @brief Number of MiB moved by each throughput measurement */
+    size_t sizeMiB = 16;
+
+    /** @brief MTD or UBI volume device to read, discovered if empty */
+    std::string readDevice;
+
+    /** @brief MTD device to erase and write, skipped if empty */
+    std::string scratchMtd;
+
+    /** @brief PNOR image scanned for erased pages, and programmed to the
+     *  scratch MTD device with and without skipping them */
+    std::string image;
+
+    /** @brief UBI device holding the host volumes, to create, write and
+     *  remove a scratch volume on, skipped if empty */
+    std::string ubiScratch;
+
+    /** @brief Directory on a host filesystem for the small file and copy
+     *  measurements, skipped if empty */
+    std::string scratchDir;
+
+    /** @brief Directory copied by the copy measurement, discovered if empty */
+    std::string copySource;
+
+    /** @brief Number of files written by the small file measurement */
+    size_t smallFiles = 64;
+};
+
+/** @brief Run the flash, digest and copy measurements
+ *
+ *  @param[in] options - What to measure
+ *
+ *  @return The report. Each measurement that could not run carries an
+ *          "error" or "skipped" member instead of its results.
+ */
+nlohmann::json runBench(const BenchOptions& options);
+
+} // namespace updater
+} // namespace software
+} // namespace openpower
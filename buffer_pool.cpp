@@ -0,0 +1,150 @@
+#include "config.h"
+
+#include "buffer_pool.hpp"
+
+#include <phosphor-logging/log.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+
+namespace openpower
+{
+namespace software
+{
+namespace updater
+{
+
+using namespace phosphor::logging;
+
+IoBuffer::IoBuffer(IoBuffer&& other) noexcept :
+    pool(other.pool), buffer(other.buffer), length(other.length)
+{
+    other.pool = nullptr;
+    other.buffer = nullptr;
+    other.length = 0;
+}
+
+IoBuffer& IoBuffer::operator=(IoBuffer&& other) noexcept
+{
+    if (this != &other)
+    {
+        reset();
+        std::swap(pool, other.pool);
+        std::swap(buffer, other.buffer);
+        std::swap(length, other.length);
+    }
+    return *this;
+}
+
+IoBuffer::~IoBuffer()
+{
+    reset();
+}
+
+void IoBuffer::reset()
+{
+    if (buffer)
+    {
+        pool->release(buffer);
+    }
+    pool = nullptr;
+    buffer = nullptr;
+    length = 0;
+}
+
+BufferPool::BufferPool(size_t bufferSize, size_t count) :
+    size((std::max<size_t>(bufferSize, 1) + alignment - 1) / alignment *
+         alignment),
+    count(std::max<size_t>(count, 1))
+{
+    buffers.reserve(this->count);
+    freeBuffers.reserve(this->count);
+}
+
+BufferPool::~BufferPool()
+{
+    for (auto buffer : buffers)
+    {
+        std::free(buffer);
+    }
+}
+
+BufferPool& BufferPool::get()
+{
+    static BufferPool pool(IO_BUFFER_SIZE * 1024, IO_BUFFER_COUNT);
+    return pool;
+}
+
+char* BufferPool::take()
+{
+    if (!freeBuffers.empty())
+    {
+        auto buffer = freeBuffers.back();
+        freeBuffers.pop_back();
+        return buffer;
+    }
+    if (buffers.size() == count)
+    {
+        return nullptr;
+    }
+
+    auto buffer = static_cast<char*>(std::aligned_alloc(alignment, size));
+    if (!buffer)
+    {
+        if (!allocationFailed)
+        {
+            log<level::ERR>("Failed to allocate an I/O buffer",
+                            entry("SIZE=%zu", size));
+            allocationFailed = true;
+        }
+        return nullptr;
+    }
+    buffers.push_back(buffer);
+    return buffer;
+}
+
+IoBuffer BufferPool::acquire()
+{
+    std::unique_lock lock(mutex);
+    char* buffer = nullptr;
+    returned.wait(lock, [this, &buffer]() {
+        buffer = take();
+        // With no buffer in use none will be returned to wait for
+        return buffer || (freeBuffers.size() == buffers.size());
+    });
+    if (!buffer)
+    {
+        return {};
+    }
+    return {this, buffer, size};
+}
+
+IoBuffer BufferPool::tryAcquire()
+{
+    std::lock_guard lock(mutex);
+    auto buffer = take();
+    if (!buffer)
+    {
+        return {};
+    }
+    return {this, buffer, size};
+}
+
+size_t BufferPool::allocated() const
+{
+    std::lock_guard lock(mutex);
+    return buffers.size();
+}
+
+void BufferPool::release(char* buffer)
+{
+    {
+        std::lock_guard lock(mutex);
+        freeBuffers.push_back(buffer);
+    }
+    returned.notify_one();
+}
+
+} // namespace updater
+} // namespace software
+} // namespace openpower
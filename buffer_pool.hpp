@@ -0,0 +1,173 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+namespace openpower
+{
+namespace software
+{
+namespace updater
+{
+
+class BufferPool;
+
+/** @class IoBuffer
+ *  @brief A buffer of an I/O buffer pool, returned to the pool when
+ *  destroyed.
+ */
+class IoBuffer
+{
+  public:
+    /** @brief Constructs an empty buffer, holding nothing */
+    IoBuffer() = default;
+    IoBuffer(const IoBuffer&) = delete;
+    IoBuffer& operator=(const IoBuffer&) = delete;
+    IoBuffer(IoBuffer&& other) noexcept;
+    IoBuffer& operator=(IoBuffer&& other) noexcept;
+
+    ~IoBuffer();
+
+    /** @brief Whether the buffer holds memory of the pool */
+    explicit operator bool() const
+    {
+        return buffer != nullptr;
+    }
+
+    /** @brief The memory of the buffer, aligned to the pool alignment */
+    char* data() const
+    {
+        return buffer;
+    }
+
+    /** @brief The size of the buffer in bytes */
+    size_t size() const
+    {
+        return length;
+    }
+
+  private:
+    friend class BufferPool;
+
+    IoBuffer(BufferPool* pool, char* buffer, size_t length) :
+        pool(pool), buffer(buffer), length(length)
+    {}
+
+    /** @brief Return the buffer to its pool */
+    void reset();
+
+    /** @brief The pool the buffer belongs to */
+    BufferPool* pool = nullptr;
+
+    /** @brief The memory of the buffer */
+    char* buffer = nullptr;
+
+    /** @brief The size of the buffer */
+    size_t length = 0;
+};
+
+/** @class BufferPool
+ *  @brief A bounded pool of reusable I/O buffers, aligned to the flash erase
+ *  block, shared by the paths that read, hash, copy and program images.
+ *  @details The buffers are allocated on first use, up to the count of the
+ *  pool, and are kept until the pool is destroyed. Once they are allocated
+ *  a chunk of an image costs no heap allocation, and the memory of the pool
+ *  is never more than its count times the buffer size. A path holds one
+ *  buffer at a time, so that paths running on several threads cannot
+ *  deadlock waiting on each other.
+ */
+class BufferPool
+{
+  public:
+    /** @brief The alignment of the buffers, and the granularity of their
+     *  size: the largest erase block of the NOR flash devices */
+    static constexpr size_t alignment = 64 * 1024;
+
+    BufferPool() = delete;
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+    BufferPool(BufferPool&&) = delete;
+    BufferPool& operator=(BufferPool&&) = delete;
+
+    /** @brief Constructs BufferPool
+     *
+     *  @param[in] bufferSize - The size of each buffer, rounded up to the
+     *                          alignment
+     *  @param[in] count      - The most buffers the pool holds, at least one
+     */
+    BufferPool(size_t bufferSize, size_t count);
+
+    /** @brief Frees the buffers, which must all be returned by then */
+    ~BufferPool();
+
+    /** @brief The process-wide pool, sized by IO_BUFFER_SIZE and
+     *  IO_BUFFER_COUNT */
+    static BufferPool& get();
+
+    /** @brief Take a buffer, waiting for one to be returned if all the
+     *  buffers are in use. Work the event loop can defer uses tryAcquire
+     *  instead.
+     *
+     *  @return The buffer, empty only if it could not be allocated
+     */
+    IoBuffer acquire();
+
+    /** @brief Take a buffer if one is free, without waiting
+     *
+     *  @return The buffer, or an empty buffer if all are in use
+     */
+    IoBuffer tryAcquire();
+
+    /** @brief The size of each buffer */
+    size_t bufferSize() const
+    {
+        return size;
+    }
+
+    /** @brief The number of buffers allocated so far */
+    size_t allocated() const;
+
+  private:
+    friend class IoBuffer;
+
+    /** @brief Take a free buffer, or allocate one if the pool is not full.
+     *  Called with the mutex held.
+     *
+     *  @return The buffer, or nullptr if none is free
+     */
+    char* take();
+
+    /** @brief Return a buffer to the free list
+     *
+     *  @param[in] buffer - The buffer
+     */
+    void release(char* buffer);
+
+    /** @brief The size of each buffer */
+    const size_t size;
+
+    /** @brief The most buffers the pool holds */
+    const size_t count;
+
+    /** @brief Guards the buffer lists */
+    mutable std::mutex mutex;
+
+    /** @brief Signalled when a buffer is returned */
+    std::condition_variable returned;
+
+    /** @brief The buffers allocated, to be freed with the pool */
+    std::vector<char*> buffers;
+
+    /** @brief The buffers not in use, with room for all the buffers so that
+     *  returning one never allocates */
+    std::vector<char*> freeBuffers;
+
+    /** @brief Whether an allocation failed, logged once */
+    bool allocationFailed = false;
+};
+
+} // namespace updater
+} // namespace software
+} // namespace openpower
@@ -0,0 +1,180 @@
+#include "executor.hpp"
+
+#include "loop_monitor.hpp"
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <phosphor-logging/log.hpp>
+
+#include <cerrno>
+#include <system_error>
+
+namespace openpower
+{
+namespace software
+{
+namespace updater
+{
+
+using namespace phosphor::logging;
+
+namespace
+{
+
+int createEventFd()
+{
+    auto fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (fd < 0)
+    {
+        throw std::system_error(errno, std::generic_category(),
+                                "Error occurred during the eventfd");
+    }
+    return fd;
+}
+
+} // namespace
+
+Executor::Executor(const sdeventplus::Event& event, size_t threads) :
+    fd(createEventFd()),
+    source(event, fd, EPOLLIN,
+           [this](sdeventplus::source::IO&, int, uint32_t) { complete(); })
+{
+    for (size_t i = 0; i < threads; i++)
+    {
+        workers.emplace_back([this](std::stop_token token) { run(token); });
+    }
+}
+
+Executor::~Executor()
+{
+    {
+        std::lock_guard lock(mutex);
+        for (auto& task : pending)
+        {
+            task.stop.request_stop();
+        }
+        for (auto& stop : running)
+        {
+            stop.request_stop();
+        }
+    }
+    for (auto& worker : workers)
+    {
+        worker.request_stop();
+    }
+    workers.clear();
+    close(fd);
+}
+
+std::stop_source Executor::post(Work work, Completion done,
+                                Completion cancelled)
+{
+    std::stop_source stop;
+    {
+        std::lock_guard lock(mutex);
+        pending.push_back(
+            {std::move(work), std::move(done), std::move(cancelled), stop});
+    }
+    queued.notify_one();
+    return stop;
+}
+
+void Executor::run(std::stop_token token)
+{
+    while (true)
+    {
+        Task task;
+        std::list<std::stop_source>::iterator self;
+        bool dropped = false;
+        {
+            std::unique_lock lock(mutex);
+            if (!queued.wait(lock, token, [this] { return !pending.empty(); }))
+            {
+                return;
+            }
+            task = std::move(pending.front());
+            pending.pop_front();
+            dropped = task.stop.stop_requested();
+            if (!dropped)
+            {
+                self = running.insert(running.end(), task.stop);
+            }
+        }
+        if (dropped)
+        {
+            // Dropped before it started, only its cancellation completes
+            if (task.cancelled)
+            {
+                finish(std::move(task));
+            }
+            continue;
+        }
+
+        try
+        {
+            task.work(task.stop.get_token());
+        }
+        catch (const std::exception& e)
+        {
+            log<level::ERR>("Background work failed",
+                            entry("ERROR=%s", e.what()));
+        }
+
+        {
+            std::lock_guard lock(mutex);
+            running.erase(self);
+        }
+        finish(std::move(task));
+    }
+}
+
+void Executor::finish(Task task)
+{
+    {
+        std::lock_guard lock(mutex);
+        finished.push_back(std::move(task));
+    }
+    uint64_t one = 1;
+    if (write(fd, &one, sizeof(one)) < 0)
+    {
+        log<level::ERR>("Unable to signal the event loop",
+                        entry("ERRNO=%d", errno));
+    }
+}
+
+void Executor::complete()
+{
+    labelDispatch("executor completion");
+
+    uint64_t count = 0;
+    if (read(fd, &count, sizeof(count)) < 0)
+    {
+        return;
+    }
+
+    std::vector<Task> tasks;
+    {
+        std::lock_guard lock(mutex);
+        tasks.swap(finished);
+    }
+    for (auto& task : tasks)
+    {
+        if (!task.stop.stop_requested())
+        {
+            if (task.done)
+            {
+                task.done();
+            }
+        }
+        else if (task.cancelled)
+        {
+            task.cancelled();
+        }
+    }
+}
+
+} // namespace updater
+} // namespace software
+} // namespace openpower
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <sdeventplus/event.hpp>
+#include <sdeventplus/source/io.hpp>
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <stop_token>
+#include <thread>
+#include <vector>
+
+namespace openpower
+{
+namespace software
+{
+namespace updater
+{
+
+/** @class Executor
+ *  @brief Runs blocking work on a fixed pool of worker threads.
+ *  @details The completion of each piece of work is posted back to the
+ *  event loop through an eventfd, so that it runs on the same thread as the
+ *  D-Bus handlers and needs no locking. The work itself must not touch any
+ *  state shared with the event loop.
+ */
+class Executor
+{
+  public:
+    /** @brief The work, which should return early once its stop token is
+     *  requested to stop */
+    using Work = std::function<void(std::stop_token)>;
+
+    /** @brief The completion, run on the event loop */
+    using Completion = std::function<void()>;
+
+    Executor() = delete;
+    Executor(const Executor&) = delete;
+    Executor& operator=(const Executor&) = delete;
+    Executor(Executor&&) = delete;
+    Executor& operator=(Executor&&) = delete;
+
+    /** @brief Constructs Executor
+     *
+     * @param[in] event   - The event loop to run the completions on
+     * @param[in] threads - The number of worker threads
+     */
+    Executor(const sdeventplus::Event& event, size_t threads);
+
+    /** @brief Cancels the pending and running work and joins the workers.
+     *  No completion runs after the executor is destroyed. */
+    ~Executor();
+
+    /** @brief Queue work for the worker threads
+     *
+     * @param[in] work      - The work
+     * @param[in] done      - Run on the event loop once the work returned,
+     *                        unless the work was cancelled
+     * @param[in] cancelled - Run on the event loop instead of done once the
+     *                        cancelled work returned, or was dropped before
+     *                        it started
+     *
+     * @return The stop source cancelling the work
+     */
+    std::stop_source post(Work work, Completion done = {},
+                          Completion cancelled = {});
+
+  private:
+    /** @brief A queued or running piece of work */
+    struct Task
+    {
+        Work work;
+        Completion done;
+        Completion cancelled;
+        std::stop_source stop;
+    };
+
+    /** @brief The loop of each worker thread */
+    void run(std::stop_token token);
+
+    /** @brief Hand a task over to the event loop for its completion */
+    void finish(Task task);
+
+    /** @brief Run the completions posted by the workers */
+    void complete();
+
+    /** @brief Protects the queues below */
+    std::mutex mutex;
+
+    /** @brief Signalled when work is queued */
+    std::condition_variable_any queued;
+
+    /** @brief The work not yet picked by a worker */
+    std::deque<Task> pending;
+
+    /** @brief The stop sources of the work being run */
+    std::list<std::stop_source> running;
+
+    /** @brief The completions to run on the event loop */
+    std::vector<Task> finished;
+
+    /** @brief The eventfd the workers signal finished work on */
+    int fd;
+
+    /** @brief The event source watching the eventfd */
+    sdeventplus::source::IO source;
+
+    /** @brief The worker threads, declared last so that they are joined
+     *  before the rest is destroyed */
+    std::vector<std::jthread> workers;
+};
+
+} // namespace updater
+} // namespace software
+} // namespace openpower
@@ -0,0 +1,330 @@
+#include "flash_device.hpp"
+
+#include "buffer_pool.hpp"
+
+#include <fcntl.h>
+#include <mtd/mtd-user.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <phosphor-logging/log.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+namespace openpower
+{
+namespace software
+{
+namespace updater
+{
+
+namespace fs = std::filesystem;
+using namespace phosphor::logging;
+
+namespace
+{
+
+/** @brief The least size the erased check is made on. Smaller pages save
+ *  little programming time for the extra write calls they cost.
+ */
+constexpr uint32_t minPageSize = 4096;
+
+} // namespace
+
+bool isErased(const void* data, size_t size)
+{
+    constexpr uint64_t erasedWord = ~uint64_t{0};
+    constexpr size_t blockWords = 4;
+    constexpr size_t blockSize = blockWords * sizeof(uint64_t);
+
+    auto bytes = static_cast<const uint8_t*>(data);
+    size_t pos = 0;
+    for (; pos + blockSize <= size; pos += blockSize)
+    {
+        // memcpy makes the loads alignment safe, and is optimised out
+        uint64_t words[blockWords];
+        std::memcpy(words, bytes + pos, blockSize);
+        if ((words[0] & words[1] & words[2] & words[3]) != erasedWord)
+        {
+            return false;
+        }
+    }
+    for (; pos < size; pos++)
+    {
+        if (bytes[pos] != 0xFF)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+FlashDevice::FlashDevice(const fs::path& path)
+{
+    fd = open(path.c_str(), O_RDWR | O_CLOEXEC);
+    if (fd < 0)
+    {
+        log<level::ERR>("Failed to open the flash device",
+                        entry("DEVICE=%s", path.c_str()),
+                        entry("ERRNO=%d", errno));
+        return;
+    }
+
+    struct stat st;
+    if ((fstat(fd, &st) == 0) && S_ISREG(st.st_mode))
+    {
+        simulated = true;
+        deviceSize = st.st_size;
+        eraseBlockSize = simulatedEraseSize;
+        pageSize = minPageSize;
+        return;
+    }
+
+    mtd_info_t info = {};
+    if (ioctl(fd, MEMGETINFO, &info) != 0)
+    {
+        log<level::ERR>("Failed to get the flash device info",
+                        entry("DEVICE=%s", path.c_str()),
+                        entry("ERRNO=%d", errno));
+        close(fd);
+        fd = -1;
+        return;
+    }
+    deviceSize = info.size;
+    eraseBlockSize = info.erasesize;
+    pageSize = std::max(info.writesize, minPageSize);
+}
+
+FlashDevice::~FlashDevice()
+{
+    if (fd >= 0)
+    {
+        close(fd);
+    }
+}
+
+bool FlashDevice::erase(uint64_t offset, uint64_t length)
+{
+    if ((eraseBlockSize == 0) || (offset % eraseBlockSize != 0))
+    {
+        return false;
+    }
+    length = (length + eraseBlockSize - 1) / eraseBlockSize * eraseBlockSize;
+
+    if (simulated)
+    {
+        std::vector<uint8_t> erased(eraseBlockSize, 0xFF);
+        auto end = std::min(offset + length, deviceSize);
+        for (auto pos = offset; pos < end; pos += eraseBlockSize)
+        {
+            auto count = std::min<uint64_t>(eraseBlockSize, end - pos);
+            if (pwrite(fd, erased.data(), count, pos) !=
+                static_cast<ssize_t>(count))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    erase_info_t eraseInfo = {};
+    eraseInfo.start = offset;
+    eraseInfo.length = length;
+    if (ioctl(fd, MEMERASE, &eraseInfo) != 0)
+    {
+        log<level::ERR>("Failed to erase the flash",
+                        entry("OFFSET=0x%llx",
+                              static_cast<unsigned long long>(offset)),
+                        entry("ERRNO=%d", errno));
+        return false;
+    }
+    return true;
+}
+
+bool FlashDevice::write(uint64_t offset, const uint8_t* data, size_t length)
+{
+    if (!simulated)
+    {
+        return pwrite(fd, data, length, offset) ==
+               static_cast<ssize_t>(length);
+    }
+
+    // Programming flash only clears bits
+    std::vector<uint8_t> cells(length);
+    if (pread(fd, cells.data(), length, offset) !=
+        static_cast<ssize_t>(length))
+    {
+        return false;
+    }
+    for (size_t i = 0; i < length; i++)
+    {
+        cells[i] &= data[i];
+    }
+    return pwrite(fd, cells.data(), length, offset) ==
+           static_cast<ssize_t>(length);
+}
+
+bool FlashDevice::program(uint64_t offset, const void* data, size_t length,
+                          ProgramStats& stats, bool skipErased)
+{
+    auto bytes = static_cast<const uint8_t*>(data);
+
+    // Write a run of pages that are not erased
+    auto writeRun = [&](size_t start, size_t end) {
+        auto count = end - start;
+        if (!write(offset + start, bytes + start, count))
+        {
+            log<level::ERR>(
+                "Failed to program the flash",
+                entry("OFFSET=0x%llx",
+                      static_cast<unsigned long long>(offset + start)),
+                entry("ERRNO=%d", errno));
+            return false;
+        }
+        stats.written += count;
+        return true;
+    };
+
+    size_t runStart = 0;
+    bool inRun = false;
+    for (size_t pos = 0; pos < length; pos += pageSize)
+    {
+        auto page = std::min<size_t>(pageSize, length - pos);
+        if (!skipErased || !isErased(bytes + pos, page))
+        {
+            if (!inRun)
+            {
+                runStart = pos;
+                inRun = true;
+            }
+            continue;
+        }
+
+        stats.skipped += page;
+        if (inRun)
+        {
+            inRun = false;
+            if (!writeRun(runStart, pos))
+            {
+                return false;
+            }
+        }
+    }
+    return !inRun || writeRun(runStart, length);
+}
+
+bool programImage(const fs::path& device, const fs::path& image,
+                  ProgramStats& stats, std::atomic<uint64_t>* done)
+{
+    FlashDevice flash(device);
+    if (!flash)
+    {
+        return false;
+    }
+
+    std::error_code ec;
+    auto size = fs::file_size(image, ec);
+    if (ec || (size > flash.size()))
+    {
+        log<level::ERR>("The image does not fit the flash device",
+                        entry("IMAGE=%s", image.c_str()),
+                        entry("DEVICE=%s", device.c_str()));
+        return false;
+    }
+
+    // As with pflash -E, the whole device is erased first
+    if (!flash.erase(0, flash.size()))
+    {
+        return false;
+    }
+
+    // The buffers of the pool are a multiple of the page size
+    auto buffer = BufferPool::get().acquire();
+    if (!buffer)
+    {
+        return false;
+    }
+    std::ifstream input(image, std::ios::binary);
+    uint64_t offset = 0;
+    while (input.read(buffer.data(), buffer.size()) || input.gcount() > 0)
+    {
+        auto count = static_cast<size_t>(input.gcount());
+        if (!flash.program(offset, buffer.data(), count, stats))
+        {
+            return false;
+        }
+        offset += count;
+        if (done)
+        {
+            *done += count;
+        }
+    }
+    return offset == size;
+}
+
+std::vector<std::pair<std::string, std::string>>
+    parseDeviceMap(const std::string& content)
+{
+    std::vector<std::pair<std::string, std::string>> map;
+    std::istringstream iss(content);
+    std::string line;
+    while (std::getline(iss, line))
+    {
+        std::istringstream fields(line);
+        std::string image, device;
+        if (!(fields >> image >> device) || (image.front() == '#'))
+        {
+            continue;
+        }
+        map.emplace_back(std::move(image), std::move(device));
+    }
+    return map;
+}
+
+std::vector<DeviceResult> programDevices(const std::vector<DeviceImage>& images,
+                                         std::atomic<uint64_t>& done)
+{
+    std::vector<DeviceResult> results(images.size());
+    for (size_t i = 0; i < images.size(); i++)
+    {
+        results[i].device = images[i].device;
+        for (size_t j = 0; j < i; j++)
+        {
+            // Two images programmed to the same device would overwrite
+            // each other
+            if (images[j].device.lexically_normal() ==
+                images[i].device.lexically_normal())
+            {
+                log<level::ERR>("Flash device mapped more than once",
+                                entry("DEVICE=%s", images[i].device.c_str()));
+                return results;
+            }
+        }
+    }
+
+    // The devices are independent chips, each one is programmed as fast
+    // as it erases and writes
+    {
+        std::vector<std::jthread> threads;
+        for (size_t i = 0; i < images.size(); i++)
+        {
+            threads.emplace_back([&images, &results, &done, i]() {
+                results[i].programmed =
+                    programImage(images[i].device, images[i].image,
+                                 results[i].stats, &done);
+            });
+        }
+    }
+    return results;
+}
+
+} // namespace updater
+} // namespace software
+} // namespace openpower
@@ -0,0 +1,205 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace openpower
+{
+namespace software
+{
+namespace updater
+{
+
+/** @brief Check whether data reads as erased flash, i.e. is all 0xFF. The
+ *  data is compared a few words at a time, which compilers vectorise.
+ *
+ *  @param[in] data - The data
+ *  @param[in] size - The size of the data in bytes
+ *
+ *  @return true if every byte is 0xFF
+ */
+bool isErased(const void* data, size_t size);
+
+/** @struct ProgramStats
+ *  @brief The bytes programmed to flash and the bytes skipped as erased.
+ */
+struct ProgramStats
+{
+    /** @brief Bytes written to the device */
+    uint64_t written = 0;
+
+    /** @brief Bytes not written, as they are all 0xFF */
+    uint64_t skipped = 0;
+};
+
+/** @class FlashDevice
+ *  @brief An MTD flash device, programmed without writing the pages that
+ *  are already erased.
+ *  @details A regular file is opened as a simulated MTD device, for tests:
+ *  erasing fills it with 0xFF, and programming can only clear bits, as on
+ *  NOR flash.
+ */
+class FlashDevice
+{
+  public:
+    FlashDevice() = delete;
+    FlashDevice(const FlashDevice&) = delete;
+    FlashDevice& operator=(const FlashDevice&) = delete;
+    FlashDevice(FlashDevice&&) = delete;
+    FlashDevice& operator=(FlashDevice&&) = delete;
+
+    /** @brief Opens an MTD device
+     *
+     *  @param[in] path - The MTD character device, e.g. /dev/mtd6, or a
+     *                    file simulating one
+     */
+    explicit FlashDevice(const std::filesystem::path& path);
+
+    ~FlashDevice();
+
+    /** @brief Whether the device is open */
+    explicit operator bool() const
+    {
+        return fd >= 0;
+    }
+
+    /** @brief The size of the device in bytes */
+    uint64_t size() const
+    {
+        return deviceSize;
+    }
+
+    /** @brief The erase block size in bytes */
+    uint32_t eraseSize() const
+    {
+        return eraseBlockSize;
+    }
+
+    /** @brief Erase the erase blocks of a range
+     *
+     *  @param[in] offset - The offset, aligned to the erase block size
+     *  @param[in] length - The length, rounded up to the erase block size
+     *
+     *  @return true if the range is erased
+     */
+    bool erase(uint64_t offset, uint64_t length);
+
+    /** @brief Program an erased range. The pages that are all 0xFF are
+     *  skipped, as erased flash already reads as 0xFF.
+     *
+     *  @param[in]     offset     - The offset to program at
+     *  @param[in]     data       - The data
+     *  @param[in]     length     - The length of the data
+     *  @param[in,out] stats      - Counts the bytes written and skipped
+     *  @param[in]     skipErased - Whether to skip the erased pages
+     *
+     *  @return true if the range is programmed
+     */
+    bool program(uint64_t offset, const void* data, size_t length,
+                 ProgramStats& stats, bool skipErased = true);
+
+    /** @brief The erase block size of a simulated device */
+    static constexpr uint32_t simulatedEraseSize = 64 * 1024;
+
+  private:
+    /** @brief Write data to the device, clearing bits only on a simulated
+     *  device
+     *
+     *  @param[in] offset - The offset to write at
+     *  @param[in] data   - The data
+     *  @param[in] length - The length of the data
+     *
+     *  @return true if the data is written
+     */
+    bool write(uint64_t offset, const uint8_t* data, size_t length);
+
+    /** @brief The device file descriptor */
+    int fd = -1;
+
+    /** @brief Whether the device is a file simulating an MTD device */
+    bool simulated = false;
+
+    /** @brief The size of the device */
+    uint64_t deviceSize = 0;
+
+    /** @brief The erase block size */
+    uint32_t eraseBlockSize = 0;
+
+    /** @brief The size of the pages the erased check is made on */
+    uint32_t pageSize = 0;
+};
+
+/** @brief Erase a whole MTD device and program an image at its start,
+ *  skipping the pages of the image that are all 0xFF.
+ *
+ *  @param[in]     device - The MTD character device
+ *  @param[in]     image  - The image file
+ *  @param[out]    stats  - The bytes written and skipped
+ *  @param[in,out] done   - If set, incremented by the bytes of the image
+ *                          programmed, from any thread
+ *
+ *  @return true if the image is programmed
+ */
+bool programImage(const std::filesystem::path& device,
+                  const std::filesystem::path& image, ProgramStats& stats,
+                  std::atomic<uint64_t>* done = nullptr);
+
+/** @struct DeviceImage
+ *  @brief An image and the flash device it is programmed to.
+ */
+struct DeviceImage
+{
+    /** @brief The MTD character device */
+    std::filesystem::path device;
+
+    /** @brief The image file */
+    std::filesystem::path image;
+};
+
+/** @struct DeviceResult
+ *  @brief The outcome of programming one device of a device map.
+ */
+struct DeviceResult
+{
+    /** @brief The MTD character device */
+    std::filesystem::path device;
+
+    /** @brief Whether the image is programmed */
+    bool programmed = false;
+
+    /** @brief The bytes written and skipped */
+    ProgramStats stats;
+};
+
+/** @brief Parse a device map, whose lines name an image file and the flash
+ *  device it is programmed to, e.g. "host0.pnor pnor". Empty lines and
+ *  lines starting with # are ignored.
+ *
+ *  @param[in] content - The content of the device map
+ *
+ *  @return The image file names and their device, in order
+ */
+std::vector<std::pair<std::string, std::string>>
+    parseDeviceMap(const std::string& content);
+
+/** @brief Program images to several flash devices at once, each device on
+ *  its own thread. A device that fails does not stop the others, which are
+ *  already erased by then.
+ *
+ *  @param[in]     images - The images and their devices, each device once
+ *  @param[in,out] done   - Incremented by the bytes of the images
+ *                          programmed, across all the devices
+ *
+ *  @return The outcome for each device, in the order of the images
+ */
+std::vector<DeviceResult> programDevices(const std::vector<DeviceImage>& images,
+                                         std::atomic<uint64_t>& done);
+
+} // namespace updater
+} // namespace software
+} // namespace openpower
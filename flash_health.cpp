@@ -0,0 +1,434 @@
+#include "config.h"
+
+#include "flash_health.hpp"
+
+#include "paths.hpp"
+
+#include <fcntl.h>
+#include <mtd/mtd-user.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include <cereal/archives/json.hpp>
+#include <cereal/types/map.hpp>
+#include <cereal/types/vector.hpp>
+#include <phosphor-logging/log.hpp>
+#include <sdbusplus/message.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+
+namespace openpower
+{
+namespace software
+{
+namespace updater
+{
+
+namespace fs = std::filesystem;
+using namespace phosphor::logging;
+
+namespace
+{
+
+constexpr auto trendInterval = std::chrono::hours(24);
+constexpr auto flushInterval = std::chrono::hours(1);
+constexpr size_t trendLength = 64;
+constexpr size_t hotBlockCount = 16;
+constexpr auto trendFile = "flash-health";
+constexpr auto writesFile = "flash-writes";
+
+/** @brief Write counts per erase block offset */
+using BlockWrites = std::map<uint64_t, uint32_t>;
+
+/** @brief Find the PNOR MTD device number from /proc/mtd, whose lines look
+ *  like: mtd6: 04000000 00010000 "pnor"
+ */
+int findPnorMtdNum()
+{
+    std::ifstream mtdFile("/proc/mtd");
+    std::string line;
+    while (std::getline(mtdFile, line))
+    {
+        if ((line.rfind("mtd", 0) == 0) &&
+            (line.find("\"pnor\"") != std::string::npos))
+        {
+            return std::atoi(line.c_str() + 3);
+        }
+    }
+    return -1;
+}
+
+/** @brief Read a number from a sysfs attribute, 0 if absent */
+uint64_t readSysfs(const fs::path& path)
+{
+    uint64_t value = 0;
+    std::ifstream file(path);
+    file >> value;
+    return value;
+}
+
+template <class Map>
+Map restoreMap(const char* name)
+{
+    Map map;
+    auto path = fs::path(paths::persistDir()) / name;
+    if (!fs::exists(path))
+    {
+        return map;
+    }
+
+    std::ifstream input(path.c_str(), std::ios::in);
+    try
+    {
+        cereal::JSONInputArchive archive(input);
+        archive(cereal::make_nvp(name, map));
+    }
+    catch (const cereal::RapidJSONException& e)
+    {
+        fs::remove(path);
+    }
+    return map;
+}
+
+template <class Map>
+void storeMap(const char* name, const Map& map)
+{
+    auto path = fs::path(paths::persistDir()) / name;
+    fs::create_directories(path.parent_path());
+
+    std::ofstream output(path.c_str());
+    cereal::JSONOutputArchive archive(output);
+    archive(cereal::make_nvp(name, map));
+}
+
+/** @brief Keep the most erased blocks, most erased first */
+std::vector<std::tuple<uint64_t, uint32_t>>
+    hottest(std::vector<std::tuple<uint64_t, uint32_t>> blocks)
+{
+    auto count = std::min(blocks.size(), hotBlockCount);
+    std::partial_sort(blocks.begin(), blocks.begin() + count, blocks.end(),
+                      [](const auto& a, const auto& b) {
+                          return std::get<1>(a) > std::get<1>(b);
+                      });
+    blocks.resize(count);
+    return blocks;
+}
+
+/** @brief The write counts, kept in memory and stored by flushFlashWrites()
+ *  so that counting a write does not itself rewrite the flash
+ */
+struct WriteCounts
+{
+    std::mutex lock;
+    BlockWrites writes;
+    bool restored = false;
+    bool dirty = false;
+};
+
+/** @brief The write counts, restored from the persisted ones on first use.
+ *  The caller holds the lock.
+ */
+BlockWrites& restoredWrites(WriteCounts& counts)
+{
+    if (!counts.restored)
+    {
+        counts.writes = restoreMap<BlockWrites>(writesFile);
+        counts.restored = true;
+    }
+    return counts.writes;
+}
+
+WriteCounts& writeCounts()
+{
+    static WriteCounts counts;
+    return counts;
+}
+
+/** @brief A copy of the write counts, including the ones not yet stored */
+BlockWrites blockWrites()
+{
+    auto& counts = writeCounts();
+    std::lock_guard guard(counts.lock);
+    return restoredWrites(counts);
+}
+
+} // namespace
+
+template <class Archive>
+void serialize(Archive& archive, HealthSnapshot& snapshot)
+{
+    archive(cereal::make_nvp("timestamp", snapshot.timestamp),
+            cereal::make_nvp("maxEraseCount", snapshot.maxEraseCount),
+            cereal::make_nvp("badBlocks", snapshot.badBlocks),
+            cereal::make_nvp("eccCorrected", snapshot.eccCorrected),
+            cereal::make_nvp("eccFailed", snapshot.eccFailed));
+}
+
+void recordFlashWrite(uint64_t offset, uint64_t length)
+{
+    auto mtdNum = findPnorMtdNum();
+    if (mtdNum < 0)
+    {
+        return;
+    }
+    auto sysfs = fs::path("/sys/class/mtd") / ("mtd" + std::to_string(mtdNum));
+    auto eraseSize = readSysfs(sysfs / "erasesize");
+    auto size = readSysfs(sysfs / "size");
+    if ((eraseSize == 0) || (offset >= size))
+    {
+        return;
+    }
+    length = std::min(length, size - offset);
+
+    auto& counts = writeCounts();
+    std::lock_guard guard(counts.lock);
+    auto& writes = restoredWrites(counts);
+    for (auto block = offset - offset % eraseSize; block < offset + length;
+         block += eraseSize)
+    {
+        writes[block]++;
+    }
+    counts.dirty = true;
+}
+
+void flushFlashWrites()
+{
+    auto& counts = writeCounts();
+    std::lock_guard guard(counts.lock);
+    if (counts.dirty)
+    {
+        storeMap(writesFile, counts.writes);
+        counts.dirty = false;
+    }
+}
+
+const sdbusplus::vtable::vtable_t FlashHealth::vtable[] = {
+    sdbusplus::vtable::start(),
+    sdbusplus::vtable::property("MaxEraseCount", "u",
+                                FlashHealth::getProperty,
+                                sdbusplus::vtable::property_::emits_change),
+    sdbusplus::vtable::property("MeanEraseCount", "d",
+                                FlashHealth::getProperty,
+                                sdbusplus::vtable::property_::emits_change),
+    sdbusplus::vtable::property("BadBlocks", "u", FlashHealth::getProperty,
+                                sdbusplus::vtable::property_::emits_change),
+    sdbusplus::vtable::property("EccCorrected", "u",
+                                FlashHealth::getProperty,
+                                sdbusplus::vtable::property_::emits_change),
+    sdbusplus::vtable::property("EccFailed", "u", FlashHealth::getProperty,
+                                sdbusplus::vtable::property_::emits_change),
+    sdbusplus::vtable::property("HotBlocks", "a(tu)",
+                                FlashHealth::getProperty,
+                                sdbusplus::vtable::property_::emits_change),
+    sdbusplus::vtable::property("Trend", "a(tuuuu)", FlashHealth::getProperty,
+                                sdbusplus::vtable::property_::emits_change),
+    sdbusplus::vtable::end()};
+
+FlashHealth::FlashHealth(sdbusplus::bus::bus& bus,
+                         const sdeventplus::Event& event) :
+    trend(restoreMap<std::vector<HealthSnapshot>>(trendFile)),
+    interface(bus, FLASH_HEALTH_PATH, FLASH_HEALTH_INTERFACE, vtable, this),
+    timer(event, [this](auto&) { sample(); })
+{
+    sample();
+}
+
+FlashHealth::~FlashHealth()
+{
+    flushFlashWrites();
+}
+
+HealthSnapshot readFlashHealth()
+{
+    HealthSnapshot snapshot;
+    auto now = std::chrono::system_clock::now().time_since_epoch();
+    snapshot.timestamp =
+        std::chrono::duration_cast<std::chrono::seconds>(now).count();
+
+    auto mtdNum = findPnorMtdNum();
+    if (mtdNum < 0)
+    {
+        return snapshot;
+    }
+    auto mtdName = "mtd" + std::to_string(mtdNum);
+#ifdef UBIFS_LAYOUT
+    // The UBI device is attached with the number of its MTD device
+    auto ubi = fs::path("/sys/class/ubi") / ("ubi" + std::to_string(mtdNum));
+    snapshot.maxEraseCount = readSysfs(ubi / "max_ec");
+    snapshot.badBlocks = readSysfs(ubi / "bad_peb_count");
+#else
+    for (const auto& [offset, count] : blockWrites())
+    {
+        snapshot.maxEraseCount = std::max(snapshot.maxEraseCount, count);
+    }
+#endif
+
+    auto fd = open(("/dev/" + mtdName).c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd >= 0)
+    {
+        mtd_ecc_stats stats{};
+        if (ioctl(fd, ECCGETSTATS, &stats) == 0)
+        {
+            snapshot.eccCorrected = stats.corrected;
+            snapshot.eccFailed = stats.failed;
+#ifndef UBIFS_LAYOUT
+            snapshot.badBlocks = stats.badblocks;
+#endif
+        }
+        close(fd);
+    }
+    return snapshot;
+}
+
+void FlashHealth::sample()
+{
+    flushFlashWrites();
+
+    auto snapshot = readFlashHealth();
+    meanEraseCount = 0;
+    hotBlocks.clear();
+
+    auto mtdNum = findPnorMtdNum();
+    if (mtdNum < 0)
+    {
+        timer.restartOnce(flushInterval);
+        return;
+    }
+    auto mtdName = "mtd" + std::to_string(mtdNum);
+    auto mtd = fs::path("/sys/class/mtd") / mtdName;
+    auto eraseSize = readSysfs(mtd / "erasesize");
+
+    std::vector<std::tuple<uint64_t, uint32_t>> blocks;
+    uint64_t total = 0;
+    uint64_t blockCount = 0;
+#ifdef UBIFS_LAYOUT
+    auto ubiName = "ubi" + std::to_string(mtdNum);
+
+    // Each line looks like
+    // physical_block_number	erase_count	block_status	read_status
+    // 0	12	0	0
+    std::ifstream pebInfo(fs::path("/sys/kernel/debug/ubi") / ubiName /
+                          "detailed_erase_block_info");
+    std::string line;
+    while (std::getline(pebInfo, line))
+    {
+        std::istringstream fields(line);
+        uint64_t peb = 0;
+        uint32_t eraseCount = 0;
+        if (fields >> peb >> eraseCount)
+        {
+            blocks.emplace_back(peb * eraseSize, eraseCount);
+            total += eraseCount;
+        }
+    }
+    blockCount = blocks.size();
+#else
+    // The kernel keeps no erase counters for a raw MTD device, use the
+    // writes counted by the updater
+    for (const auto& [offset, count] : blockWrites())
+    {
+        blocks.emplace_back(offset, count);
+        total += count;
+    }
+    // The blocks never written count as 0
+    if (eraseSize > 0)
+    {
+        blockCount = readSysfs(mtd / "size") / eraseSize;
+    }
+#endif
+    if (blockCount > 0)
+    {
+        meanEraseCount = static_cast<double>(total) / blockCount;
+    }
+    hotBlocks = hottest(std::move(blocks));
+
+    current = snapshot;
+
+    // One trend snapshot per interval, also across restarts
+    auto interval =
+        std::chrono::duration_cast<std::chrono::seconds>(trendInterval)
+            .count();
+    if (trend.empty() ||
+        (snapshot.timestamp >= trend.back().timestamp + interval))
+    {
+        trend.push_back(snapshot);
+        if (trend.size() > trendLength)
+        {
+            trend.erase(trend.begin());
+        }
+        storeMap(trendFile, trend);
+    }
+
+    for (const auto& property :
+         {"MaxEraseCount", "MeanEraseCount", "BadBlocks", "EccCorrected",
+          "EccFailed", "HotBlocks", "Trend"})
+    {
+        interface.property_changed(property);
+    }
+
+    timer.restartOnce(flushInterval);
+}
+
+int FlashHealth::getProperty(sd_bus*, const char*, const char*,
+                             const char* property, sd_bus_message* reply,
+                             void* context, sd_bus_error*)
+{
+    auto health = static_cast<FlashHealth*>(context);
+    auto m = sdbusplus::message::message(reply);
+    std::string name(property);
+
+    if (name == "MaxEraseCount")
+    {
+        m.append(health->current.maxEraseCount);
+    }
+    else if (name == "MeanEraseCount")
+    {
+        m.append(health->meanEraseCount);
+    }
+    else if (name == "BadBlocks")
+    {
+        m.append(health->current.badBlocks);
+    }
+    else if (name == "EccCorrected")
+    {
+        m.append(health->current.eccCorrected);
+    }
+    else if (name == "EccFailed")
+    {
+        m.append(health->current.eccFailed);
+    }
+    else if (name == "HotBlocks")
+    {
+        m.append(health->hotBlocks);
+    }
+    else if (name == "Trend")
+    {
+        std::vector<std::tuple<uint64_t, uint32_t, uint32_t, uint32_t,
+                               uint32_t>>
+            trend;
+        for (const auto& s : health->trend)
+        {
+            trend.emplace_back(s.timestamp, s.maxEraseCount, s.badBlocks,
+                               s.eccCorrected, s.eccFailed);
+        }
+        m.append(trend);
+    }
+    else
+    {
+        return -EINVAL;
+    }
+    return 1;
+}
+
+} // namespace updater
+} // namespace software
+} // namespace openpower
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <sdbusplus/bus.hpp>
+#include <sdbusplus/server/interface.hpp>
+#include <sdbusplus/vtable.hpp>
+#include <sdeventplus/clock.hpp>
+#include <sdeventplus/event.hpp>
+#include <sdeventplus/utility/timer.hpp>
+
+#include <cstdint>
+#include <tuple>
+#include <vector>
+
+namespace openpower
+{
+namespace software
+{
+namespace updater
+{
+
+constexpr auto FLASH_HEALTH_PATH = "/org/open_power/control/flash_health";
+constexpr auto FLASH_HEALTH_INTERFACE =
+    "org.open_power.Software.Host.FlashHealth";
+
+using HealthTimer =
+    sdeventplus::utility::Timer<sdeventplus::ClockId::Monotonic>;
+
+/** @struct HealthSnapshot
+ *  @brief The flash health counters at a point in time.
+ */
+struct HealthSnapshot
+{
+    /** @brief Seconds since the epoch */
+    uint64_t timestamp = 0;
+
+    /** @brief The highest erase or write count of an erase block */
+    uint32_t maxEraseCount = 0;
+
+    /** @brief The number of bad erase blocks */
+    uint32_t badBlocks = 0;
+
+    /** @brief The ECC corrected bitflips */
+    uint32_t eccCorrected = 0;
+
+    /** @brief The ECC uncorrectable errors */
+    uint32_t eccFailed = 0;
+};
+
+/** @brief Count a write to the PNOR flash by the updater, per erase block.
+ *  Used on the static layout, where the kernel keeps no erase counters. The
+ *  counts are kept in memory until flushFlashWrites() stores them, at the
+ *  end of each activation or reset and on the hourly sample.
+ *
+ *  @param[in] offset - The offset of the write
+ *  @param[in] length - The length of the write, clamped to the flash size
+ */
+void recordFlashWrite(uint64_t offset, uint64_t length);
+
+/** @brief Store the write counts recorded since the last flush, if any */
+void flushFlashWrites();
+
+/** @brief Read the wear and ECC counters of the PNOR flash
+ *
+ *  @return The counters, 0 when the flash is not found
+ */
+HealthSnapshot readFlashHealth();
+
+/** @class FlashHealth
+ *  @brief Publishes the wear and ECC counters of the PNOR flash.
+ *  @details The UBI erase counters and bad block count come from sysfs, and
+ *  the per-PEB erase counters from debugfs when it is mounted. The static
+ *  layout uses the write counts recorded by recordFlashWrite(). The MTD ECC
+ *  statistics are read with ECCGETSTATS. The counters are sampled and the
+ *  write counts flushed hourly, a daily snapshot of the counters is kept as
+ *  a trend.
+ */
+class FlashHealth
+{
+  public:
+    FlashHealth() = delete;
+    FlashHealth(const FlashHealth&) = delete;
+    FlashHealth& operator=(const FlashHealth&) = delete;
+    FlashHealth(FlashHealth&&) = delete;
+    FlashHealth& operator=(FlashHealth&&) = delete;
+    ~FlashHealth();
+
+    /** @brief Constructs FlashHealth
+     *
+     * @param[in] bus   - The D-Bus bus object
+     * @param[in] event - The event loop to schedule the samples on
+     */
+    FlashHealth(sdbusplus::bus::bus& bus, const sdeventplus::Event& event);
+
+  private:
+    /** @brief Flush the write counts, read the counters and update the
+     *  trend */
+    void sample();
+
+    /** @brief sd-bus property getter for all the properties */
+    static int getProperty(sd_bus* bus, const char* path,
+                           const char* interface, const char* property,
+                           sd_bus_message* reply, void* context,
+                           sd_bus_error* error);
+
+    /** @brief The D-Bus interface description */
+    static const sdbusplus::vtable::vtable_t vtable[];
+
+    /** @brief The current counters */
+    HealthSnapshot current;
+
+    /** @brief The mean erase or write count of the erase blocks */
+    double meanEraseCount = 0;
+
+    /** @brief The offsets and counts of the most erased blocks */
+    std::vector<std::tuple<uint64_t, uint32_t>> hotBlocks;
+
+    /** @brief The daily snapshots, oldest first */
+    std::vector<HealthSnapshot> trend;
+
+    /** @brief The D-Bus interface */
+    sdbusplus::server::interface::interface interface;
+
+    /** @brief Timer for the periodic samples */
+    HealthTimer timer;
+};
+
+} // namespace updater
+} // namespace software
+} // namespace openpower
@@ -6,6 +6,8 @@
 
 #include "functions.hpp"
 
+#include "paths.hpp"
+
 #include <nlohmann/json.hpp>
 #include <phosphor-logging/log.hpp>
 #include <sdbusplus/bus.hpp>
@@ -31,6 +33,7 @@ namespace process_hostfirmware
 {
 
 using namespace phosphor::logging;
+using openpower::software::updater::paths::mediaDir;
 using InterfacesPropertiesMap =
     std::map<std::string,
              std::map<std::string, std::variant<std::vector<std::string>>>>;
@@ -347,7 +350,7 @@ std::string getBiosAttrStr(const std::filesystem::path& elementsJsonFilePath,
         // Create symlinks from the hostfw elements to their corresponding
         // lid files if they don't exist
         auto elementFilePath =
-            std::filesystem::path("/media/hostfw/running") / a.first;
+            std::filesystem::path(mediaDir() + "hostfw/running") / a.first;
         if (!std::filesystem::exists(elementFilePath))
         {
             std::error_code ec;
@@ -0,0 +1,242 @@
+#include "config.h"
+
+#include "history.hpp"
+
+#include "paths.hpp"
+
+#include <cereal/archives/json.hpp>
+#include <cereal/types/string.hpp>
+#include <cereal/types/vector.hpp>
+#include <sdbusplus/message.hpp>
+
+#include <cerrno>
+#include <filesystem>
+#include <fstream>
+#include <tuple>
+
+namespace openpower
+{
+namespace software
+{
+namespace updater
+{
+
+namespace fs = std::filesystem;
+
+namespace
+{
+
+constexpr auto historyFile = "history";
+
+/** @brief The records kept, a few hundred bytes of flash each */
+constexpr size_t historyLength = 128;
+
+#ifdef UBIFS_LAYOUT
+constexpr auto layout = "ubi";
+#elif defined MMC_LAYOUT
+constexpr auto layout = "mmc";
+#else
+constexpr auto layout = "static";
+#endif
+
+} // namespace
+
+template <class Archive>
+void serialize(Archive& archive, StageRecord& stage)
+{
+    archive(cereal::make_nvp("name", stage.name),
+            cereal::make_nvp("bytes", stage.bytes),
+            cereal::make_nvp("ms", stage.milliseconds));
+}
+
+template <class Archive>
+void serialize(Archive& archive, HistoryRecord& record)
+{
+    archive(cereal::make_nvp("timestamp", record.timestamp),
+            cereal::make_nvp("operation", record.operation),
+            cereal::make_nvp("versionId", record.versionId),
+            cereal::make_nvp("layout", record.layout),
+            cereal::make_nvp("result", record.result),
+            cereal::make_nvp("bytesWritten", record.bytesWritten),
+            cereal::make_nvp("ms", record.milliseconds),
+            cereal::make_nvp("stages", record.stages),
+            cereal::make_nvp("throughput", record.throughput),
+            cereal::make_nvp("maxEraseCountDelta", record.maxEraseCountDelta),
+            cereal::make_nvp("badBlocksDelta", record.badBlocksDelta),
+            cereal::make_nvp("eccCorrectedDelta", record.eccCorrectedDelta),
+            cereal::make_nvp("eccFailedDelta", record.eccFailedDelta));
+}
+
+std::vector<HistoryRecord> restoreHistory()
+{
+    std::vector<HistoryRecord> records;
+    auto path = fs::path(paths::persistDir()) / historyFile;
+    if (!fs::exists(path))
+    {
+        return records;
+    }
+
+    std::ifstream input(path.c_str(), std::ios::in);
+    try
+    {
+        cereal::JSONInputArchive archive(input);
+        archive(cereal::make_nvp("history", records));
+    }
+    catch (const cereal::RapidJSONException& e)
+    {
+        fs::remove(path);
+        records.clear();
+    }
+    return records;
+}
+
+void appendHistory(const HistoryRecord& record)
+{
+    auto records = restoreHistory();
+    records.push_back(record);
+    if (records.size() > historyLength)
+    {
+        records.erase(records.begin(),
+                      records.begin() + (records.size() - historyLength));
+    }
+
+    // The history is informational, failing to keep it fails nothing else
+    auto path = fs::path(paths::persistDir()) / historyFile;
+    std::error_code ec;
+    fs::create_directories(path.parent_path(), ec);
+
+    auto tmpPath = fs::path(path).concat(".tmp");
+    {
+        std::ofstream output(tmpPath.c_str());
+        cereal::JSONOutputArchive archive(output);
+        archive(cereal::make_nvp("history", records));
+    }
+    fs::rename(tmpPath, path, ec);
+}
+
+nlohmann::json historyToJson(const std::vector<HistoryRecord>& records)
+{
+    using json = nlohmann::json;
+
+    auto array = json::array();
+    for (const auto& record : records)
+    {
+        auto stages = json::array();
+        for (const auto& stage : record.stages)
+        {
+            json item = {{"name", stage.name},
+                         {"bytes", stage.bytes},
+                         {"ms", stage.milliseconds}};
+            stages.push_back(item);
+        }
+        json item = {{"timestamp", record.timestamp},
+                     {"operation", record.operation},
+                     {"versionId", record.versionId},
+                     {"layout", record.layout},
+                     {"result", record.result},
+                     {"bytesWritten", record.bytesWritten},
+                     {"ms", record.milliseconds},
+                     {"stages", stages},
+                     {"throughput", record.throughput},
+                     {"maxEraseCountDelta", record.maxEraseCountDelta},
+                     {"badBlocksDelta", record.badBlocksDelta},
+                     {"eccCorrectedDelta", record.eccCorrectedDelta},
+                     {"eccFailedDelta", record.eccFailedDelta}};
+        array.push_back(item);
+    }
+    return array;
+}
+
+HistoryEntry::HistoryEntry(const std::string& operation,
+                           const std::string& versionId) :
+    start(std::chrono::steady_clock::now()),
+    before(readFlashHealth())
+{
+    record.operation = operation;
+    record.versionId = versionId;
+    record.layout = layout;
+}
+
+void HistoryEntry::addStage(const std::string& name, uint64_t bytes,
+                            std::chrono::milliseconds duration)
+{
+    record.stages.push_back(
+        {name, bytes, static_cast<uint64_t>(duration.count())});
+}
+
+void HistoryEntry::finish(bool success)
+{
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start);
+    auto after = readFlashHealth();
+
+    record.timestamp = after.timestamp;
+    record.result = success ? "Success" : "Failure";
+    record.milliseconds = elapsed.count();
+    if (record.milliseconds > 0)
+    {
+        record.throughput =
+            record.bytesWritten * 1000.0 / record.milliseconds;
+    }
+    auto delta = [](uint32_t from, uint32_t to) {
+        return static_cast<int64_t>(to) - static_cast<int64_t>(from);
+    };
+    record.maxEraseCountDelta =
+        delta(before.maxEraseCount, after.maxEraseCount);
+    record.badBlocksDelta = delta(before.badBlocks, after.badBlocks);
+    record.eccCorrectedDelta = delta(before.eccCorrected, after.eccCorrected);
+    record.eccFailedDelta = delta(before.eccFailed, after.eccFailed);
+
+    appendHistory(record);
+}
+
+const sdbusplus::vtable::vtable_t History::vtable[] = {
+    sdbusplus::vtable::start(),
+    sdbusplus::vtable::property("Records", "a(tsssstta(stt)dxxxx)",
+                                History::getProperty,
+                                sdbusplus::vtable::property_::none),
+    sdbusplus::vtable::end()};
+
+History::History(sdbusplus::bus::bus& bus) :
+    interface(bus, HISTORY_PATH, HISTORY_INTERFACE, vtable, this)
+{}
+
+int History::getProperty(sd_bus*, const char*, const char*,
+                         const char* property, sd_bus_message* reply, void*,
+                         sd_bus_error*)
+{
+    if (std::string(property) != "Records")
+    {
+        return -EINVAL;
+    }
+
+    // The history is only read when asked for, it is kept on flash
+    std::vector<std::tuple<uint64_t, std::string, std::string, std::string,
+                           std::string, uint64_t, uint64_t,
+                           std::vector<std::tuple<std::string, uint64_t,
+                                                  uint64_t>>,
+                           double, int64_t, int64_t, int64_t, int64_t>>
+        records;
+    for (const auto& record : restoreHistory())
+    {
+        std::vector<std::tuple<std::string, uint64_t, uint64_t>> stages;
+        for (const auto& stage : record.stages)
+        {
+            stages.emplace_back(stage.name, stage.bytes, stage.milliseconds);
+        }
+        records.emplace_back(
+            record.timestamp, record.operation, record.versionId,
+            record.layout, record.result, record.bytesWritten,
+            record.milliseconds, std::move(stages), record.throughput,
+            record.maxEraseCountDelta, record.badBlocksDelta,
+            record.eccCorrectedDelta, record.eccFailedDelta);
+    }
+
+    auto m = sdbusplus::message::message(reply);
+    m.append(records);
+    return 1;
+}
+
+} // namespace updater
+} // namespace software
+} // namespace openpower
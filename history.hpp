@@ -0,0 +1,179 @@
+#pragma once
+
+#include "flash_health.hpp"
+
+#include <nlohmann/json.hpp>
+#include <sdbusplus/bus.hpp>
+#include <sdbusplus/server/interface.hpp>
+#include <sdbusplus/vtable.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace openpower
+{
+namespace software
+{
+namespace updater
+{
+
+constexpr auto HISTORY_PATH = "/org/open_power/control/history";
+constexpr auto HISTORY_INTERFACE = "org.open_power.Software.Host.History";
+
+/** @struct StageRecord
+ *  @brief The work and the duration of a step of an operation.
+ */
+struct StageRecord
+{
+    /** @brief The stage name */
+    std::string name;
+
+    /** @brief The bytes the stage read or wrote */
+    uint64_t bytes = 0;
+
+    /** @brief The duration in milliseconds */
+    uint64_t milliseconds = 0;
+};
+
+/** @struct HistoryRecord
+ *  @brief An activation, reset or delete done by the updater.
+ */
+struct HistoryRecord
+{
+    /** @brief When the operation ended, in seconds since the epoch */
+    uint64_t timestamp = 0;
+
+    /** @brief Activate, FactoryReset, GardReset or Delete */
+    std::string operation;
+
+    /** @brief The version id, empty for a reset */
+    std::string versionId;
+
+    /** @brief The flash layout of the updater */
+    std::string layout;
+
+    /** @brief Success or Failure */
+    std::string result;
+
+    /** @brief The bytes written to flash */
+    uint64_t bytesWritten = 0;
+
+    /** @brief The duration in milliseconds */
+    uint64_t milliseconds = 0;
+
+    /** @brief The stages, in order */
+    std::vector<StageRecord> stages;
+
+    /** @brief The bytes written per second */
+    double throughput = 0;
+
+    /** @brief The change of the flash counters over the operation */
+    int64_t maxEraseCountDelta = 0;
+    int64_t badBlocksDelta = 0;
+    int64_t eccCorrectedDelta = 0;
+    int64_t eccFailedDelta = 0;
+};
+
+/** @brief Restores the history of the operations
+ *  @return The records, oldest first
+ */
+std::vector<HistoryRecord> restoreHistory();
+
+/** @brief Appends a record to the history, dropping the oldest records
+ *  past the history length.
+ *  @param[in] record - The record
+ */
+void appendHistory(const HistoryRecord& record);
+
+/** @brief Converts the history for printing
+ *  @param[in] records - The records
+ *  @return A JSON array of the records
+ */
+nlohmann::json historyToJson(const std::vector<HistoryRecord>& records);
+
+/** @class HistoryEntry
+ *  @brief Measures an operation and appends its record to the history.
+ */
+class HistoryEntry
+{
+  public:
+    /** @brief Starts measuring an operation
+     *
+     *  @param[in] operation - The operation
+     *  @param[in] versionId - The version id, empty for a reset
+     */
+    HistoryEntry(const std::string& operation, const std::string& versionId);
+
+    /** @brief Add a stage of the operation
+     *
+     *  @param[in] name     - The stage name
+     *  @param[in] bytes    - The bytes the stage read or wrote
+     *  @param[in] duration - The duration of the stage
+     */
+    void addStage(const std::string& name, uint64_t bytes,
+                  std::chrono::milliseconds duration);
+
+    /** @brief Count bytes written to flash
+     *
+     *  @param[in] bytes - The bytes written
+     */
+    void addWritten(uint64_t bytes)
+    {
+        record.bytesWritten += bytes;
+    }
+
+    /** @brief Append the record of the operation to the history
+     *
+     *  @param[in] success - Whether the operation succeeded
+     */
+    void finish(bool success);
+
+  private:
+    /** @brief The record being filled */
+    HistoryRecord record;
+
+    /** @brief When the operation started */
+    std::chrono::steady_clock::time_point start;
+
+    /** @brief The flash counters when the operation started */
+    HealthSnapshot before;
+};
+
+/** @class History
+ *  @brief Publishes the history of the operations on D-Bus.
+ */
+class History
+{
+  public:
+    History() = delete;
+    History(const History&) = delete;
+    History& operator=(const History&) = delete;
+    History(History&&) = delete;
+    History& operator=(History&&) = delete;
+    ~History() = default;
+
+    /** @brief Constructs History
+     *
+     * @param[in] bus - The D-Bus bus object
+     */
+    explicit History(sdbusplus::bus::bus& bus);
+
+  private:
+    /** @brief sd-bus property getter for all the properties */
+    static int getProperty(sd_bus* bus, const char* path,
+                           const char* interface, const char* property,
+                           sd_bus_message* reply, void* context,
+                           sd_bus_error* error);
+
+    /** @brief The D-Bus interface description */
+    static const sdbusplus::vtable::vtable_t vtable[];
+
+    /** @brief The D-Bus interface */
+    sdbusplus::server::interface::interface interface;
+};
+
+} // namespace updater
+} // namespace software
+} // namespace openpower
@@ -2,6 +2,7 @@
 
 #include "image_verify.hpp"
 
+#include "buffer_pool.hpp"
 #include "version.hpp"
 
 #include <fcntl.h>
@@ -15,6 +16,7 @@
 
 #include <fstream>
 #include <set>
+#include <vector>
 
 namespace openpower
 {
@@ -195,6 +197,51 @@ bool Signature::systemLevelVerify()
     return valid;
 }
 
+bool Signature::systemVerify()
+{
+    std::filesystem::path file(imageDirPath / pnorFileName);
+    std::filesystem::path sigFile(imageDirPath);
+    sigFile /= pnorFileName + SIGNATURE_FILE_EXT;
+
+    try
+    {
+        auto keyTypes = getAvailableKeyTypesFromSystem();
+        if (keyTypes.empty())
+        {
+            log<level::ERR>("Missing Signature configuration data in system");
+            return false;
+        }
+
+        for (const auto& keyType : keyTypes)
+        {
+            auto keyHashPair = getKeyHashFileNames(keyType);
+            auto keyValues =
+                Version::getValue(keyHashPair.first, {{hashFunctionTag, " "}});
+            auto hashFunc = keyValues.at(hashFunctionTag);
+
+            try
+            {
+                if (verifyFile(file, sigFile, keyHashPair.second, hashFunc))
+                {
+                    return true;
+                }
+            }
+            catch (const InternalFailure& e)
+            {
+                continue;
+            }
+        }
+    }
+    catch (const InternalFailure& e)
+    {
+        return false;
+    }
+
+    log<level::ERR>("File Signature Validation failed",
+                    entry("FILE=%s", file.c_str()));
+    return false;
+}
+
 bool Signature::verifyFile(const std::filesystem::path& file,
                            const std::filesystem::path& sigFile,
                            const std::filesystem::path& publicKey,
@@ -243,20 +290,46 @@ bool Signature::verifyFile(const std::filesystem::path& file,
         elog<InternalFailure>();
     }
 
-    // Hash the data file and update the verification context
-    auto size = std::filesystem::file_size(file);
-    auto dataPtr = mapFile(file, size);
-
-    result = EVP_DigestVerifyUpdate(rsaVerifyCtx.get(), dataPtr(), size);
-    if (result <= 0)
+    // Hash the data file and update the verification context, a chunk at a
+    // time rather than mapping the whole image. The activations verify on
+    // the event loop, which must not wait for the executor workers to
+    // return a buffer of the pool, so a buffer of its own is used when the
+    // pool has none free.
+    auto pooled = BufferPool::get().tryAcquire();
+    std::vector<char> own;
+    if (!pooled)
     {
-        log<level::ERR>("Error occurred during EVP_DigestVerifyUpdate",
-                        entry("ERRCODE=%lu", ERR_get_error()));
+        own.resize(BufferPool::alignment);
+    }
+    auto buffer = pooled ? pooled.data() : own.data();
+    auto bufferSize = pooled ? pooled.size() : own.size();
+    std::ifstream data(file, std::ios::binary);
+    if (!data)
+    {
+        log<level::ERR>("Failed to read the file to verify",
+                        entry("PATH=%s", file.c_str()));
+        elog<InternalFailure>();
+    }
+    while (data.read(buffer, bufferSize) || data.gcount() > 0)
+    {
+        result = EVP_DigestVerifyUpdate(rsaVerifyCtx.get(), buffer,
+                                        data.gcount());
+        if (result <= 0)
+        {
+            log<level::ERR>("Error occurred during EVP_DigestVerifyUpdate",
+                            entry("ERRCODE=%lu", ERR_get_error()));
+            elog<InternalFailure>();
+        }
+    }
+    if (data.bad())
+    {
+        log<level::ERR>("Failed to read the file to verify",
+                        entry("PATH=%s", file.c_str()));
         elog<InternalFailure>();
     }
 
     // Verify the data with signature.
-    size = std::filesystem::file_size(sigFile);
+    auto size = std::filesystem::file_size(sigFile);
     auto signature = mapFile(sigFile, size);
 
     result = EVP_DigestVerifyFinal(
@@ -145,6 +145,17 @@ class Signature
      */
     bool verify();
 
+    /**
+     * @brief Verify the signature of the image file directly with the
+     *        public keys and hash functions available in the system, for
+     *        files that are not delivered along with a MANIFEST and an
+     *        image specific public key.
+     *
+     *        @return true if signature verification was successful,
+     *                     false if not
+     */
+    bool systemVerify();
+
   private:
     /**
      * @brief Function used for system level file signature validation
@@ -0,0 +1,214 @@
+#include "config.h"
+
+#include "integrity.hpp"
+
+#include "buffer_pool.hpp"
+#include "paths.hpp"
+
+#include <fcntl.h>
+#include <openssl/evp.h>
+#include <unistd.h>
+
+#include <cereal/archives/json.hpp>
+#include <cereal/types/string.hpp>
+#include <cereal/types/vector.hpp>
+#include <phosphor-logging/log.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <fstream>
+#include <vector>
+
+namespace openpower
+{
+namespace software
+{
+namespace updater
+{
+
+namespace fs = std::filesystem;
+using namespace phosphor::logging;
+
+namespace
+{
+
+constexpr auto integrityDir = "integrity";
+
+fs::path integrityPath(const std::string& recordId)
+{
+    return fs::path(paths::persistDir()) / integrityDir / recordId;
+}
+
+} // namespace
+
+template <class Archive>
+void serialize(Archive& archive, IntegrityRegion& region)
+{
+    archive(cereal::make_nvp("name", region.name),
+            cereal::make_nvp("offset", region.offset),
+            cereal::make_nvp("length", region.length),
+            cereal::make_nvp("digest", region.digest));
+}
+
+template <class Archive>
+void serialize(Archive& archive, IntegrityRecord& record)
+{
+    archive(cereal::make_nvp("regions", record.regions),
+            cereal::make_nvp("stamp", record.stamp));
+}
+
+struct Digest::Context
+{
+    Context() : ctx(EVP_MD_CTX_new(), ::EVP_MD_CTX_free)
+    {}
+
+    std::unique_ptr<EVP_MD_CTX, decltype(&::EVP_MD_CTX_free)> ctx;
+};
+
+Digest::Digest() : ctx(std::make_unique<Context>())
+{
+    EVP_DigestInit_ex(ctx->ctx.get(), EVP_sha256(), nullptr);
+}
+
+Digest::~Digest() = default;
+
+void Digest::update(const void* data, size_t size)
+{
+    EVP_DigestUpdate(ctx->ctx.get(), data, size);
+}
+
+std::string Digest::final()
+{
+    std::array<unsigned char, EVP_MAX_MD_SIZE> md{};
+    unsigned int mdLen = 0;
+    EVP_DigestFinal_ex(ctx->ctx.get(), md.data(), &mdLen);
+
+    std::string hex;
+    hex.reserve(mdLen * 2);
+    for (unsigned int i = 0; i < mdLen; i++)
+    {
+        char buf[3];
+        snprintf(buf, sizeof(buf), "%02x", md[i]);
+        hex += buf;
+    }
+    return hex;
+}
+
+std::string digestRange(const fs::path& path, uint64_t offset,
+                        uint64_t length)
+{
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        log<level::ERR>("Failed to open image for digest",
+                        entry("PATH=%s", path.c_str()));
+        return {};
+    }
+
+    auto buffer = BufferPool::get().acquire();
+    if (!buffer)
+    {
+        close(fd);
+        return {};
+    }
+
+    Digest digest;
+    uint64_t done = 0;
+    while (done < length)
+    {
+        auto want = static_cast<size_t>(
+            std::min<uint64_t>(buffer.size(), length - done));
+        auto rc = pread(fd, buffer.data(), want, offset + done);
+        if (rc <= 0)
+        {
+            log<level::ERR>("Failed to read image for digest",
+                            entry("PATH=%s", path.c_str()));
+            close(fd);
+            return {};
+        }
+        digest.update(buffer.data(), rc);
+        done += rc;
+    }
+
+    // The image is not read again until the next scrub, do not let it
+    // displace the page cache.
+    posix_fadvise(fd, offset, length, POSIX_FADV_DONTNEED);
+    close(fd);
+
+    return digest.final();
+}
+
+std::string digestFile(const fs::path& path)
+{
+    std::error_code ec;
+    auto size = fs::file_size(path, ec);
+    if (ec)
+    {
+        log<level::ERR>("Failed to get image size for digest",
+                        entry("PATH=%s", path.c_str()));
+        return {};
+    }
+    return digestRange(path, 0, size);
+}
+
+std::shared_ptr<const fs::path> holdFile(const fs::path& path)
+{
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return nullptr;
+    }
+    return std::shared_ptr<const fs::path>(
+        new fs::path("/proc/self/fd/" + std::to_string(fd)),
+        [fd](const fs::path* held) {
+            // The image is usually unlinked by now, the cached pages of a
+            // file on disk go with the last reader rather than waiting for
+            // reclaim
+            posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+            close(fd);
+            delete held;
+        });
+}
+
+void storeIntegrity(const std::string& recordId, const IntegrityRecord& record)
+{
+    auto path = integrityPath(recordId);
+    fs::create_directories(path.parent_path());
+
+    std::ofstream output(path.c_str());
+    cereal::JSONOutputArchive archive(output);
+    archive(cereal::make_nvp("integrity", record));
+}
+
+bool restoreIntegrity(const std::string& recordId, IntegrityRecord& record)
+{
+    auto path = integrityPath(recordId);
+    if (!fs::exists(path))
+    {
+        return false;
+    }
+
+    std::ifstream input(path.c_str(), std::ios::in);
+    try
+    {
+        cereal::JSONInputArchive archive(input);
+        archive(cereal::make_nvp("integrity", record));
+        return true;
+    }
+    catch (const cereal::RapidJSONException& e)
+    {
+        fs::remove(path);
+    }
+    return false;
+}
+
+void removeIntegrity(const std::string& recordId)
+{
+    std::error_code ec;
+    fs::remove(integrityPath(recordId), ec);
+}
+
+} // namespace updater
+} // namespace software
+} // namespace openpower
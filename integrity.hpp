@@ -0,0 +1,131 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace openpower
+{
+namespace software
+{
+namespace updater
+{
+
+/** @struct IntegrityRegion
+ *  @brief A contiguous range of an installed image and its expected digest.
+ */
+struct IntegrityRegion
+{
+    /** @brief Region name, e.g. a partition or volume name */
+    std::string name;
+
+    /** @brief Offset of the region in the backing device or file */
+    uint64_t offset = 0;
+
+    /** @brief Length of the region in bytes */
+    uint64_t length = 0;
+
+    /** @brief Hex encoded SHA-256 digest of the region */
+    std::string digest;
+};
+
+/** @struct IntegrityRecord
+ *  @brief The digests recorded for an installed image at activation time.
+ */
+struct IntegrityRecord
+{
+    /** @brief The regions to be re-verified by the scrubber */
+    std::vector<IntegrityRegion> regions;
+
+    /** @brief Modification time of the source the baseline was taken from,
+     *         used to invalidate trust-on-first-use records. 0 if unused.
+     */
+    int64_t stamp = 0;
+};
+
+/** @class Digest
+ *  @brief Incremental SHA-256 digest.
+ */
+class Digest
+{
+  public:
+    Digest();
+    ~Digest();
+    Digest(const Digest&) = delete;
+    Digest& operator=(const Digest&) = delete;
+
+    /** @brief Add data to the digest.
+     *
+     *  @param[in] data - The data
+     *  @param[in] size - The size of the data in bytes
+     */
+    void update(const void* data, size_t size);
+
+    /** @brief Complete the digest.
+     *
+     *  @return The hex encoded digest
+     */
+    std::string final();
+
+  private:
+    struct Context;
+    std::unique_ptr<Context> ctx;
+};
+
+/** @brief Compute the digest of a range of a file or device.
+ *
+ *  @param[in] path   - The file or device to read
+ *  @param[in] offset - The offset to start reading at
+ *  @param[in] length - The number of bytes to read
+ *
+ *  @return The hex encoded digest, or an empty string on read failure
+ */
+std::string digestRange(const std::filesystem::path& path, uint64_t offset,
+                        uint64_t length);
+
+/** @brief Compute the digest of a whole file.
+ *
+ *  @param[in] path - The file to read
+ *
+ *  @return The hex encoded digest, or an empty string on read failure
+ */
+std::string digestFile(const std::filesystem::path& path);
+
+/** @brief Open a file so that it can still be read once unlinked, e.g. an
+ *  image being digested after its image manager object is deleted.
+ *
+ *  @param[in] path - The file to open
+ *
+ *  @return The path the open file can be read from, which keeps the file
+ *          open until released, or nullptr if the file cannot be opened
+ */
+std::shared_ptr<const std::filesystem::path>
+    holdFile(const std::filesystem::path& path);
+
+/** @brief Store the integrity record of an installed image.
+ *
+ *  @param[in] recordId - The version id or name of the installed image
+ *  @param[in] record   - The record to store
+ */
+void storeIntegrity(const std::string& recordId, const IntegrityRecord& record);
+
+/** @brief Restore the integrity record of an installed image.
+ *
+ *  @param[in]  recordId - The version id or name of the installed image
+ *  @param[out] record   - The restored record
+ *
+ *  @return true if a record was restored, false if not
+ */
+bool restoreIntegrity(const std::string& recordId, IntegrityRecord& record);
+
+/** @brief Remove the integrity record of an installed image, if it exists.
+ *
+ *  @param[in] recordId - The version id or name of the installed image
+ */
+void removeIntegrity(const std::string& recordId);
+
+} // namespace updater
+} // namespace software
+} // namespace openpower
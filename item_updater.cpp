@@ -2,12 +2,20 @@
 
 #include "item_updater.hpp"
 
+#include "history.hpp"
+#include "msl_verify.hpp"
+#include "paths.hpp"
+#include "snapshot.hpp"
 #include "xyz/openbmc_project/Common/error.hpp"
 
 #include <phosphor-logging/elog-errors.hpp>
 #include <phosphor-logging/log.hpp>
+#include <sdeventplus/event.hpp>
+#include <sdeventplus/source/event.hpp>
 
+#include <algorithm>
 #include <filesystem>
+#include <memory>
 
 namespace openpower
 {
@@ -92,7 +100,8 @@ void ItemUpdater::createActivation(sdbusplus::message::message& m)
         // Determine the Activation state by processing the given image dir.
         auto activationState = server::Activation::Activations::Invalid;
         AssociationList associations = {};
-        if (validateImage(filePath))
+        if (validateImage(filePath) &&
+            image::verifyMinimumShipLevel(version))
         {
             activationState = server::Activation::Activations::Ready;
             // Create an association to the host inventory item
@@ -117,10 +126,133 @@ void ItemUpdater::createActivation(sdbusplus::message::message& m)
         auto versionPtr =
             createVersionObject(path, versionId, version, purpose, filePath);
         versions.emplace(versionId, std::move(versionPtr));
+
+        if (activationState == server::Activation::Activations::Ready)
+        {
+            findInstalledCopy(versionId, filePath);
+        }
     }
     return;
 }
 
+bool ItemUpdater::restoreDiscovered(const std::string& fingerprint)
+{
+    DiscoverySnapshot snapshot;
+    if (!restoreSnapshot(fingerprint, snapshot))
+    {
+        return false;
+    }
+
+    discovered = std::move(snapshot.versions);
+    discoveredFunctionalId = std::move(snapshot.functionalId);
+    log<level::INFO>("Restored the versions from the discovery snapshot",
+                     entry("VERSIONS=%zu", discovered.size()));
+    return true;
+}
+
+void ItemUpdater::storeDiscovered(const std::string& fingerprint)
+{
+    if (fingerprint.empty())
+    {
+        removeSnapshot();
+        return;
+    }
+
+    storeSnapshot({fingerprint, discovered, discoveredFunctionalId});
+}
+
+void ItemUpdater::publishPNORImages()
+{
+    using VersionPurpose = server::Version::VersionPurpose;
+
+    if (discovered.empty() && discoveredFunctionalId.empty())
+    {
+        return;
+    }
+
+    auto pending = std::move(discovered);
+    discovered.clear();
+    for (const auto& found : pending)
+    {
+        if (activations.find(found.versionId) != activations.end())
+        {
+            continue;
+        }
+
+        auto path = std::string{SOFTWARE_OBJPATH} + '/' + found.versionId;
+        auto active = (found.activationState ==
+                       server::Activation::Activations::Active);
+        AssociationList associations = {};
+
+        if (active)
+        {
+            // Create an association to the host inventory item
+            associations.emplace_back(std::make_tuple(
+                ACTIVATION_FWD_ASSOCIATION, ACTIVATION_REV_ASSOCIATION,
+                HOST_INVENTORY_PATH));
+
+            // Create an active association since this image is active
+            assocs.emplace_back(std::make_tuple(ACTIVE_FWD_ASSOCIATION,
+                                                ACTIVE_REV_ASSOCIATION, path));
+        }
+
+        // All updateable firmware components must expose the updateable
+        // association.
+        assocs.emplace_back(std::make_tuple(UPDATEABLE_FWD_ASSOCIATION,
+                                            UPDATEABLE_REV_ASSOCIATION, path));
+
+        auto activation = createActivationObject(
+            path, found.versionId, found.extendedVersion, found.activationState,
+            associations);
+        auto& activationRef = *activation;
+        activations.emplace(found.versionId, std::move(activation));
+
+        // If Active, create RedundancyPriority instance for this version.
+        if (active)
+        {
+            activationRef.redundancyPriority = createRedundancyPriorityObject(
+                path, activationRef, found.priority);
+        }
+
+        versions.emplace(found.versionId,
+                         createVersionObject(path, found.versionId,
+                                             found.version,
+                                             VersionPurpose::Host, ""));
+    }
+
+    // Emit the associations of all the versions at once
+    auto functionalId = std::move(discoveredFunctionalId);
+    discoveredFunctionalId.clear();
+    if (!functionalId.empty())
+    {
+        updateFunctionalAssociation(functionalId);
+
+        // The host firmware found on flash is checked once per boot of the
+        // updater, an uploaded image when it is validated
+        auto functional = std::find_if(
+            pending.begin(), pending.end(), [&functionalId](const auto& found) {
+                return found.versionId == functionalId;
+            });
+        if (functional != pending.end())
+        {
+            image::verifyMinimumShipLevel(functional->version);
+        }
+    }
+    else
+    {
+        associations(assocs);
+    }
+}
+
+std::unique_ptr<RedundancyPriority>
+    ItemUpdater::createRedundancyPriorityObject(const std::string& path,
+                                                Activation& activation,
+                                                uint8_t priority)
+{
+    return std::make_unique<RedundancyPriority>(bus, path, activation,
+                                                priority);
+}
+
 void ItemUpdater::createActiveAssociation(const std::string& path)
 {
     assocs.emplace_back(
@@ -173,15 +305,20 @@ void ItemUpdater::removeAssociation(const std::string& path)
 
 bool ItemUpdater::erase(std::string entryId)
 {
+    HistoryEntry history("Delete", entryId);
     if (isVersionFunctional(entryId) && isChassisOn())
     {
         log<level::ERR>(("Error: Version " + entryId +
                          " is currently active and running on the host."
                          " Unable to remove.")
                             .c_str());
+        history.finish(false);
         return false;
     }
 
+    installedCopies.erase(entryId);
+    corrupted.erase(entryId);
+
     // Removing entry in versions map
     auto it = versions.find(entryId);
     if (it == versions.end())
@@ -210,9 +347,260 @@ bool ItemUpdater::erase(std::string entryId)
         removeAssociation(ita->second->path);
         activations.erase(entryId);
     }
+
+    // Removing the digests recorded at activation
+    removeIntegrity(entryId);
+
+    history.finish(true);
+    return true;
+}
+
+std::vector<ScrubTarget> ItemUpdater::scrubTargets()
+{
+    return {};
+}
+
+void ItemUpdater::recordIntegrity(const std::string& versionId,
+                                  const fs::path& imagePath)
+{
+    // The version was written again, the old corruption is gone
+    clearCorruption(versionId);
+
+    // The image is removed along with its image manager object, hold it
+    // open until the worker thread is done digesting it.
+    auto image = holdFile(imagePath);
+    if (!image)
+    {
+        log<level::ERR>("Unable to open the image to record its digest",
+                        entry("VERSIONID=%s", versionId.c_str()),
+                        entry("IMAGE=%s", imagePath.c_str()));
+        return;
+    }
+
+    auto record = std::make_shared<std::optional<IntegrityRecord>>();
+    executor.post(
+        [this, image, record,
+         name = imagePath.filename().string()](std::stop_token token) {
+            *record = digestImage(*image, name, token);
+        },
+        [this, versionId, record]() {
+            if (!record->has_value())
+            {
+                log<level::ERR>("Unable to record the image digest",
+                                entry("VERSIONID=%s", versionId.c_str()));
+                return;
+            }
+            // The version may have been deleted meanwhile
+            if (activations.find(versionId) != activations.end())
+            {
+                storeIntegrity(versionId, **record);
+            }
+        });
+}
+
+fs::path ItemUpdater::imageFile(const fs::path&) const
+{
+    return {};
+}
+
+std::optional<IntegrityRecord>
+    ItemUpdater::digestImage(const fs::path& image, const std::string& name,
+                             std::stop_token) const
+{
+    std::error_code ec;
+    auto size = fs::file_size(image, ec);
+    auto digest = digestFile(image);
+    if (ec || digest.empty())
+    {
+        return std::nullopt;
+    }
+    IntegrityRecord record;
+    record.regions.push_back({name, 0, size, digest});
+    return record;
+}
+
+void ItemUpdater::findInstalledCopy(const std::string& versionId,
+                                    const fs::path& imageDir)
+{
+    auto imagePath = imageFile(imageDir);
+    if (imagePath.empty())
+    {
+        return;
+    }
+    auto image = holdFile(imagePath);
+    if (!image)
+    {
+        return;
+    }
+
+    auto record = std::make_shared<std::optional<IntegrityRecord>>();
+    executor.post(
+        [this, image, record,
+         name = imagePath.filename().string()](std::stop_token token) {
+            *record = digestImage(*image, name, token);
+        },
+        [this, versionId, record]() {
+            // The upload may have been deleted or activated meanwhile
+            auto upload = activations.find(versionId);
+            if (!record->has_value() || (upload == activations.end()) ||
+                (upload->second->activation() !=
+                 server::Activation::Activations::Ready))
+            {
+                return;
+            }
+
+            const auto& regions = (*record)->regions;
+            for (const auto& [id, activation] : activations)
+            {
+                IntegrityRecord installed;
+                if ((id == versionId) ||
+                    (activation->activation() !=
+                     server::Activation::Activations::Active) ||
+                    !restoreIntegrity(id, installed) ||
+                    !std::equal(regions.begin(), regions.end(),
+                                installed.regions.begin(),
+                                installed.regions.end(),
+                                [](const auto& a, const auto& b) {
+                                    return (a.name == b.name) &&
+                                           (a.offset == b.offset) &&
+                                           (a.length == b.length) &&
+                                           (a.digest == b.digest);
+                                }))
+                {
+                    continue;
+                }
+                log<level::INFO>("The uploaded image is already installed",
+                                 entry("VERSIONID=%s", versionId.c_str()),
+                                 entry("INSTALLED=%s", id.c_str()));
+                installedCopies[versionId] = id;
+                return;
+            }
+        });
+}
+
+void ItemUpdater::reclaimStaleImages()
+{
+    std::map<std::string, server::Activation::Activations> states;
+    for (const auto& [id, activation] : activations)
+    {
+        states.emplace(id, activation->activation());
+    }
+
+    for (const auto& id : removeStaleImages(states, paths::imgDir()))
+    {
+        log<level::INFO>("Reclaimed a stale uploaded image under memory "
+                         "pressure",
+                         entry("VERSIONID=%s", id.c_str()));
+        activations[id]->deleteImageManagerObject();
+    }
+}
+
+std::vector<std::string> removeStaleImages(
+    const std::map<std::string, server::Activation::Activations>& states,
+    const fs::path& imgDir)
+{
+    std::vector<std::string> removed;
+    for (const auto& [id, state] : states)
+    {
+        // The versions found on flash have no uploaded image
+        std::error_code ec;
+        if (((state != server::Activation::Activations::Failed) &&
+             (state != server::Activation::Activations::Invalid)) ||
+            !fs::exists(imgDir / id, ec))
+        {
+            continue;
+        }
+        if (fs::remove_all(imgDir / id, ec) == static_cast<uintmax_t>(-1))
+        {
+            log<level::ERR>("Unable to remove a stale uploaded image",
+                            entry("VERSIONID=%s", id.c_str()),
+                            entry("ERROR=%s", ec.message().c_str()));
+            continue;
+        }
+        removed.push_back(id);
+    }
+    return removed;
+}
+
+bool ItemUpdater::activateInstalledCopy(const std::string& versionId)
+{
+    auto copy = installedCopies.find(versionId);
+    if (copy == installedCopies.end())
+    {
+        return false;
+    }
+    auto installedId = copy->second;
+    installedCopies.erase(copy);
+
+    // The installed version may have been deleted meanwhile
+    auto installed = activations.find(installedId);
+    if ((installed == activations.end()) ||
+        (installed->second->activation() !=
+         server::Activation::Activations::Active))
+    {
+        return false;
+    }
+
+    log<level::INFO>("Activating the installed copy of the uploaded image",
+                     entry("VERSIONID=%s", versionId.c_str()),
+                     entry("INSTALLED=%s", installedId.c_str()));
+
+    // Boot the installed version next, as if the upload had been written
+    // over it. The functional association follows once the host runs it.
+    if (installed->second->redundancyPriority)
+    {
+        installed->second->redundancyPriority->priority(0);
+    }
+
+    // The upload holds nothing on flash, remove its objects once the
+    // property change that activated it is done.
+    sdeventplus::source::Defer(sdeventplus::Event(bus.get_event()),
+                               [this, versionId](auto& source) {
+                                   source.set_enabled(
+                                       sdeventplus::source::Enabled::Off);
+                                   erase(versionId);
+                               })
+        .set_floating(true);
     return true;
 }
 
+void ItemUpdater::flagCorruption(const std::string& versionId,
+                                 const std::string& region)
+{
+    // Every scrub pass finds the corruption again
+    if (!corrupted.insert(versionId).second)
+    {
+        return;
+    }
+
+    log<level::ERR>("Installed image failed integrity verification",
+                    entry("VERSIONID=%s", versionId.c_str()),
+                    entry("REGION=%s", region.c_str()));
+    report<InternalFailure>();
+
+    auto it = activations.find(versionId);
+    if (it == activations.end())
+    {
+        return;
+    }
+    if (!it->second->operationalStatus)
+    {
+        it->second->operationalStatus =
+            std::make_unique<OperationalStatus>(bus, it->second->path);
+    }
+}
+
+void ItemUpdater::clearCorruption(const std::string& versionId)
+{
+    corrupted.erase(versionId);
+
+    auto it = activations.find(versionId);
+    if (it != activations.end())
+    {
+        it->second->operationalStatus.reset();
+    }
+}
+
 bool ItemUpdater::isChassisOn()
 {
     auto mapperCall = bus.new_method_call(MAPPER_BUSNAME, MAPPER_PATH,
@@ -1,6 +1,9 @@
 #pragma once
 
 #include "activation.hpp"
+#include "executor.hpp"
+#include "integrity.hpp"
+#include "memory_pressure.hpp"
 #include "version.hpp"
 #include "xyz/openbmc_project/Collection/DeleteAll/server.hpp"
 
@@ -9,7 +12,14 @@
 #include <xyz/openbmc_project/Common/FactoryReset/server.hpp>
 #include <xyz/openbmc_project/Object/Enable/server.hpp>
 
+#include <chrono>
+#include <filesystem>
+#include <map>
+#include <optional>
+#include <set>
+#include <stop_token>
 #include <string>
+#include <vector>
 
 namespace openpower
 {
@@ -33,6 +43,52 @@ using AssociationList =
 
 constexpr auto GARD_PATH = "/org/open_power/control/gard";
 constexpr static auto volatilePath = "/org/open_power/control/volatile";
+constexpr auto workerThreads = 4;
+constexpr auto pressureStall = std::chrono::milliseconds(150);
+constexpr auto pressureWindow = std::chrono::seconds(1);
+
+/** @struct ScrubTarget
+ *  @brief An installed image region to be re-verified by the Scrubber.
+ */
+struct ScrubTarget
+{
+    /** @brief The id of the version the region belongs to, or the image name
+     *  when the image has no version object */
+    std::string versionId;
+
+    /** @brief The device or file the region is read from */
+    std::filesystem::path device;
+
+    /** @brief The region and its expected digest. An empty digest makes the
+     *  Scrubber record the digest it reads as the baseline. */
+    IntegrityRegion region;
+
+    /** @brief Stamp stored along with a baseline record */
+    int64_t stamp = 0;
+};
+
+/** @struct DiscoveredVersion
+ *  @brief A host version found on flash at startup, before its D-Bus objects
+ *  are created.
+ */
+struct DiscoveredVersion
+{
+    /** @brief The version id */
+    std::string versionId;
+
+    /** @brief The version string */
+    std::string version;
+
+    /** @brief The extended version string */
+    std::string extendedVersion;
+
+    /** @brief The activation state to publish */
+    sdbusplus::xyz::openbmc_project::Software::server::Activation::Activations
+        activationState;
+
+    /** @brief The redundancy priority, only used for an active version */
+    uint8_t priority = 0;
+};
 
 /** @class GardReset
  *  @brief OpenBMC GARD factory reset implementation.
@@ -46,11 +102,14 @@ class GardReset : public GardResetInherit
      *
      * @param[in] bus    - The Dbus bus object
      * @param[in] path   - The Dbus object path
+     * @param[in] parent - The item updater, whose factory reset excludes
+     *                     the GARD reset
      */
-    GardReset(sdbusplus::bus::bus& bus, const std::string& path) :
+    GardReset(sdbusplus::bus::bus& bus, const std::string& path,
+              const ItemUpdater& parent) :
         GardResetInherit(bus, path.c_str(),
                          GardResetInherit::action::emit_interface_added),
-        bus(bus), path(path)
+        bus(bus), path(path), parent(parent)
     {}
 
     virtual ~GardReset()
@@ -62,6 +121,9 @@ class GardReset : public GardResetInherit
     sdbusplus::bus::bus& bus;
     std::string path;
 
+    /** @brief The item updater */
+    const ItemUpdater& parent;
+
     /**
      * @brief GARD factory reset - clears the PNOR GARD partition.
      */
@@ -85,7 +147,10 @@ class ItemUpdater : public ItemUpdaterInherit
                      MatchRules::interfacesAdded() +
                          MatchRules::path("/xyz/openbmc_project/software"),
                      std::bind(std::mem_fn(&ItemUpdater::createActivation),
-                               this, std::placeholders::_1))
+                               this, std::placeholders::_1)),
+        memoryPressure(sdeventplus::Event(bus.get_event()), pressureStall,
+                       pressureWindow, [this]() { reclaimStaleImages(); }),
+        executor(sdeventplus::Event(bus.get_event()), workerThreads)
     {}
 
     virtual ~ItemUpdater() = default;
@@ -103,10 +168,18 @@ class ItemUpdater : public ItemUpdaterInherit
     virtual void freePriority(uint8_t value, const std::string& versionId) = 0;
 
     /**
-     * @brief Create and populate the active PNOR Version.
+     * @brief Find the active PNOR Versions on flash. Their D-Bus objects are
+     * only created by publishPNORImages(), so that the bus name can be
+     * claimed first.
      */
     virtual void processPNORImage() = 0;
 
+    /**
+     * @brief Create the D-Bus objects of the PNOR Versions found by
+     * processPNORImage(), and update the associations once for all of them.
+     */
+    void publishPNORImages();
+
     /** @brief Deletes version
      *
      *  @param[in] entryId - Id of the version to delete
@@ -172,6 +245,63 @@ class ItemUpdater : public ItemUpdaterInherit
     /** @brief Persistent ObjectEnable D-Bus object */
     std::unique_ptr<ObjectEnable> volatileEnable;
 
+    /** @brief Get the installed image regions to be re-verified
+     *
+     * @return - The regions with their backing device and the digest
+     *           recorded when the image was activated.
+     */
+    virtual std::vector<ScrubTarget> scrubTargets();
+
+    /** @brief Records the digests of a newly activated image for the
+     *  Scrubber. By default the whole image file is recorded as one region.
+     *
+     * @param[in] versionId - The id of the activated version.
+     * @param[in] imagePath - The image that was written to flash.
+     */
+    virtual void recordIntegrity(const std::string& versionId,
+                                 const std::filesystem::path& imagePath);
+
+    /** @brief Activates an upload whose content is already installed, by
+     *  giving the installed version the highest priority. Nothing is written
+     *  to flash, and the upload is removed once its activation is reported.
+     *
+     * @param[in] versionId - The id of the uploaded version.
+     *
+     * @return - Returns true if the upload was activated this way.
+     */
+    bool activateInstalledCopy(const std::string& versionId);
+
+    /** @brief Flags an installed version whose image no longer matches the
+     *  digest recorded at activation. The corruption is reported on its
+     *  first detection only, until the flag is cleared.
+     *
+     * @param[in] versionId - The id of the corrupted version.
+     * @param[in] region    - The name of the region that failed verification.
+     */
+    virtual void flagCorruption(const std::string& versionId,
+                                const std::string& region);
+
+    /** @brief Clears the corruption flag of a version whose image was
+     *  written again, or whose integrity record was rewritten
+     *
+     * @param[in] versionId - The id of the version.
+     */
+    void clearCorruption(const std::string& versionId);
+
+    /** @brief Check whether the host is running
+     *
+     * @return - Returns true if the Chassis is powered on.
+     */
+    bool isChassisOn();
+
+    /** @brief Whether a host factory reset is running. The GARD reset, the
+     *  activations and a second factory reset are rejected meanwhile.
+     */
+    bool resetInProgress() const
+    {
+        return resetting;
+    }
+
   protected:
     /** @brief Callback function for Software.Version match.
      *  @details Creates an Activation D-Bus object.
@@ -197,9 +327,61 @@ class ItemUpdater : public ItemUpdaterInherit
                                 Version::VersionPurpose versionPurpose,
                             const std::string& filePath) = 0;
 
+    /** @brief Create RedundancyPriority object */
+    virtual std::unique_ptr<RedundancyPriority>
+        createRedundancyPriorityObject(const std::string& path,
+                                       Activation& activation,
+                                       uint8_t priority);
+
     /** @brief Validate if image is valid or not */
     virtual bool validateImage(const std::string& path) = 0;
 
+    /** @brief Get the image of an upload that recordIntegrity() digests
+     *
+     * @param[in] imageDir - The directory the upload is extracted to
+     *
+     * @return The image file, or empty if its digests are not recorded
+     */
+    virtual std::filesystem::path
+        imageFile(const std::filesystem::path& imageDir) const;
+
+    /** @brief Compute the digests recorded for an image. Runs on a worker
+     *  thread. By default the whole image file is one region.
+     *
+     * @param[in] image - The image file to read
+     * @param[in] name  - The name of the image file
+     * @param[in] token - Stops the digest early
+     *
+     * @return The record, or nothing if the image cannot be read
+     */
+    virtual std::optional<IntegrityRecord>
+        digestImage(const std::filesystem::path& image,
+                    const std::string& name, std::stop_token token) const;
+
+    /** @brief Look for an installed version with the same content as an
+     *  upload, which can then be activated without writing to flash.
+     *
+     * @param[in] versionId - The id of the uploaded version
+     * @param[in] imageDir  - The directory the upload is extracted to
+     */
+    void findInstalledCopy(const std::string& versionId,
+                           const std::filesystem::path& imageDir);
+
+    /** @brief Fill the discovered versions from the discovery snapshot
+     *
+     * @param[in]  fingerprint - The fingerprint of the current flash state
+     *
+     * @return true if the snapshot matched and was used
+     */
+    bool restoreDiscovered(const std::string& fingerprint);
+
+    /** @brief Store the discovered versions in the discovery snapshot, so
+     * that the next start with the same flash state can skip reading them.
+     *
+     * @param[in]  fingerprint - The fingerprint of the current flash state
+     */
+    void storeDiscovered(const std::string& fingerprint);
+
     /** @brief Persistent sdbusplus D-Bus bus connection. */
     sdbusplus::bus::bus& bus;
 
@@ -211,6 +393,17 @@ class ItemUpdater : public ItemUpdaterInherit
      * version id */
     std::map<std::string, std::unique_ptr<Version>> versions;
 
+    /** @brief Versions found on flash and not yet published */
+    std::vector<DiscoveredVersion> discovered;
+
+    /** @brief The id of the functional version found on flash, to be
+     * published along with the discovered versions */
+    std::string discoveredFunctionalId;
+
+    /** @brief The uploads whose content is already installed, and the id
+     * of the installed version */
+    std::map<std::string, std::string> installedCopies;
+
     /** @brief sdbusplus signal match for Software.Version */
     sdbusplus::bus::match_t versionMatch;
 
@@ -221,13 +414,40 @@ class ItemUpdater : public ItemUpdaterInherit
      * Activation D-Bus object */
     void reset() override = 0;
 
-    /** @brief Check whether the host is running
-     *
-     * @return - Returns true if the Chassis is powered on.
+    /** @brief Deletes the uploaded images of the versions that failed to
+     *  validate or to activate, which are otherwise kept in RAM until they
+     *  are deleted or activated again. Their Activation is kept, only a
+     *  Delete from the operator removes the version.
      */
-    bool isChassisOn();
+    void reclaimStaleImages();
+
+    /** @brief The versions flagged as corrupted, reported once until their
+     *  flag is cleared */
+    std::set<std::string> corrupted;
+
+    /** @brief Whether a host factory reset is running */
+    bool resetting = false;
+
+    /** @brief Reclaims the stale images when memory runs short */
+    MemoryPressure memoryPressure;
+
+    /** @brief Runs the filesystem and hashing work off the event loop */
+    Executor executor;
 };
 
+/** @brief Remove the staged images of the versions that failed to validate
+ *  or to activate
+ *
+ *  @param[in] states - The activation state of each version
+ *  @param[in] imgDir - The directory of the staged images
+ *
+ *  @return The ids of the versions whose image was removed
+ */
+std::vector<std::string> removeStaleImages(
+    const std::map<std::string, sdbusplus::xyz::openbmc_project::Software::
+                                    server::Activation::Activations>& states,
+    const std::filesystem::path& imgDir);
+
 } // namespace updater
 } // namespace software
 } // namespace openpower
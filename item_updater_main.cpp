@@ -2,20 +2,34 @@
 
 #ifdef UBIFS_LAYOUT
 #include "ubi/item_updater_ubi.hpp"
+#include "ubi/volumes.hpp"
 #include "ubi/watch.hpp"
 #elif defined MMC_LAYOUT
+#include "mmc/fsverity.hpp"
+#include "mmc/host_lids.hpp"
 #include "mmc/item_updater_mmc.hpp"
+#include "mmc/shadow.hpp"
 #else
 #include "static/item_updater_static.hpp"
 #endif
+#include "bench.hpp"
+#include "flash_health.hpp"
 #include "functions.hpp"
+#include "history.hpp"
+#include "loop_monitor.hpp"
+#include "paths.hpp"
+#include "scrubber.hpp"
 
 #include <CLI/CLI.hpp>
 #include <phosphor-logging/log.hpp>
 #include <sdbusplus/bus.hpp>
 #include <sdbusplus/server/manager.hpp>
 #include <sdeventplus/event.hpp>
+#include <sdeventplus/source/event.hpp>
 
+#include <algorithm>
+#include <chrono>
+#include <iostream>
 #include <map>
 #include <memory>
 #include <string>
@@ -28,8 +42,12 @@ namespace software
 {
 namespace updater
 {
-void initializeService(sdbusplus::bus::bus& bus)
+LoopMonitor& initializeService(sdbusplus::bus::bus& bus,
+                               sdeventplus::Event& loop)
 {
+    using namespace phosphor::logging;
+    auto start = std::chrono::steady_clock::now();
+
     static sdbusplus::server::manager::manager objManager(bus,
                                                           SOFTWARE_OBJPATH);
 #ifdef UBIFS_LAYOUT
@@ -43,7 +61,29 @@ void initializeService(sdbusplus::bus::bus& bus)
 #else
     static ItemUpdaterStatic updater(bus, SOFTWARE_OBJPATH);
 #endif
+    static Scrubber scrubber(bus, loop, updater);
+#ifndef MMC_LAYOUT
+    static FlashHealth flashHealth(bus, loop);
+#endif
+    static History history(bus);
     bus.request_name(BUSNAME_UPDATER);
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start);
+    log<level::INFO>("Claimed the updater bus name",
+                     entry("ELAPSED_MS=%lld",
+                           static_cast<long long>(elapsed.count())));
+
+    // The versions found on flash are published on the first loop iteration,
+    // ahead of any request that may refer to them.
+    static sdeventplus::source::Defer publish(loop, [](auto& source) {
+        source.set_enabled(sdeventplus::source::Enabled::Off);
+        updater.publishPNORImages();
+    });
+    publish.set_priority(SD_EVENT_PRIORITY_IMPORTANT);
+
+    static LoopMonitor monitor(bus, loop);
+    return monitor;
 }
 } // namespace updater
 } // namespace software
@@ -77,7 +117,8 @@ int main(int argc, char* argv[])
         app.add_subcommand("process-host-firmware",
                            "Point the host firmware at its data.")
             ->callback([&bus, &loop, &subcommandContext, extensionMap]() {
-                auto hostFirmwareDirectory = "/media/hostfw/running"s;
+                auto hostFirmwareDirectory =
+                    paths::mediaDir() + "hostfw/running";
                 auto logCallback = [](const auto& path, auto& ec) {
                     std::cerr << path << ": " << ec.message() << "\n";
                 };
@@ -102,16 +143,125 @@ int main(int argc, char* argv[])
                 }
             }));
 
+    BenchOptions benchOptions;
+    auto benchCommand = app.add_subcommand(
+        "bench", "Measure the flash, digest and copy throughput of this "
+                 "system and print it as JSON.");
+    benchCommand->add_option("--size", benchOptions.sizeMiB,
+                             "MiB moved by each throughput measurement.");
+    benchCommand->add_option("--read-device", benchOptions.readDevice,
+                             "MTD or UBI volume device to read.");
+    benchCommand->add_option("--scratch-mtd", benchOptions.scratchMtd,
+                             "MTD device to erase and write, its content is "
+                             "lost.");
+    benchCommand->add_option("--image", benchOptions.image,
+                             "PNOR image to scan for erased pages, and to "
+                             "program to the scratch MTD device.");
+    benchCommand->add_option("--ubi-scratch", benchOptions.ubiScratch,
+                             "UBI device of the host volumes, such as "
+                             "/dev/ubi1, to write a temporary volume to.");
+    benchCommand->add_option("--scratch-dir", benchOptions.scratchDir,
+                             "Directory on a host filesystem, such as a pnor "
+                             "UBIFS volume, for the small file and copy "
+                             "measurements.");
+    benchCommand->add_option("--copy-source", benchOptions.copySource,
+                             "Directory copied by the copy measurement.");
+    static_cast<void>(benchCommand->callback([&loop, &benchOptions]() {
+        std::cout << runBench(benchOptions).dump(4) << "\n";
+        loop.exit(0);
+    }));
+
+    static_cast<void>(
+        app.add_subcommand("history",
+                           "Print the activations, resets and deletes done "
+                           "by the updater as JSON.")
+            ->callback([&loop]() {
+                std::cout << historyToJson(restoreHistory()).dump(4) << "\n";
+                loop.exit(0);
+            }));
+
+#ifdef UBIFS_LAYOUT
+    static_cast<void>(
+        app.add_subcommand("ubi-remount",
+                           "Mount the host firmware UBI volumes after a "
+                           "reboot.")
+            ->callback([&loop]() { loop.exit(remountVolumes() ? 0 : 1); }));
+
+    std::string writeVersionId;
+    auto writeCommand = app.add_subcommand(
+        "ubi-write-ro", "Write the RO volume of a version being activated, "
+                        "resuming an interrupted write.");
+    writeCommand->add_option("version-id", writeVersionId, "The version id.")
+        ->required();
+    static_cast<void>(writeCommand->callback([&loop, &writeVersionId]() {
+        loop.exit(writeReadOnlyVolume(writeVersionId) ? 0 : 1);
+    }));
+#endif
+
+#if !defined UBIFS_LAYOUT && !defined MMC_LAYOUT
+    std::string pnorImage;
+    auto programCommand = app.add_subcommand(
+        "static-write", "Erase the PNOR flash and program an image to it, "
+                        "skipping its erased pages.");
+    programCommand->add_option("image", pnorImage, "The PNOR image file.")
+        ->required();
+    static_cast<void>(programCommand->callback([&loop, &pnorImage]() {
+        loop.exit(writePnorImage(pnorImage) ? 0 : 1);
+    }));
+#endif
+
+#ifdef MMC_LAYOUT
+    bool enableVerity = false;
+    auto verifyCommand = app.add_subcommand(
+        "verify-host-firmware", "Check the host firmware LIDs against their "
+                                "signed fs-verity digests.");
+    verifyCommand->add_flag("--enable", enableVerity,
+                            "Enable fs-verity on the running LIDs first.");
+    static_cast<void>(verifyCommand->callback([&loop, &enableVerity]() {
+        auto roDir = paths::mediaDir() + "hostfw/running-ro";
+        auto runningDir = paths::mediaDir() + "hostfw/running";
+
+        // The host writes to the preserved partitions, their LIDs differ from
+        // the image and fs-verity would make them immutable
+        auto lids = listLids(runningDir);
+        for (const auto& lid : preservedLids(runningDir))
+        {
+            lids.erase(std::remove(lids.begin(), lids.end(), lid), lids.end());
+        }
+        auto valid = verifyLids(runningDir, roDir, lids, enableVerity);
+
+        // The boot side is mounted read-only without fs-verity, its LIDs are
+        // checked by the digest of their content
+        valid = verifyLids(roDir, roDir, listLids(roDir), false) && valid;
+        loop.exit(valid ? 0 : 1);
+    }));
+
+    std::string bootLabel;
+    auto switchCommand = app.add_subcommand(
+        "switch-host-side", "Switch the running host firmware LIDs to the "
+                            "shadow tree of the boot side.");
+    switchCommand->add_option("boot-side", bootLabel, "The boot side, a or b.")
+        ->required();
+    static_cast<void>(switchCommand->callback([&loop, &bootLabel]() {
+        auto hostfwDir = paths::mediaDir() + "hostfw";
+        auto switched =
+            switchShadow(hostfwDir, bootLabel, hostfwDir + "/running-ro");
+        loop.exit(switched ? 0 : 1);
+    }));
+#endif
+
     CLI11_PARSE(app, argc, argv);
 
+    LoopMonitor* monitor = nullptr;
     if (app.get_subcommands().size() == 0)
     {
-        initializeService(bus);
+        monitor = &initializeService(bus, loop);
     }
 
+    int rc = 0;
     try
     {
-        auto rc = loop.loop();
+        rc = monitor ? monitor->run() : loop.loop();
         if (rc < 0)
         {
             log<level::ERR>("Error occurred during the sd_event_loop",
@@ -125,5 +275,5 @@ int main(int argc, char* argv[])
         return -1;
     }
 
-    return 0;
+    return rc;
 }
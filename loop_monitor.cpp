@@ -0,0 +1,207 @@
+#include "loop_monitor.hpp"
+
+#include <systemd/sd-daemon.h>
+
+#include <phosphor-logging/log.hpp>
+#include <sdbusplus/message.hpp>
+
+#include <algorithm>
+
+namespace openpower
+{
+namespace software
+{
+namespace updater
+{
+
+using namespace phosphor::logging;
+
+namespace
+{
+
+/** @brief Dispatches slower than this are logged. It is well below the
+ *  D-Bus call timeout of the clients, so that they are seen before a client
+ *  gives up on the updater.
+ */
+constexpr auto slowDispatch = std::chrono::milliseconds(250);
+
+/** @brief The handler run by the current dispatch */
+std::string currentHandler;
+
+} // namespace
+
+void labelDispatch(const std::string& name)
+{
+    if (currentHandler.empty())
+    {
+        currentHandler = name;
+    }
+}
+
+void DispatchHistogram::record(std::chrono::microseconds elapsed)
+{
+    auto us = static_cast<uint64_t>(elapsed.count());
+    auto bucket = std::upper_bound(bounds.begin(), bounds.end(), us) -
+                  bounds.begin();
+    buckets[bucket]++;
+}
+
+const sdbusplus::vtable::vtable_t LoopMonitor::vtable[] = {
+    sdbusplus::vtable::start(),
+    sdbusplus::vtable::property("Dispatches", "t", LoopMonitor::getProperty,
+                                sdbusplus::vtable::property_::none),
+    sdbusplus::vtable::property("SlowDispatches", "t",
+                                LoopMonitor::getProperty,
+                                sdbusplus::vtable::property_::none),
+    sdbusplus::vtable::property("SlowestDispatchUs", "t",
+                                LoopMonitor::getProperty,
+                                sdbusplus::vtable::property_::none),
+    sdbusplus::vtable::property("SlowestHandler", "s",
+                                LoopMonitor::getProperty,
+                                sdbusplus::vtable::property_::none),
+    sdbusplus::vtable::property("HistogramBoundsUs", "at",
+                                LoopMonitor::getProperty,
+                                sdbusplus::vtable::property_::const_),
+    sdbusplus::vtable::property("Histogram", "at", LoopMonitor::getProperty,
+                                sdbusplus::vtable::property_::none),
+    sdbusplus::vtable::end()};
+
+LoopMonitor::LoopMonitor(sdbusplus::bus::bus& bus,
+                         const sdeventplus::Event& event) :
+    event(event),
+    interface(bus, LOOP_HEALTH_PATH, LOOP_HEALTH_INTERFACE, vtable, this)
+{
+    auto rc = sd_bus_add_filter(bus.get(), &slot, filter, this);
+    if (rc < 0)
+    {
+        log<level::ERR>("Failed to add the D-Bus dispatch filter",
+                        entry("RC=%d", rc));
+    }
+
+    uint64_t timeoutUs = 0;
+    if (sd_watchdog_enabled(0, &timeoutUs) > 0)
+    {
+        // Feed it well within the timeout, a loop running at all is late
+        // by far less than that
+        auto interval = std::chrono::microseconds(timeoutUs / 4);
+        watchdog.emplace(
+            event, [](auto&) { sd_notify(0, "WATCHDOG=1"); }, interval);
+        log<level::INFO>("Feeding the systemd watchdog",
+                         entry("INTERVAL_US=%llu",
+                               static_cast<unsigned long long>(
+                                   interval.count())));
+    }
+}
+
+LoopMonitor::~LoopMonitor()
+{
+    sd_bus_slot_unref(slot);
+}
+
+int LoopMonitor::run()
+{
+    using Clock = std::chrono::steady_clock;
+
+    while (event.get_state() != SD_EVENT_FINISHED)
+    {
+        // As sd_event_run(), each dispatch runs a single event source
+        if ((event.prepare() == 0) && (event.wait(std::nullopt) == 0))
+        {
+            continue;
+        }
+
+        currentHandler.clear();
+        auto start = Clock::now();
+        event.dispatch();
+        record(std::chrono::duration_cast<std::chrono::microseconds>(
+            Clock::now() - start));
+    }
+    return event.get_exit_code();
+}
+
+void LoopMonitor::record(std::chrono::microseconds elapsed)
+{
+    dispatches++;
+    histogram.record(elapsed);
+    if (elapsed < slowDispatch)
+    {
+        return;
+    }
+
+    auto handler =
+        currentHandler.empty() ? std::string("event source") : currentHandler;
+    auto us = static_cast<uint64_t>(elapsed.count());
+    slowDispatches++;
+    if (us > slowestUs)
+    {
+        slowestUs = us;
+        slowestHandler = handler;
+    }
+    log<level::WARNING>(
+        "Slow event loop dispatch", entry("HANDLER=%s", handler.c_str()),
+        entry("ELAPSED_MS=%llu", static_cast<unsigned long long>(us / 1000)));
+}
+
+int LoopMonitor::filter(sd_bus_message* msg, void*, sd_bus_error*)
+{
+    uint8_t type = 0;
+    sd_bus_message_get_type(msg, &type);
+    if ((type == SD_BUS_MESSAGE_METHOD_CALL) ||
+        (type == SD_BUS_MESSAGE_SIGNAL))
+    {
+        auto interface = sd_bus_message_get_interface(msg);
+        auto member = sd_bus_message_get_member(msg);
+        auto path = sd_bus_message_get_path(msg);
+        labelDispatch(std::string(interface ? interface : "") + "." +
+                      (member ? member : "") + " " + (path ? path : ""));
+    }
+    else
+    {
+        labelDispatch("D-Bus reply");
+    }
+    return 0;
+}
+
+int LoopMonitor::getProperty(sd_bus*, const char*, const char*,
+                             const char* property, sd_bus_message* reply,
+                             void* context, sd_bus_error*)
+{
+    auto monitor = static_cast<LoopMonitor*>(context);
+    auto m = sdbusplus::message::message(reply);
+    std::string name(property);
+
+    if (name == "Dispatches")
+    {
+        m.append(monitor->dispatches);
+    }
+    else if (name == "SlowDispatches")
+    {
+        m.append(monitor->slowDispatches);
+    }
+    else if (name == "SlowestDispatchUs")
+    {
+        m.append(monitor->slowestUs);
+    }
+    else if (name == "SlowestHandler")
+    {
+        m.append(monitor->slowestHandler);
+    }
+    else if (name == "HistogramBoundsUs")
+    {
+        m.append(std::vector<uint64_t>(DispatchHistogram::bounds.begin(),
+                                       DispatchHistogram::bounds.end()));
+    }
+    else if (name == "Histogram")
+    {
+        m.append(monitor->histogram.counts());
+    }
+    else
+    {
+        return -EINVAL;
+    }
+    return 1;
+}
+
+} // namespace updater
+} // namespace software
+} // namespace openpower
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <sdbusplus/bus.hpp>
+#include <sdbusplus/server/interface.hpp>
+#include <sdbusplus/vtable.hpp>
+#include <sdeventplus/clock.hpp>
+#include <sdeventplus/event.hpp>
+#include <sdeventplus/utility/timer.hpp>
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace openpower
+{
+namespace software
+{
+namespace updater
+{
+
+constexpr auto LOOP_HEALTH_PATH = "/org/open_power/control/loop_health";
+constexpr auto LOOP_HEALTH_INTERFACE =
+    "org.open_power.Software.Host.LoopHealth";
+
+using WatchdogTimer =
+    sdeventplus::utility::Timer<sdeventplus::ClockId::Monotonic>;
+
+/** @brief Name the handler run by the current event loop dispatch, e.g. the
+ *  D-Bus member called. The first name given in a dispatch is kept.
+ *
+ *  @param[in] name - The handler name
+ */
+void labelDispatch(const std::string& name);
+
+/** @class DispatchHistogram
+ *  @brief Counts the event loop dispatches by their run time, in buckets
+ *  four times as wide as the previous one.
+ */
+class DispatchHistogram
+{
+  public:
+    /** @brief The exclusive upper bounds of the buckets in microseconds.
+     *  The last bucket counts the dispatches past the last bound. */
+    static constexpr std::array<uint64_t, 7> bounds = {
+        1000, 4000, 16000, 64000, 256000, 1024000, 4096000};
+
+    DispatchHistogram() : buckets(bounds.size() + 1)
+    {}
+
+    /** @brief Count a dispatch
+     *
+     *  @param[in] elapsed - The run time of the dispatch
+     */
+    void record(std::chrono::microseconds elapsed);
+
+    /** @brief The dispatch count of each bucket */
+    const std::vector<uint64_t>& counts() const
+    {
+        return buckets;
+    }
+
+  private:
+    /** @brief The dispatch count of each bucket */
+    std::vector<uint64_t> buckets;
+};
+
+/** @class LoopMonitor
+ *  @brief Runs the event loop, timing each of its dispatches.
+ *  @details Every dispatch runs a single event source. The dispatches
+ *  slower than a threshold are logged with the handler they ran, which is
+ *  the D-Bus message being processed or a name given by labelDispatch().
+ *  The counts are published on D-Bus. When the service has a WatchdogSec,
+ *  the systemd watchdog is fed by a timer of the loop itself, so a stalled
+ *  loop stops feeding it and gets the updater restarted.
+ */
+class LoopMonitor
+{
+  public:
+    LoopMonitor() = delete;
+    LoopMonitor(const LoopMonitor&) = delete;
+    LoopMonitor& operator=(const LoopMonitor&) = delete;
+    LoopMonitor(LoopMonitor&&) = delete;
+    LoopMonitor& operator=(LoopMonitor&&) = delete;
+
+    /** @brief Constructs LoopMonitor
+     *
+     * @param[in] bus   - The D-Bus bus object, attached to the event loop
+     * @param[in] event - The event loop
+     */
+    LoopMonitor(sdbusplus::bus::bus& bus, const sdeventplus::Event& event);
+
+    ~LoopMonitor();
+
+    /** @brief Run the event loop until it exits
+     *
+     *  @return The exit code of the event loop
+     */
+    int run();
+
+  private:
+    /** @brief Count a dispatch, and log it if slow */
+    void record(std::chrono::microseconds elapsed);
+
+    /** @brief sd-bus filter naming the dispatch after the message */
+    static int filter(sd_bus_message* msg, void* context,
+                      sd_bus_error* error);
+
+    /** @brief sd-bus property getter for all the properties */
+    static int getProperty(sd_bus* bus, const char* path,
+                           const char* interface, const char* property,
+                           sd_bus_message* reply, void* context,
+                           sd_bus_error* error);
+
+    /** @brief The D-Bus interface description */
+    static const sdbusplus::vtable::vtable_t vtable[];
+
+    /** @brief The event loop */
+    sdeventplus::Event event;
+
+    /** @brief The dispatches by run time */
+    DispatchHistogram histogram;
+
+    /** @brief The number of dispatches */
+    uint64_t dispatches = 0;
+
+    /** @brief The number of dispatches slower than the threshold */
+    uint64_t slowDispatches = 0;
+
+    /** @brief The run time of the slowest dispatch in microseconds */
+    uint64_t slowestUs = 0;
+
+    /** @brief The handler run by the slowest dispatch */
+    std::string slowestHandler;
+
+    /** @brief The D-Bus filter slot */
+    sd_bus_slot* slot = nullptr;
+
+    /** @brief The D-Bus interface */
+    sdbusplus::server::interface::interface interface;
+
+    /** @brief Feeds the systemd watchdog, when enabled */
+    std::optional<WatchdogTimer> watchdog;
+};
+
+} // namespace updater
+} // namespace software
+} // namespace openpower
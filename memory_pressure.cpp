@@ -0,0 +1,78 @@
+#include "memory_pressure.hpp"
+
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+#include <phosphor-logging/log.hpp>
+
+#include <cerrno>
+#include <string>
+
+namespace openpower
+{
+namespace software
+{
+namespace updater
+{
+
+using namespace phosphor::logging;
+
+namespace
+{
+
+constexpr auto memoryPressureFile = "/proc/pressure/memory";
+
+} // namespace
+
+MemoryPressure::MemoryPressure(const sdeventplus::Event& event,
+                               std::chrono::microseconds stall,
+                               std::chrono::microseconds window,
+                               Callback callback) :
+    callback(std::move(callback))
+{
+    fd = open(memoryPressureFile, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0)
+    {
+        log<level::INFO>("Memory pressure is not monitored",
+                         entry("ERRNO=%d", errno));
+        return;
+    }
+
+    // The trigger is written with its terminating NUL
+    auto trigger = "some " + std::to_string(stall.count()) + " " +
+                   std::to_string(window.count());
+    if (write(fd, trigger.c_str(), trigger.size() + 1) < 0)
+    {
+        log<level::ERR>("Failed to set the memory pressure trigger",
+                        entry("TRIGGER=%s", trigger.c_str()),
+                        entry("ERRNO=%d", errno));
+        close(fd);
+        fd = -1;
+        return;
+    }
+
+    source.emplace(event, fd, EPOLLPRI,
+                   [this](sdeventplus::source::IO& io, int, uint32_t events) {
+                       if (events & EPOLLERR)
+                       {
+                           // The trigger is gone, e.g. PSI was disabled
+                           io.set_enabled(sdeventplus::source::Enabled::Off);
+                           return;
+                       }
+                       this->callback();
+                   });
+}
+
+MemoryPressure::~MemoryPressure()
+{
+    source.reset();
+    if (fd >= 0)
+    {
+        close(fd);
+    }
+}
+
+} // namespace updater
+} // namespace software
+} // namespace openpower
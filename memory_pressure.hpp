@@ -0,0 +1,62 @@
+#pragma once
+
+#include <sdeventplus/event.hpp>
+#include <sdeventplus/source/io.hpp>
+
+#include <chrono>
+#include <functional>
+#include <optional>
+
+namespace openpower
+{
+namespace software
+{
+namespace updater
+{
+
+/** @class MemoryPressure
+ *  @brief Calls back when the system stalls on memory, using a PSI trigger
+ *  on /proc/pressure/memory.
+ *  @details The kernel signals the trigger when the tasks spent more than
+ *  the stall time waiting for memory within the window, and at most once
+ *  per window. Nothing is monitored when the kernel has no PSI support.
+ */
+class MemoryPressure
+{
+  public:
+    /** @brief The callback, run on the event loop */
+    using Callback = std::function<void()>;
+
+    MemoryPressure() = delete;
+    MemoryPressure(const MemoryPressure&) = delete;
+    MemoryPressure& operator=(const MemoryPressure&) = delete;
+    MemoryPressure(MemoryPressure&&) = delete;
+    MemoryPressure& operator=(MemoryPressure&&) = delete;
+
+    /** @brief Constructs MemoryPressure
+     *
+     * @param[in] event    - The event loop to run the callback on
+     * @param[in] stall    - The stall time that triggers the callback
+     * @param[in] window   - The window the stall time is measured over
+     * @param[in] callback - The callback
+     */
+    MemoryPressure(const sdeventplus::Event& event,
+                   std::chrono::microseconds stall,
+                   std::chrono::microseconds window, Callback callback);
+
+    ~MemoryPressure();
+
+  private:
+    /** @brief The PSI trigger file descriptor */
+    int fd = -1;
+
+    /** @brief The callback */
+    Callback callback;
+
+    /** @brief The event source watching the trigger */
+    std::optional<sdeventplus::source::IO> source;
+};
+
+} // namespace updater
+} // namespace software
+} // namespace openpower
@@ -1,5 +1,24 @@
+#include "config.h"
+
 #include "activation_mmc.hpp"
 
+#include "fsverity.hpp"
+#include "host_lids.hpp"
+#include "item_updater.hpp"
+#include "paths.hpp"
+#include "shadow.hpp"
+
+#include <sys/mount.h>
+
+#include <phosphor-logging/log.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <deque>
+#include <memory>
+
 namespace openpower
 {
 namespace software
@@ -8,19 +27,405 @@ namespace updater
 {
 namespace softwareServer = sdbusplus::xyz::openbmc_project::Software::server;
 
+using namespace phosphor::logging;
+
+namespace
+{
+
+/** @brief The hostfw directory, holding the sides */
+fs::path hostfwPath()
+{
+    return fs::path(paths::mediaDir()) / "hostfw";
+}
+
+/** @brief The alternate side, mounted under the hostfw directory */
+fs::path alternatePath()
+{
+    return hostfwPath() / "alternate";
+}
+
+/** @brief The activation writing the alternate side, and the activations
+ *  waiting for it in the order they were requested. There is a single
+ *  alternate side, only used on the event loop.
+ */
+ActivationMMC* sideWriter = nullptr;
+std::deque<ActivationMMC*> sideWaiting;
+
+/** @brief Whether a worker compares or writes the alternate side. A
+ *  cancelled worker keeps the side until it returns, even once its
+ *  activation gave the side up.
+ */
+bool sideBusy = false;
+
+/** @brief Point the next host IPL at a hostfw side
+ *
+ *  @param[in] label - The side, a or b
+ *
+ *  @return true if the boot side is switched
+ */
+bool setBootSide(const std::string& label)
+{
+    auto cmd = "fw_setenv bootside " + label;
+    if (std::system(cmd.c_str()) != 0)
+    {
+        log<level::ERR>("Unable to switch the boot side",
+                        entry("BOOTSIDE=%s", label.c_str()));
+        return false;
+    }
+    return true;
+}
+
+/** @brief Write the changed LIDs to the alternate side, verify them, and
+ *  switch the boot side to it. Runs on a worker thread.
+ *
+ *  @param[in]     imageDir - The directory of the uploaded image
+ *  @param[in]     changed  - The LIDs to write
+ *  @param[in]     stale    - The LIDs to remove
+ *  @param[in]     label    - The alternate side
+ *  @param[in,out] done     - The bytes written, then the bytes read back
+ *  @param[in]     token    - Stops the write early
+ *
+ *  @return true if the alternate side holds the image and boots next
+ */
+bool writeAlternate(const fs::path& imageDir,
+                    const std::vector<std::string>& changed,
+                    const std::vector<std::string>& stale,
+                    const std::string& label, std::atomic<uint64_t>& done,
+                    std::stop_token token)
+{
+    auto alternateDir = alternatePath();
+
+    // A previous update may have pointed the boot side at the alternate
+    // side, the host boots the running side until this one is verified
+    if (!setBootSide((label == "a") ? "b" : "a"))
+    {
+        return false;
+    }
+
+    // The alternate side is mounted read-only except while it is written
+    if (mount(nullptr, alternateDir.c_str(), nullptr, MS_REMOUNT, nullptr) !=
+        0)
+    {
+        log<level::ERR>("Unable to mount the alternate side read-write",
+                        entry("DIR=%s", alternateDir.c_str()),
+                        entry("ERRNO=%d", errno));
+        return false;
+    }
+
+    std::error_code ec;
+    for (const auto& lid : stale)
+    {
+        fs::remove(alternateDir / lid, ec);
+    }
+
+    bool written = true;
+    for (const auto& lid : changed)
+    {
+        if (!writeLid(imageDir / lid, alternateDir, done, token))
+        {
+            written = false;
+            break;
+        }
+    }
+    if (written)
+    {
+        // Make the renames durable before the boot side points here
+        sync();
+        for (const auto& lid : changed)
+        {
+            if (!readBackLid(imageDir / lid, alternateDir / lid))
+            {
+                written = false;
+                break;
+            }
+            done += fs::file_size(imageDir / lid, ec);
+        }
+    }
+    if (written)
+    {
+        // The side carries the signed digest list of its LIDs
+        std::atomic<uint64_t> listDone = 0;
+        for (const auto& file :
+             {std::string(verityListFile),
+              std::string(verityListFile) + SIGNATURE_FILE_EXT})
+        {
+            if (fs::exists(imageDir / file, ec))
+            {
+                written = written &&
+                          writeLid(imageDir / file, alternateDir, listDone, {});
+            }
+            else
+            {
+                fs::remove(alternateDir / file, ec);
+            }
+        }
+    }
+
+    // Every LID the side boots from, written or already there, must be in
+    // the signed digest list and match it
+    auto lids = listLids(imageDir);
+#ifndef WANT_SIGNATURE_VERIFY
+    if (!fs::exists(imageDir / verityListFile, ec))
+    {
+        // Without signature verification an image may have no digest list,
+        // its LIDs were read back against the image
+        lids.clear();
+    }
+#endif
+    written = written && verifyLids(alternateDir, imageDir, lids, true);
+
+    if (mount(nullptr, alternateDir.c_str(), nullptr, MS_REMOUNT | MS_RDONLY,
+              nullptr) != 0)
+    {
+        log<level::ERR>("Unable to mount the alternate side read-only",
+                        entry("DIR=%s", alternateDir.c_str()),
+                        entry("ERRNO=%d", errno));
+    }
+    if (!written)
+    {
+        return false;
+    }
+
+    // The next host IPL repopulates the running LIDs from the boot side
+    return setBootSide(label);
+}
+
+} // namespace
+
+ActivationMMC::~ActivationMMC()
+{
+    work.request_stop();
+    releaseSide();
+}
+
+bool ActivationMMC::takeSide()
+{
+    if (sideWriter == this)
+    {
+        return true;
+    }
+    if (!sideWriter && !sideBusy)
+    {
+        sideWriter = this;
+        return true;
+    }
+    if (std::find(sideWaiting.begin(), sideWaiting.end(), this) ==
+        sideWaiting.end())
+    {
+        log<level::INFO>("Waiting for another activation to finish writing "
+                         "the alternate side",
+                         entry("VERSIONID=%s", versionId.c_str()));
+        sideWaiting.push_back(this);
+    }
+    return false;
+}
+
+void ActivationMMC::releaseSide()
+{
+    sideWaiting.erase(std::remove(sideWaiting.begin(), sideWaiting.end(), this),
+                      sideWaiting.end());
+    if (sideWriter != this)
+    {
+        return;
+    }
+
+    sideWriter = nullptr;
+    handOffSide();
+}
+
+void ActivationMMC::handOffSide()
+{
+    if (sideWriter || sideBusy || sideWaiting.empty())
+    {
+        return;
+    }
+    sideWriter = sideWaiting.front();
+    sideWaiting.pop_front();
+    sideWriter->startActivation();
+}
+
+void ActivationMMC::sideReturned()
+{
+    sideBusy = false;
+    handOffSide();
+}
+
 auto ActivationMMC::activation(Activations value) -> Activations
 {
-    return softwareServer::Activation::activation(value);
+    if (value != softwareServer::Activation::Activations::Active)
+    {
+        redundancyPriority.reset(nullptr);
+    }
+
+    if (value == softwareServer::Activation::Activations::Activating)
+    {
+        // System images, which hold no LIDs, are written by the BMC updater
+        auto imagePath = fs::path(paths::imgDir()) / versionId;
+        if (listLids(imagePath).empty() || activationProgress)
+        {
+            return softwareServer::Activation::activation(value);
+        }
+
+        label = alternateLabel(hostfwPath());
+        if (label.empty())
+        {
+            log<level::ERR>("Unable to find the running hostfw side",
+                            entry("DIR=%s", hostfwPath().c_str()));
+            return softwareServer::Activation::activation(
+                softwareServer::Activation::Activations::Failed);
+        }
+#ifdef WANT_SIGNATURE_VERIFY
+        // The signed digest list covers each LID
+        if (!validateSignature(verityListFile))
+        {
+            return softwareServer::Activation::activation(
+                softwareServer::Activation::Activations::Failed);
+        }
+#endif
+        softwareServer::Activation::activation(value);
+
+        // One activation at a time writes the alternate side, the others
+        // start once it is done
+        if (takeSide())
+        {
+            startActivation();
+        }
+        return softwareServer::Activation::activation();
+    }
+
+    work.request_stop();
+    activationBlocksTransition.reset(nullptr);
+    activationProgress.reset(nullptr);
+    auto result = softwareServer::Activation::activation(value);
+    releaseSide();
+    return result;
 }
 
 void ActivationMMC::startActivation()
-{}
+{
+    if (!activationProgress)
+    {
+        activationProgress = std::make_unique<ActivationProgress>(bus, path);
+    }
+
+    if (!activationBlocksTransition)
+    {
+        activationBlocksTransition =
+            std::make_unique<ActivationBlocksTransition>(bus, path);
+    }
+
+    log<level::INFO>("Comparing the LIDs with the alternate side",
+                     entry("VERSIONID=%s", versionId.c_str()),
+                     entry("BOOTSIDE=%s", label.c_str()));
+
+    auto imageDir = fs::path(paths::imgDir()) / versionId;
+    auto plan = std::make_shared<LidPlan>();
+    sideBusy = true;
+    work = executor.post(
+        [plan, imageDir](std::stop_token token) {
+            *plan = planLids(imageDir, alternatePath(), std::move(token));
+        },
+        [this, plan]() {
+            sideBusy = false;
+            log<level::INFO>("Compared the LIDs with the alternate side",
+                             entry("CHANGED=%zu", plan->changed.size()),
+                             entry("UNCHANGED=%zu", plan->unchanged),
+                             entry("STALE=%zu", plan->stale.size()));
+            writeLids(std::move(plan->changed), std::move(plan->stale),
+                      plan->bytes);
+        },
+        &ActivationMMC::sideReturned);
+}
+
+void ActivationMMC::writeLids(std::vector<std::string> changed,
+                              std::vector<std::string> stale, uint64_t bytes)
+{
+    // The bytes written then read back, shared with the progress poll
+    auto done = std::make_shared<std::atomic<uint64_t>>(0);
+    activationProgress->start(
+        {{"lid-write", bytes, true}, {"lid-verify", bytes}},
+        [done, bytes](ProgressModel& model) {
+            auto now = ProgressModel::Clock::now();
+            uint64_t total = *done;
+            if (total < bytes)
+            {
+                model.advance(0, total, now);
+            }
+            else
+            {
+                model.advance(1, total - bytes, now);
+            }
+        });
+
+    auto written = std::make_shared<bool>(false);
+    sideBusy = true;
+    work = executor.post(
+        [written, done, changed = std::move(changed), stale = std::move(stale),
+         imageDir = fs::path(paths::imgDir()) / versionId,
+         label = label](std::stop_token token) {
+            *written = writeAlternate(imageDir, changed, stale, label, *done,
+                                      std::move(token));
+        },
+        [this, written]() {
+            sideBusy = false;
+            if (*written)
+            {
+                finishActivation();
+            }
+            else
+            {
+                activation(softwareServer::Activation::Activations::Failed);
+            }
+        },
+        &ActivationMMC::sideReturned);
+}
 
 void ActivationMMC::unitStateChange(sdbusplus::message::message&)
 {}
 
 void ActivationMMC::finishActivation()
-{}
+{
+    activationProgress->finish();
+
+    // Set Redundancy Priority before setting to Active
+    if (!redundancyPriority)
+    {
+        redundancyPriority =
+            std::make_unique<RedundancyPriority>(bus, path, *this, 0);
+    }
+
+    activationProgress->progress(100);
+
+    activationBlocksTransition.reset(nullptr);
+    activationProgress.reset(nullptr);
+
+    log<level::INFO>("Host firmware written to the alternate side",
+                     entry("VERSIONID=%s", versionId.c_str()),
+                     entry("BOOTSIDE=%s", label.c_str()));
+
+    // Prepare the running tree of the new side for the switch
+    executor.post(
+        [](std::stop_token token) { refreshShadow(std::move(token)); });
+
+    // Remove version object from image manager
+    deleteImageManagerObject();
+    // Create active association
+    parent.createActiveAssociation(path);
+    // Create updateable association as this
+    // can be re-programmed.
+    parent.createUpdateableAssociation(path);
+
+    softwareServer::Activation::activation(
+        softwareServer::Activation::Activations::Active);
+    releaseSide();
+
+    if (checkApplyTimeImmediate())
+    {
+        log<level::INFO>("Image Active. ApplyTime is immediate, "
+                         "rebooting Host.");
+        rebootHost();
+    }
+}
 
 } // namespace updater
 } // namespace software
@@ -1,6 +1,10 @@
 #pragma once
 
 #include "activation.hpp"
+#include "executor.hpp"
+
+#include <stop_token>
+#include <string>
 
 namespace openpower
 {
@@ -13,18 +17,82 @@ namespace fs = std::filesystem;
 
 /** @class ActivationMMC
  *  @brief Implementation for eMMC PNOR layout
+ *  @details A host image is activated by writing its LIDs to the alternate
+ *  hostfw side and switching the boot side to it, one activation at a time.
+ *  The System images, which have no LIDs, are written by the BMC updater.
  */
 class ActivationMMC : public Activation
 {
   public:
-    using Activation::Activation;
-    ~ActivationMMC() = default;
+    /** @brief Constructs ActivationMMC
+     *
+     * @param[in] bus    - The Dbus bus object
+     * @param[in] path   - The Dbus object path
+     * @param[in] parent - Parent object.
+     * @param[in] versionId  - The software version id
+     * @param[in] extVersion - The extended version
+     * @param[in] activationStatus - The status of Activation
+     * @param[in] assocs - Association objects
+     * @param[in] executor - Runs the LID writes off the event loop
+     */
+    ActivationMMC(sdbusplus::bus::bus& bus, const std::string& path,
+                  ItemUpdater& parent, const std::string& versionId,
+                  const std::string& extVersion,
+                  sdbusplus::xyz::openbmc_project::Software::server::
+                      Activation::Activations activationStatus,
+                  AssociationList& assocs, Executor& executor) :
+        Activation(bus, path, parent, versionId, extVersion, activationStatus,
+                   assocs),
+        executor(executor)
+    {}
+
+    /** @brief Stops the LID writes still running */
+    ~ActivationMMC();
+
     Activations activation(Activations value) override;
 
   private:
     void unitStateChange(sdbusplus::message::message& msg) override;
     void startActivation() override;
     void finishActivation() override;
+
+    /** @brief Take the alternate side, or wait for the activation writing
+     *  it, which starts this one when it is done
+     *
+     * @return true if the side was taken
+     */
+    bool takeSide();
+
+    /** @brief Give the alternate side up, or stop waiting for it, starting
+     *  the next activation waiting once no worker uses the side */
+    void releaseSide();
+
+    /** @brief Start the next activation waiting for the alternate side, if
+     *  the side is free */
+    static void handOffSide();
+
+    /** @brief Run on the event loop once a cancelled worker no longer uses
+     *  the alternate side, which may outlive its activation */
+    static void sideReturned();
+
+    /** @brief Write the LIDs that differ from the alternate side, once
+     *  the comparison is done
+     *
+     * @param[in] changed - The LIDs to write
+     * @param[in] stale   - The LIDs to remove
+     * @param[in] bytes   - The bytes of the LIDs to write
+     */
+    void writeLids(std::vector<std::string> changed,
+                   std::vector<std::string> stale, uint64_t bytes);
+
+    /** @brief Runs the LID writes off the event loop */
+    Executor& executor;
+
+    /** @brief Cancels the running LID comparison or write */
+    std::stop_source work;
+
+    /** @brief The hostfw side written, a or b */
+    std::string label;
 };
 
 } // namespace updater
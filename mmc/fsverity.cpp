@@ -0,0 +1,315 @@
+#include "config.h"
+
+#include "fsverity.hpp"
+
+#include "buffer_pool.hpp"
+
+#include <endian.h>
+#include <fcntl.h>
+#include <linux/fsverity.h>
+#include <openssl/evp.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include <phosphor-logging/log.hpp>
+
+#include <array>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#ifdef WANT_SIGNATURE_VERIFY
+#include "image_verify.hpp"
+#endif
+
+namespace openpower
+{
+namespace software
+{
+namespace updater
+{
+
+namespace fs = std::filesystem;
+using namespace phosphor::logging;
+
+namespace
+{
+
+/** @brief The block size of the Merkle tree, as enabled by enableVerity */
+constexpr size_t verityBlockSize = 4096;
+constexpr uint8_t verityLogBlockSize = 12;
+
+using Sha256 = std::array<uint8_t, 32>;
+
+std::string toHex(const uint8_t* digest, size_t size)
+{
+    std::string hex = "sha256:";
+    for (size_t i = 0; i < size; i++)
+    {
+        char buf[3];
+        snprintf(buf, sizeof(buf), "%02x", digest[i]);
+        hex += buf;
+    }
+    return hex;
+}
+
+Sha256 sha256(const void* data, size_t size)
+{
+    Sha256 digest{};
+    EVP_Digest(data, size, digest.data(), nullptr, EVP_sha256(), nullptr);
+    return digest;
+}
+
+/** @brief Hash a level of the Merkle tree, a block at a time, the last block
+ *  zero-padded
+ *
+ *  @param[in]     data  - The blocks of the level
+ *  @param[in]     size  - The size of the level in bytes
+ *  @param[in,out] level - The hashes of the blocks, appended
+ */
+void hashBlocks(const uint8_t* data, size_t size, std::vector<uint8_t>& level)
+{
+    for (size_t offset = 0; offset < size; offset += verityBlockSize)
+    {
+        std::array<uint8_t, verityBlockSize> block{};
+        std::memcpy(block.data(), data + offset,
+                    std::min(verityBlockSize, size - offset));
+        auto digest = sha256(block.data(), block.size());
+        level.insert(level.end(), digest.begin(), digest.end());
+    }
+}
+
+} // namespace
+
+int enableVerity(const fs::path& file)
+{
+    int fd = open(file.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return errno;
+    }
+
+    struct fsverity_enable_arg arg = {};
+    arg.version = 1;
+    arg.hash_algorithm = FS_VERITY_HASH_ALG_SHA256;
+    arg.block_size = 4096;
+
+    // The kernel builds the Merkle tree here, which reads the whole file
+    // once. From then on the file is verified as it is read.
+    int rc = 0;
+    if ((ioctl(fd, FS_IOC_ENABLE_VERITY, &arg) != 0) && (errno != EEXIST))
+    {
+        rc = errno;
+    }
+    close(fd);
+    return rc;
+}
+
+std::string measureVerity(const fs::path& file)
+{
+    int fd = open(file.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return {};
+    }
+
+    constexpr size_t maxDigestSize = 64;
+    alignas(struct fsverity_digest)
+        std::array<uint8_t, sizeof(struct fsverity_digest) + maxDigestSize>
+            buffer{};
+    auto measurement = reinterpret_cast<struct fsverity_digest*>(buffer.data());
+    measurement->digest_size = maxDigestSize;
+
+    auto rc = ioctl(fd, FS_IOC_MEASURE_VERITY, measurement);
+    close(fd);
+    if ((rc != 0) ||
+        (measurement->digest_algorithm != FS_VERITY_HASH_ALG_SHA256))
+    {
+        return {};
+    }
+
+    return toHex(measurement->digest, measurement->digest_size);
+}
+
+std::string computeVerity(const fs::path& file)
+{
+    auto buffer = BufferPool::get().acquire();
+    std::ifstream input(file, std::ios::binary);
+    if (!buffer || !input)
+    {
+        return {};
+    }
+
+    // The first level hashes the data blocks. The buffer size is a multiple
+    // of the block size, so only the last read ends in a partial block.
+    std::vector<uint8_t> level;
+    uint64_t dataSize = 0;
+    while (input.read(buffer.data(), buffer.size()) || input.gcount() > 0)
+    {
+        hashBlocks(reinterpret_cast<const uint8_t*>(buffer.data()),
+                   input.gcount(), level);
+        dataSize += input.gcount();
+    }
+    if (input.bad())
+    {
+        return {};
+    }
+
+    // Each level hashes the blocks of the level below until a single block
+    // is left, whose hash is the root hash. An empty file has a zero root.
+    Sha256 rootHash{};
+    if (dataSize > 0)
+    {
+        while (level.size() > rootHash.size())
+        {
+            std::vector<uint8_t> next;
+            hashBlocks(level.data(), level.size(), next);
+            level = std::move(next);
+        }
+        std::copy(level.begin(), level.end(), rootHash.begin());
+    }
+
+    // The file digest is the hash of the fs-verity descriptor
+    struct Descriptor
+    {
+        uint8_t version;
+        uint8_t hashAlgorithm;
+        uint8_t logBlockSize;
+        uint8_t saltSize;
+        uint32_t sigSize;
+        uint64_t dataSize;
+        uint8_t rootHash[64];
+        uint8_t salt[32];
+        uint8_t reserved[144];
+    } descriptor{};
+    static_assert(sizeof(descriptor) == 256);
+    descriptor.version = 1;
+    descriptor.hashAlgorithm = FS_VERITY_HASH_ALG_SHA256;
+    descriptor.logBlockSize = verityLogBlockSize;
+    descriptor.dataSize = htole64(dataSize);
+    std::memcpy(descriptor.rootHash, rootHash.data(), rootHash.size());
+
+    auto digest = sha256(&descriptor, sizeof(descriptor));
+    return toHex(digest.data(), digest.size());
+}
+
+std::map<std::string, std::string> parseVerityList(const std::string& content)
+{
+    std::map<std::string, std::string> lids;
+    std::istringstream iss(content);
+    std::string line;
+
+    while (std::getline(iss, line))
+    {
+        // Each line looks like
+        // sha256:3c1b...e0a4 81e00994.lid
+        std::istringstream fields(line);
+        std::string digest, name;
+        if (!(fields >> digest >> name) || (digest.rfind("sha256:", 0) != 0))
+        {
+            continue;
+        }
+        // Only the file name is used, the list may have been generated from
+        // another directory.
+        lids.emplace(fs::path(name).filename(), digest);
+    }
+    return lids;
+}
+
+bool verifyLids(const fs::path& lidDir, const fs::path& listDir,
+                const std::vector<std::string>& lids, bool enable)
+{
+    if (lids.empty())
+    {
+        return true;
+    }
+
+    auto listPath = listDir / verityListFile;
+    std::ifstream listFile(listPath);
+    if (!listFile)
+    {
+        log<level::ERR>("No fs-verity digest list for the LIDs",
+                        entry("DIR=%s", listDir.c_str()));
+        return false;
+    }
+
+#ifdef WANT_SIGNATURE_VERIFY
+    using Signature = openpower::software::image::Signature;
+    Signature signature(listDir, verityListFile, PNOR_SIGNED_IMAGE_CONF_PATH);
+    if (!signature.systemVerify())
+    {
+        log<level::ERR>("The fs-verity digest list signature is not valid",
+                        entry("FILE=%s", listPath.c_str()));
+        return false;
+    }
+#endif
+
+    std::stringstream content;
+    content << listFile.rdbuf();
+    auto list = parseVerityList(content.str());
+
+    bool valid = true;
+    for (const auto& name : lids)
+    {
+        auto lid = lidDir / name;
+        auto expected = list.find(name);
+        if (expected == list.end())
+        {
+            log<level::ERR>("LID is not in the signed fs-verity digest list",
+                            entry("FILE=%s", lid.c_str()));
+            valid = false;
+            continue;
+        }
+
+        std::error_code ec;
+        if (!fs::is_regular_file(lid, ec))
+        {
+            log<level::ERR>("LID of the signed fs-verity digest list is "
+                            "missing",
+                            entry("FILE=%s", lid.c_str()));
+            valid = false;
+            continue;
+        }
+
+        auto measurement = measureVerity(lid);
+        if (measurement.empty() && enable)
+        {
+            auto rc = enableVerity(lid);
+            if (rc == EOPNOTSUPP || rc == ENOTTY)
+            {
+                log<level::INFO>("fs-verity is not supported on the LIDs",
+                                 entry("DIR=%s", lidDir.c_str()));
+                enable = false;
+            }
+            else if (rc != 0)
+            {
+                log<level::ERR>("Failed to enable fs-verity",
+                                entry("FILE=%s", lid.c_str()),
+                                entry("ERRNO=%d", rc));
+            }
+            measurement = measureVerity(lid);
+        }
+
+        if (measurement.empty())
+        {
+            // Without fs-verity on the file the digest is computed from its
+            // content, which reads it whole
+            measurement = computeVerity(lid);
+        }
+
+        if (measurement != expected->second)
+        {
+            log<level::ERR>("LID does not match its signed fs-verity digest",
+                            entry("FILE=%s", lid.c_str()),
+                            entry("MEASUREMENT=%s", measurement.c_str()));
+            valid = false;
+        }
+    }
+    return valid;
+}
+
+} // namespace updater
+} // namespace software
+} // namespace openpower
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <filesystem>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace openpower
+{
+namespace software
+{
+namespace updater
+{
+
+/** @brief Name of the per-LID fs-verity digest list shipped in the host
+ *  firmware image, signed in a file with the SIGNATURE_FILE_EXT extension.
+ *  Each line is the output of the fsverity digest command:
+ *  sha256:<hex digest> <LID file name>
+ */
+constexpr auto verityListFile = "lids.fsverity";
+
+/** @brief Enable fs-verity on a file
+ *
+ *  @param[in] file - The file, which must not be open for writing
+ *
+ *  @return 0 on success or if fs-verity was already enabled, the errno
+ *          otherwise
+ */
+int enableVerity(const std::filesystem::path& file);
+
+/** @brief Get the fs-verity measurement of a file
+ *
+ *  @param[in] file - The file
+ *
+ *  @return The measurement as sha256:<hex digest>, or an empty string if
+ *          fs-verity is not enabled on the file
+ */
+std::string measureVerity(const std::filesystem::path& file);
+
+/** @brief Compute the fs-verity digest of a file from its content, as the
+ *  fsverity digest command does, for a file without fs-verity enabled
+ *
+ *  @param[in] file - The file, which is read whole
+ *
+ *  @return The digest as sha256:<hex digest>, or an empty string if the file
+ *          cannot be read
+ */
+std::string computeVerity(const std::filesystem::path& file);
+
+/** @brief Parse a per-LID fs-verity digest list
+ *
+ *  @param[in] content - The content of the list
+ *
+ *  @return Map of the LID file names to their expected measurement
+ */
+std::map<std::string, std::string> parseVerityList(const std::string& content);
+
+/** @brief Check LIDs against the signed digest list of the host firmware
+ *  image. A LID is measured by fs-verity, or its digest is computed from its
+ *  content where fs-verity is not available.
+ *
+ *  @param[in] lidDir  - The directory holding the LIDs
+ *  @param[in] listDir - The directory holding the signed digest list
+ *  @param[in] lids    - The LIDs to check, which must all be in the list
+ *  @param[in] enable  - Enable fs-verity on the LIDs that do not have it,
+ *                       which makes them immutable
+ *
+ *  @return true if every LID is in the list, present, and matches its
+ *          digest
+ */
+bool verifyLids(const std::filesystem::path& lidDir,
+                const std::filesystem::path& listDir,
+                const std::vector<std::string>& lids, bool enable);
+
+} // namespace updater
+} // namespace software
+} // namespace openpower
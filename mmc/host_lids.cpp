@@ -0,0 +1,265 @@
+#include "host_lids.hpp"
+
+#include "buffer_pool.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <phosphor-logging/log.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <vector>
+
+namespace openpower
+{
+namespace software
+{
+namespace updater
+{
+
+namespace fs = std::filesystem;
+using namespace phosphor::logging;
+
+namespace
+{
+
+/** @brief Read up to a full buffer, short only at the end of the file
+ *  @return The bytes read, or -1 on error
+ */
+ssize_t readFull(int fd, char* buffer, size_t size)
+{
+    size_t total = 0;
+    while (total < size)
+    {
+        auto rc = read(fd, buffer + total, size - total);
+        if (rc < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return -1;
+        }
+        if (rc == 0)
+        {
+            break;
+        }
+        total += rc;
+    }
+    return total;
+}
+
+/** @brief Write a full buffer
+ *  @return true on success
+ */
+bool writeFull(int fd, const char* buffer, size_t size)
+{
+    size_t total = 0;
+    while (total < size)
+    {
+        auto rc = write(fd, buffer + total, size - total);
+        if (rc < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return false;
+        }
+        total += rc;
+    }
+    return true;
+}
+
+} // namespace
+
+std::vector<std::string> listLids(const fs::path& dir)
+{
+    std::vector<std::string> lids;
+    std::error_code ec;
+    for (const auto& file : fs::directory_iterator(dir, ec))
+    {
+        if (file.is_regular_file(ec) && (file.path().extension() == ".lid"))
+        {
+            lids.push_back(file.path().filename());
+        }
+    }
+    std::sort(lids.begin(), lids.end());
+    return lids;
+}
+
+bool sameContent(const fs::path& a, const fs::path& b)
+{
+    std::error_code ec;
+    auto sizeA = fs::file_size(a, ec);
+    if (ec)
+    {
+        return false;
+    }
+    auto sizeB = fs::file_size(b, ec);
+    if (ec || (sizeA != sizeB))
+    {
+        return false;
+    }
+
+    int fdA = open(a.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fdA < 0)
+    {
+        return false;
+    }
+    int fdB = open(b.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fdB < 0)
+    {
+        close(fdA);
+        return false;
+    }
+    posix_fadvise(fdA, 0, 0, POSIX_FADV_SEQUENTIAL);
+    posix_fadvise(fdB, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    // Both files are read into halves of a single buffer
+    auto buffer = BufferPool::get().acquire();
+    auto chunkSize = buffer.size() / 2;
+    auto bufferA = buffer.data();
+    auto bufferB = buffer.data() + chunkSize;
+    bool same = static_cast<bool>(buffer);
+    while (same)
+    {
+        auto rcA = readFull(fdA, bufferA, chunkSize);
+        auto rcB = readFull(fdB, bufferB, chunkSize);
+        if ((rcA < 0) || (rcA != rcB) ||
+            !std::equal(bufferA, bufferA + rcA, bufferB))
+        {
+            same = false;
+        }
+        else if (rcA == 0)
+        {
+            break;
+        }
+    }
+    close(fdA);
+    close(fdB);
+    return same;
+}
+
+LidPlan planLids(const fs::path& imageDir, const fs::path& targetDir,
+                 std::stop_token token)
+{
+    LidPlan plan;
+    auto lids = listLids(imageDir);
+    for (const auto& lid : lids)
+    {
+        if (token.stop_requested())
+        {
+            break;
+        }
+        // Reading the side is much cheaper than writing it, and most LIDs
+        // are the same from one host firmware build to the next
+        if (sameContent(imageDir / lid, targetDir / lid))
+        {
+            plan.unchanged++;
+            continue;
+        }
+        std::error_code ec;
+        plan.changed.push_back(lid);
+        plan.bytes += fs::file_size(imageDir / lid, ec);
+    }
+    for (const auto& lid : listLids(targetDir))
+    {
+        if (!std::binary_search(lids.begin(), lids.end(), lid))
+        {
+            plan.stale.push_back(lid);
+        }
+    }
+    return plan;
+}
+
+bool writeLid(const fs::path& source, const fs::path& targetDir,
+              std::atomic<uint64_t>& done, std::stop_token token)
+{
+    auto target = targetDir / source.filename();
+    auto tmpPath = fs::path(target).concat(".tmp");
+
+    int in = open(source.c_str(), O_RDONLY | O_CLOEXEC);
+    if (in < 0)
+    {
+        log<level::ERR>("Unable to open the LID",
+                        entry("FILE=%s", source.c_str()),
+                        entry("ERRNO=%d", errno));
+        return false;
+    }
+    int out =
+        open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (out < 0)
+    {
+        log<level::ERR>("Unable to create the LID",
+                        entry("FILE=%s", tmpPath.c_str()),
+                        entry("ERRNO=%d", errno));
+        close(in);
+        return false;
+    }
+    posix_fadvise(in, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    auto buffer = BufferPool::get().acquire();
+    bool written = static_cast<bool>(buffer);
+    while (written && !token.stop_requested())
+    {
+        auto rc = readFull(in, buffer.data(), buffer.size());
+        if ((rc < 0) || !writeFull(out, buffer.data(), rc))
+        {
+            written = false;
+            break;
+        }
+        if (rc == 0)
+        {
+            break;
+        }
+        done += rc;
+    }
+    written = written && !token.stop_requested() && (fsync(out) == 0);
+    if (!written)
+    {
+        log<level::ERR>("Unable to write the LID",
+                        entry("FILE=%s", target.c_str()),
+                        entry("ERRNO=%d", errno));
+    }
+    close(in);
+    close(out);
+
+    std::error_code ec;
+    if (written)
+    {
+        fs::rename(tmpPath, target, ec);
+        written = !ec;
+    }
+    if (!written)
+    {
+        fs::remove(tmpPath, ec);
+    }
+    return written;
+}
+
+bool readBackLid(const fs::path& source, const fs::path& target)
+{
+    // The pages of the LID are clean once it is synced, dropping them makes
+    // the comparison read what the media holds
+    int fd = open(target.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return false;
+    }
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+
+    if (!sameContent(source, target))
+    {
+        log<level::ERR>("LID read back does not match the image",
+                        entry("FILE=%s", target.c_str()));
+        return false;
+    }
+    return true;
+}
+
+} // namespace updater
+} // namespace software
+} // namespace openpower
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <stop_token>
+#include <string>
+#include <vector>
+
+namespace openpower
+{
+namespace software
+{
+namespace updater
+{
+
+/** @brief The LID of the host firmware TOC, which lists the partitions */
+constexpr auto tocLid = "81e00994.lid";
+
+/** @struct LidPlan
+ *  @brief The LIDs a host-only update writes to the alternate side.
+ */
+struct LidPlan
+{
+    /** @brief The LIDs of the image that differ from the alternate side */
+    std::vector<std::string> changed;
+
+    /** @brief The LIDs of the alternate side no longer in the image */
+    std::vector<std::string> stale;
+
+    /** @brief The LIDs of the image already on the alternate side */
+    size_t unchanged = 0;
+
+    /** @brief The bytes of the changed LIDs */
+    uint64_t bytes = 0;
+};
+
+/** @brief List the LID files of a directory
+ *
+ *  @param[in] dir - The directory
+ *
+ *  @return The LID file names, sorted
+ */
+std::vector<std::string> listLids(const std::filesystem::path& dir);
+
+/** @brief Check whether two files have the same content, reading them
+ *  side by side and stopping at the first difference.
+ *
+ *  @param[in] a - A file
+ *  @param[in] b - The other file
+ *
+ *  @return true if both files exist and have the same content
+ */
+bool sameContent(const std::filesystem::path& a,
+                 const std::filesystem::path& b);
+
+/** @brief Compare the LIDs of an image with the LIDs of a side
+ *
+ *  @param[in] imageDir  - The directory of the uploaded image
+ *  @param[in] targetDir - The directory of the side
+ *  @param[in] token     - Stops the comparison early
+ *
+ *  @return The LIDs to write and remove
+ */
+LidPlan planLids(const std::filesystem::path& imageDir,
+                 const std::filesystem::path& targetDir,
+                 std::stop_token token);
+
+/** @brief Write a LID to a side, through a temporary file renamed over the
+ *  previous LID once it is synced.
+ *
+ *  @param[in]     source    - The LID of the image
+ *  @param[in]     targetDir - The directory of the side
+ *  @param[in,out] done      - Incremented by the bytes written
+ *  @param[in]     token     - Stops the write early
+ *
+ *  @return true if the LID was written
+ */
+bool writeLid(const std::filesystem::path& source,
+              const std::filesystem::path& targetDir,
+              std::atomic<uint64_t>& done, std::stop_token token);
+
+/** @brief Read a written LID back from the media, past the page cache, and
+ *  compare it with the LID of the image.
+ *
+ *  @param[in] source - The LID of the image
+ *  @param[in] target - The written LID
+ *
+ *  @return true if the written LID matches
+ */
+bool readBackLid(const std::filesystem::path& source,
+                 const std::filesystem::path& target);
+
+} // namespace updater
+} // namespace software
+} // namespace openpower
@@ -3,12 +3,27 @@
 #include "item_updater_mmc.hpp"
 
 #include "activation_mmc.hpp"
+#include "history.hpp"
+#include "host_lids.hpp"
+#include "paths.hpp"
+#include "shadow.hpp"
+#include "task_graph.hpp"
 #include "utils.hpp"
 #include "version.hpp"
 
+#include <sys/stat.h>
+#include <systemd/sd-bus.h>
+
+#include <phosphor-logging/log.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
 #include <filesystem>
 #include <iostream>
+#include <memory>
 #include <thread>
+#include <vector>
 
 namespace openpower
 {
@@ -17,10 +32,12 @@ namespace software
 namespace updater
 {
 
-// These functions are just a stub (empty) because the current eMMC
-// implementation uses the BMC updater (repo phosphor-bmc-code-mgmt) to write
-// the new host FW to flash since it's delivered as a "System" image in the
-// same BMC tarball as the BMC image.
+using namespace phosphor::logging;
+
+// The host FW delivered as a "System" image in the same tarball as the BMC
+// image is written by the BMC updater (repo phosphor-bmc-code-mgmt), so most
+// of these functions are just a stub (empty). A host-only image is written
+// by ActivationMMC to the alternate side.
 
 std::unique_ptr<Activation> ItemUpdaterMMC::createActivationObject(
     const std::string& path, const std::string& versionId,
@@ -29,8 +46,9 @@ std::unique_ptr<Activation> ItemUpdaterMMC::createActivationObject(
         activationStatus,
     AssociationList& assocs)
 {
-    return std::make_unique<ActivationMMC>(
-        bus, path, *this, versionId, extVersion, activationStatus, assocs);
+    return std::make_unique<ActivationMMC>(bus, path, *this, versionId,
+                                           extVersion, activationStatus,
+                                           assocs, executor);
 }
 
 std::unique_ptr<Version> ItemUpdaterMMC::createVersionObject(
@@ -47,8 +65,19 @@ std::unique_ptr<Version> ItemUpdaterMMC::createVersionObject(
     return version;
 }
 
-bool ItemUpdaterMMC::validateImage(const std::string&)
+bool ItemUpdaterMMC::validateImage(const std::string& path)
 {
+    // A host-only image holds the LIDs, including the TOC that the running
+    // side is populated with
+    auto lids = listLids(path);
+    if (!lids.empty() &&
+        !std::binary_search(lids.begin(), lids.end(), tocLid))
+    {
+        log<level::ERR>("Host image has no TOC LID",
+                        entry("PATH=%s", path.c_str()),
+                        entry("LID=%s", tocLid));
+        return false;
+    }
     return true;
 }
 
@@ -57,72 +86,141 @@ void ItemUpdaterMMC::processPNORImage()
 
 void ItemUpdaterMMC::reset()
 {
-    // Do not reset read-only files needed for reset or ext4 default files
-    const std::vector<std::string> exclusionList = {"alternate", "hostfw-a",
-                                                    "hostfw-b",  "lost+found",
-                                                    "nvram",     "running-ro"};
-    std::filesystem::path dirPath(std::string(MEDIA_DIR "hostfw/"));
-    // Delete all files in /media/hostfw/ except for those on exclusionList
-    for (const auto& p : std::filesystem::directory_iterator(dirPath))
+    if (resetting)
     {
-        if (std::find(exclusionList.begin(), exclusionList.end(),
-                      p.path().stem().string()) == exclusionList.end())
+        log<level::INFO>("Factory reset already in progress");
+        return;
+    }
+    resetting = true;
+    utils::rebootGuard(bus, true);
+
+    // The steps run on the worker threads, those making D-Bus calls use
+    // their own connection.
+    auto graph = std::make_shared<TaskGraph>();
+
+    auto hostfw = graph->add("hostfw", []() {
+        // Do not reset read-only files needed for reset or ext4 default files
+        const std::vector<std::string> exclusionList = {
+            "alternate",  "hostfw-a", "hostfw-b",
+            "lost+found", "nvram",    "running-ro"};
+        std::filesystem::path dirPath(paths::mediaDir() + "hostfw/");
+        // Delete all files in /media/hostfw/ except for those on exclusionList
+        for (const auto& p : std::filesystem::directory_iterator(dirPath))
         {
-            std::filesystem::remove_all(p);
+            if (std::find(exclusionList.begin(), exclusionList.end(),
+                          p.path().stem().string()) == exclusionList.end())
+            {
+                std::filesystem::remove_all(p);
+            }
         }
-    }
+    });
 
     // Delete all BMC error logs to avoid discrepancies with the host error logs
-    utils::deleteAllErrorLogs(bus);
+    auto errorLogs = graph->add("error-logs", []() {
+        auto bus = sdbusplus::bus::new_default();
+        utils::deleteAllErrorLogs(bus);
+    });
 
-    // Set attribute to clear hypervisor NVRAM
-    utils::setClearNvram(bus);
+    // Clear the hypervisor NVRAM and the indication that the system is
+    // HMC-managed, in one update as each update replaces the pending
+    // attributes.
+    auto biosAttributes = graph->add("bios-attributes", []() {
+        auto bus = sdbusplus::bus::new_default();
+        utils::setPendingAttributes(bus, {{"pvm_clear_nvram", "Enabled"},
+                                          {"pvm_hmc_managed", "Disabled"}});
+    });
 
     // reset the enabled property of dimms/cpu after factory reset
-    gardReset.reset();
+    auto dimmCpu = graph->add("dimm-cpu", &GardResetMMC::enableDimmAndCpu);
 
     // Remove files related to the Hardware Management Console / BMC web app
-    utils::clearHMCManaged(bus);
-    std::filesystem::path consolePath("/var/lib/bmcweb/ibm-management-console");
-    if (std::filesystem::exists(consolePath))
-    {
-        std::filesystem::remove_all(consolePath);
-    }
-    std::filesystem::path bmcdataPath("/home/root/bmcweb_persistent_data.json");
-    if (std::filesystem::exists(bmcdataPath))
-    {
-        std::filesystem::remove(bmcdataPath);
-    }
+    auto bmcweb = graph->add(
+        "bmcweb",
+        []() {
+            std::filesystem::path consolePath(
+                "/var/lib/bmcweb/ibm-management-console");
+            if (std::filesystem::exists(consolePath))
+            {
+                std::filesystem::remove_all(consolePath);
+            }
+            std::filesystem::path bmcdataPath(
+                "/home/root/bmcweb_persistent_data.json");
+            if (std::filesystem::exists(bmcdataPath))
+            {
+                std::filesystem::remove(bmcdataPath);
+            }
+        },
+        {biosAttributes});
 
     // Recreate default files.
-    // std::tuple<method, service_name>
-    const std::tuple<std::string, std::string> services[] = {
-        {"StartUnit", "obmc-flash-bios-init.service"},
-        {"StartUnit", "obmc-flash-bios-patch.service"},
-        {"StartUnit", "openpower-process-host-firmware.service"},
-        {"StartUnit", "openpower-update-bios-attr-table.service"},
-        {"RestartUnit", "org.open_power.HardwareIsolation.service"}};
-
-    for (const auto& service : services)
-    {
-        auto method = bus.new_method_call(SYSTEMD_BUSNAME, SYSTEMD_PATH,
-                                          SYSTEMD_INTERFACE,
-                                          std::get<0>(service).c_str());
-        method.append(std::get<1>(service), "replace");
-        // Ignore errors if the service is not found - not all systems
-        // may have these services
-        try
+    graph->add(
+        "units",
+        []() {
+            // std::tuple<method, service_name>
+            const std::tuple<std::string, std::string> services[] = {
+                {"StartUnit", "obmc-flash-bios-init.service"},
+                {"StartUnit", "obmc-flash-bios-patch.service"},
+                {"StartUnit", "openpower-process-host-firmware.service"},
+                {"StartUnit", "openpower-update-bios-attr-table.service"},
+                {"RestartUnit", "org.open_power.HardwareIsolation.service"}};
+
+            auto bus = sdbusplus::bus::new_default();
+            for (const auto& service : services)
+            {
+                auto method = bus.new_method_call(
+                    SYSTEMD_BUSNAME, SYSTEMD_PATH, SYSTEMD_INTERFACE,
+                    std::get<0>(service).c_str());
+                method.append(std::get<1>(service), "replace");
+                // Ignore errors if the service is not found - not all systems
+                // may have these services
+                try
+                {
+                    bus.call_noreply(method);
+                }
+                catch (const std::exception& e)
+                {}
+            }
+
+            // Wait a few seconds for the service files and reset operations
+            // to finish, otherwise the BMC may be rebooted and cause
+            // corruption.
+            constexpr auto resetWait = std::chrono::seconds(5);
+            std::this_thread::sleep_for(resetWait);
+        },
+        {hostfw, errorLogs, biosAttributes, dimmCpu, bmcweb});
+
+    auto start = std::chrono::steady_clock::now();
+    auto history = std::make_shared<HistoryEntry>("FactoryReset", "");
+    graph->run(executor, [this, start, history](const auto& timings) {
+        bool failed = false;
+        for (const auto& timing : timings)
         {
-            bus.call_noreply(method);
+            history->addStage(timing.name, 0, timing.duration);
+            failed = failed || timing.failed;
+            log<level::INFO>(
+                "Factory reset step complete",
+                entry("STEP=%s", timing.name.c_str()),
+                entry("DURATION_MS=%lld",
+                      static_cast<long long>(timing.duration.count())),
+                entry("FAILED=%d", timing.failed));
         }
-        catch (const std::exception& e)
-        {}
-    }
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - start);
+        log<level::INFO>("Factory reset complete",
+                         entry("ELAPSED_MS=%lld",
+                               static_cast<long long>(elapsed.count())));
+
+        utils::rebootGuard(bus, false);
+        resetting = false;
+        history->finish(!failed);
+    });
+}
 
-    // Wait a few seconds for the service files and reset operations to finish,
-    // otherwise the BMC may be rebooted and cause corruption.
-    constexpr auto resetWait = std::chrono::seconds(5);
-    std::this_thread::sleep_for(resetWait);
+void ItemUpdaterMMC::refreshShadow()
+{
+    executor.post([](std::stop_token token) {
+        updater::refreshShadow(std::move(token));
+    });
 }
 
 bool ItemUpdaterMMC::isVersionFunctional(const std::string& versionId)
@@ -144,37 +242,219 @@ bool ItemUpdaterMMC::freeSpace()
 void ItemUpdaterMMC::updateFunctionalAssociation(const std::string&)
 {}
 
-void GardResetMMC::enableDimmAndCpu()
+std::vector<ScrubTarget> ItemUpdaterMMC::scrubTargets()
 {
-    std::vector<std::string> intf;
-    intf.push_back("xyz.openbmc_project.Inventory.Item.Cpu");
-    intf.push_back("xyz.openbmc_project.Inventory.Item.Dimm");
+    // The host firmware images are written by the BMC updater, so there is no
+    // digest recorded at activation. The first read of an image is trusted
+    // as its baseline, which is discarded whenever the image file changes.
+    std::vector<ScrubTarget> targets;
+    for (const auto& label : {"a", "b"})
+    {
+        auto name = std::string("hostfw-") + label;
+        std::filesystem::path image(paths::mediaDir() + "hostfw/" + name);
 
+        std::error_code ec;
+        auto size = std::filesystem::file_size(image, ec);
+        if (ec)
+        {
+            continue;
+        }
+        struct stat st;
+        if (stat(image.c_str(), &st) != 0)
+        {
+            continue;
+        }
+
+        IntegrityRecord record;
+        if (!restoreIntegrity(name, record) || (record.stamp != st.st_mtime) ||
+            (record.regions.size() != 1) ||
+            (record.regions.front().length != size))
+        {
+            record.regions = {{name, 0, size, {}}};
+        }
+        targets.push_back({name, image, record.regions.front(), st.st_mtime});
+    }
+    return targets;
+}
+
+namespace
+{
+
+constexpr auto cpuInterface = "xyz.openbmc_project.Inventory.Item.Cpu";
+constexpr auto dimmInterface = "xyz.openbmc_project.Inventory.Item.Dimm";
+constexpr auto enableInterface = "xyz.openbmc_project.Object.Enable";
+
+/** @brief Read the Enabled property from an a{sv} property map */
+bool readEnabled(sd_bus_message* m)
+{
+    bool enabled = false;
+    sd_bus_message_enter_container(m, SD_BUS_TYPE_ARRAY, "{sv}");
+    while (sd_bus_message_enter_container(m, SD_BUS_TYPE_DICT_ENTRY, "sv") >
+           0)
+    {
+        const char* name = nullptr;
+        sd_bus_message_read_basic(m, SD_BUS_TYPE_STRING, &name);
+        if ((std::strcmp(name, "Enabled") == 0) &&
+            (sd_bus_message_enter_container(m, SD_BUS_TYPE_VARIANT, "b") > 0))
+        {
+            int value = 0;
+            sd_bus_message_read_basic(m, SD_BUS_TYPE_BOOLEAN, &value);
+            enabled = value;
+            sd_bus_message_exit_container(m);
+        }
+        else
+        {
+            sd_bus_message_skip(m, "v");
+        }
+        sd_bus_message_exit_container(m);
+    }
+    sd_bus_message_exit_container(m);
+    return enabled;
+}
+
+/** @brief Find the CPUs and DIMMs not enabled in a GetManagedObjects reply.
+ *  The reply is walked rather than read into a map, as the inventory holds
+ *  properties of many types.
+ */
+std::vector<std::string> findDisabledDimmAndCpu(sd_bus_message* m)
+{
     std::vector<std::string> objs;
+    sd_bus_message_enter_container(m, SD_BUS_TYPE_ARRAY, "{oa{sa{sv}}}");
+    while (sd_bus_message_enter_container(m, SD_BUS_TYPE_DICT_ENTRY,
+                                          "oa{sa{sv}}") > 0)
+    {
+        const char* path = nullptr;
+        sd_bus_message_read_basic(m, SD_BUS_TYPE_OBJECT_PATH, &path);
+        std::string obj(path ? path : "");
+
+        bool item = false;
+        bool enabled = false;
+        sd_bus_message_enter_container(m, SD_BUS_TYPE_ARRAY, "{sa{sv}}");
+        while (sd_bus_message_enter_container(m, SD_BUS_TYPE_DICT_ENTRY,
+                                              "sa{sv}") > 0)
+        {
+            const char* intf = nullptr;
+            sd_bus_message_read_basic(m, SD_BUS_TYPE_STRING, &intf);
+            if ((std::strcmp(intf, cpuInterface) == 0) ||
+                (std::strcmp(intf, dimmInterface) == 0))
+            {
+                item = true;
+            }
+            if (std::strcmp(intf, enableInterface) == 0)
+            {
+                enabled = readEnabled(m);
+            }
+            else
+            {
+                sd_bus_message_skip(m, "a{sv}");
+            }
+            sd_bus_message_exit_container(m);
+        }
+        sd_bus_message_exit_container(m);
+        sd_bus_message_exit_container(m);
+
+        if (item && !enabled)
+        {
+            objs.push_back(std::move(obj));
+        }
+    }
+    sd_bus_message_exit_container(m);
+    return objs;
+}
+
+/** @brief The Set calls in flight */
+struct PendingSets
+{
+    size_t inFlight = 0;
+    size_t failed = 0;
+};
+
+/** @brief Releases the slot of a Set call. Releasing the slot of a call
+ *  still in flight cancels it, so its reply no longer reaches PendingSets.
+ */
+struct SlotUnref
+{
+    void operator()(sd_bus_slot* slot) const
+    {
+        sd_bus_slot_unref(slot);
+    }
+};
+
+using SetSlot = std::unique_ptr<sd_bus_slot, SlotUnref>;
+
+int setReply(sd_bus_message* m, void* userdata, sd_bus_error*)
+{
+    auto pending = static_cast<PendingSets*>(userdata);
+    pending->inFlight--;
+    if (sd_bus_message_is_method_error(m, nullptr))
+    {
+        pending->failed++;
+    }
+    return 0;
+}
+
+} // namespace
+
+void GardResetMMC::enableDimmAndCpu()
+{
+    constexpr auto inventoryService = "xyz.openbmc_project.Inventory.Manager";
+    constexpr auto inventoryPath = "/xyz/openbmc_project/inventory";
+
     try
     {
         auto bus = sdbusplus::bus::new_default();
-        auto mapperCall = bus.new_method_call(
-            "xyz.openbmc_project.ObjectMapper",
-            "/xyz/openbmc_project/object_mapper",
-            "xyz.openbmc_project.ObjectMapper", "GetSubTreePaths");
 
-        mapperCall.append("/xyz/openbmc_project/inventory");
-        mapperCall.append(0);
-        mapperCall.append(intf);
+        // Read the current values in bulk to skip the enabled objects
+        auto managedObjects = bus.new_method_call(
+            inventoryService, inventoryPath,
+            "org.freedesktop.DBus.ObjectManager", "GetManagedObjects");
+        auto response = bus.call(managedObjects);
+        auto objs = findDisabledDimmAndCpu(response.get());
 
-        auto response = bus.call(mapperCall);
-        response.read(objs);
+        // Send all the updates at once, then collect their replies. The
+        // slots are declared after pending so that any call left in flight
+        // is cancelled before pending goes away.
+        PendingSets pending;
+        std::vector<SetSlot> slots;
         for (auto& obj : objs)
         {
-            auto method = bus.new_method_call(
-                "xyz.openbmc_project.Inventory.Manager", obj.c_str(),
-                "org.freedesktop.DBus.Properties", "Set");
+            auto method = bus.new_method_call(inventoryService, obj.c_str(),
+                                              "org.freedesktop.DBus.Properties",
+                                              "Set");
 
             std::variant<bool> propertyVal{true};
-            method.append("xyz.openbmc_project.Object.Enable", "Enabled",
-                          propertyVal);
-            bus.call_noreply(method);
+            method.append(enableInterface, "Enabled", propertyVal);
+            sd_bus_slot* slot = nullptr;
+            if (sd_bus_call_async(bus.get(), &slot, method.get(), setReply,
+                                  &pending, 0) < 0)
+            {
+                pending.failed++;
+                continue;
+            }
+            slots.emplace_back(slot);
+            pending.inFlight++;
+        }
+
+        while (pending.inFlight > 0)
+        {
+            auto rc = sd_bus_process(bus.get(), nullptr);
+            if (rc == 0)
+            {
+                rc = sd_bus_wait(bus.get(), UINT64_MAX);
+            }
+            if (rc < 0)
+            {
+                log<level::ERR>("Error waiting for the Enabled updates",
+                                entry("RC=%d", rc));
+                return;
+            }
+        }
+
+        if (pending.failed > 0)
+        {
+            log<level::ERR>("Unable to enable some CPUs and DIMMs",
+                            entry("FAILED=%zu", pending.failed),
+                            entry("TOTAL=%zu", objs.size()));
         }
     }
     catch (const sdbusplus::exception::SdBusError& e)
@@ -185,7 +465,15 @@ void GardResetMMC::enableDimmAndCpu()
 
 void GardResetMMC::reset()
 {
+    if (parent.resetInProgress())
+    {
+        log<level::ERR>("Factory reset in progress, GARD reset rejected");
+        return;
+    }
+
+    HistoryEntry history("GardReset", "");
     (void)enableDimmAndCpu();
+    history.finish(true);
 }
 
 } // namespace updater
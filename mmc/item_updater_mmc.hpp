@@ -2,6 +2,11 @@
 
 #include "item_updater.hpp"
 
+#include <sdeventplus/clock.hpp>
+#include <sdeventplus/utility/timer.hpp>
+
+#include <chrono>
+
 namespace openpower
 {
 namespace software
@@ -15,13 +20,6 @@ class GardResetMMC : public GardReset
     using GardReset::GardReset;
     virtual ~GardResetMMC() = default;
 
-  protected:
-    /**
-     * @brief GARD factory reset - clears the PNOR GARD partition.
-     */
-    void reset() override;
-
-  private:
     /**
      * Dimm/CPU enable property will be false if there are assosiated guard
      * record. The disabled dimm/cpu are not reset after host clears the guard
@@ -30,7 +28,13 @@ class GardResetMMC : public GardReset
      * guarded dimms/cpus. Modified to force enable all the guard/dimms during
      * factory reset
      */
-    void enableDimmAndCpu();
+    static void enableDimmAndCpu();
+
+  protected:
+    /**
+     * @brief GARD factory reset - clears the PNOR GARD partition.
+     */
+    void reset() override;
 };
 
 /** @class ItemUpdaterMMC
@@ -40,12 +44,18 @@ class ItemUpdaterMMC : public ItemUpdater
 {
   public:
     ItemUpdaterMMC(sdbusplus::bus::bus& bus, const std::string& path) :
-        ItemUpdater(bus, path)
+        ItemUpdater(bus, path),
+        shadowTimer(sdeventplus::Event(bus.get_event()),
+                    [this](auto&) { refreshShadow(); })
     {
         processPNORImage();
-        gardReset = std::make_unique<GardResetMMC>(bus, GARD_PATH);
+        gardReset = std::make_unique<GardResetMMC>(bus, GARD_PATH, *this);
         volatileEnable = std::make_unique<ObjectEnable>(bus, volatilePath);
 
+        // The shadow running tree is checked once the BMC settled, the
+        // alternate side may have been written by the BMC updater
+        shadowTimer.restartOnce(shadowDelay);
+
         // Emit deferred signal.
         emit_object_added();
     }
@@ -63,6 +73,8 @@ class ItemUpdaterMMC : public ItemUpdater
 
     bool isVersionFunctional(const std::string& versionId) override;
 
+    std::vector<ScrubTarget> scrubTargets() override;
+
   private:
     /** @brief Create Activation object */
     std::unique_ptr<Activation> createActivationObject(
@@ -88,8 +100,18 @@ class ItemUpdaterMMC : public ItemUpdater
      * Activation D-Bus object */
     void reset() override;
 
+    /** @brief Bring the shadow running tree up to date with the alternate
+     *  side, on a worker thread */
+    void refreshShadow();
+
     /** @brief The functional version ID */
     std::string functionalVersionId;
+
+    /** @brief The delay before the shadow running tree is checked */
+    static constexpr auto shadowDelay = std::chrono::minutes(10);
+
+    /** @brief Timer checking the shadow running tree after startup */
+    sdeventplus::utility::Timer<sdeventplus::ClockId::Monotonic> shadowTimer;
 };
 
 } // namespace updater
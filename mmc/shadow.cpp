@@ -0,0 +1,379 @@
+#include "config.h"
+
+#include "shadow.hpp"
+
+#include "host_lids.hpp"
+#include "paths.hpp"
+
+#include <fcntl.h>
+#include <linux/ioprio.h>
+#include <stdio.h>
+#include <sys/file.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <phosphor-logging/log.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <fstream>
+#include <sstream>
+
+namespace openpower
+{
+namespace software
+{
+namespace updater
+{
+
+namespace fs = std::filesystem;
+using namespace phosphor::logging;
+
+namespace
+{
+
+constexpr auto runningDir = "running";
+
+/** @brief Lowers the CPU and I/O priority of the calling worker thread,
+ *  restoring it when destroyed.
+ */
+class LowPriority
+{
+  public:
+    LowPriority() :
+        tid(gettid()), nice(getpriority(PRIO_PROCESS, tid)),
+        ioprio(syscall(SYS_ioprio_get, IOPRIO_WHO_PROCESS, tid))
+    {
+        setpriority(PRIO_PROCESS, tid, 19);
+        syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, tid,
+                IOPRIO_PRIO_VALUE(IOPRIO_CLASS_IDLE, 0));
+    }
+
+    ~LowPriority()
+    {
+        setpriority(PRIO_PROCESS, tid, nice);
+        if (ioprio >= 0)
+        {
+            syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, tid, ioprio);
+        }
+    }
+
+    LowPriority(const LowPriority&) = delete;
+    LowPriority& operator=(const LowPriority&) = delete;
+
+  private:
+    pid_t tid;
+    int nice;
+    long ioprio;
+};
+
+/** @brief Lock the hostfw trees against a concurrent population or switch
+ *
+ *  @param[in] hostfwDir - The hostfw directory
+ *  @param[in] wait      - Wait for the lock rather than fail
+ *
+ *  @return The locked file descriptor, or -1
+ */
+int lockTrees(const fs::path& hostfwDir, bool wait)
+{
+    int fd = open(hostfwDir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return -1;
+    }
+    if (flock(fd, LOCK_EX | (wait ? 0 : LOCK_NB)) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+std::string readFile(const fs::path& path)
+{
+    std::ifstream file(path);
+    std::stringstream content;
+    content << file.rdbuf();
+    return content.str();
+}
+
+std::string readLabel(const fs::path& tree)
+{
+    std::string label;
+    std::ifstream file(tree / partLabelFile);
+    file >> label;
+    return label;
+}
+
+/** @brief Write a small file of a tree through a temporary file */
+void writeFile(const fs::path& path, const std::string& content)
+{
+    auto tmpPath = fs::path(path).concat(".tmp");
+    {
+        std::ofstream file(tmpPath);
+        file << content;
+    }
+    std::error_code ec;
+    fs::rename(tmpPath, path, ec);
+}
+
+/** @brief Sync the directory entries of a directory */
+void syncDir(const fs::path& dir)
+{
+    int fd = open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd >= 0)
+    {
+        fsync(fd);
+        close(fd);
+    }
+}
+
+} // namespace
+
+std::string alternateLabel(const fs::path& hostfwDir)
+{
+    // The running side, rather than the boot side, as the boot side already
+    // points to the alternate side after a previous update
+    auto running = readLabel(hostfwDir / runningDir);
+    if (running == "a")
+    {
+        return "b";
+    }
+    if (running == "b")
+    {
+        return "a";
+    }
+    return {};
+}
+
+std::vector<std::string> parsePreserved(const std::string& toc)
+{
+    std::vector<std::string> names;
+    std::istringstream iss(toc);
+    std::string line;
+    while (std::getline(iss, line))
+    {
+        auto eq = line.find('=');
+        if ((line.rfind("partition", 0) != 0) || (eq == std::string::npos) ||
+            (line.find("PRESERVED") == std::string::npos))
+        {
+            continue;
+        }
+        auto end = line.find(',', eq);
+        if (end == std::string::npos)
+        {
+            continue;
+        }
+        names.push_back(line.substr(eq + 1, end - eq - 1));
+    }
+    return names;
+}
+
+std::vector<std::string> preservedLids(const fs::path& tree)
+{
+    std::vector<std::string> lids;
+    std::error_code ec;
+    for (const auto& name : parsePreserved(readFile(tree / tocLid)))
+    {
+        if (!fs::is_symlink(tree / name, ec))
+        {
+            continue;
+        }
+        auto lid = fs::read_symlink(tree / name, ec).filename();
+        if (!ec && fs::exists(tree / lid, ec))
+        {
+            lids.push_back(lid);
+        }
+    }
+    return lids;
+}
+
+std::string sideStamp(const fs::path& sideDir)
+{
+    std::string stamp;
+    for (const auto& lid : listLids(sideDir))
+    {
+        struct stat st;
+        if (stat((sideDir / lid).c_str(), &st) != 0)
+        {
+            continue;
+        }
+        stamp += lid + " " + std::to_string(st.st_size) + " " +
+                 std::to_string(st.st_mtim.tv_sec) + "." +
+                 std::to_string(st.st_mtim.tv_nsec) + "\n";
+    }
+    return stamp;
+}
+
+bool populateShadow(const fs::path& hostfwDir, const fs::path& sideDir,
+                    const std::string& label, std::stop_token token)
+{
+    LowPriority priority;
+    if (!fs::exists(sideDir / tocLid))
+    {
+        log<level::INFO>("The side is not mounted, the shadow tree is not "
+                         "populated",
+                         entry("DIR=%s", sideDir.c_str()));
+        return false;
+    }
+
+    int lock = lockTrees(hostfwDir, true);
+    if (lock < 0)
+    {
+        return false;
+    }
+
+    auto shadow = hostfwDir / shadowDir;
+    auto stamp = sideStamp(sideDir);
+    if ((readLabel(shadow) == label) &&
+        (readFile(shadow / partStampFile) == stamp))
+    {
+        close(lock);
+        return true;
+    }
+
+    // The tree is not switched to while it is being updated
+    std::error_code ec;
+    fs::create_directories(shadow, ec);
+    fs::remove(shadow / partLabelFile, ec);
+
+    auto plan = planLids(sideDir, shadow, token);
+    for (const auto& lid : plan.stale)
+    {
+        fs::remove(shadow / lid, ec);
+    }
+    bool populated = true;
+    std::atomic<uint64_t> done = 0;
+    for (const auto& lid : plan.changed)
+    {
+        if (!writeLid(sideDir / lid, shadow, done, token))
+        {
+            populated = false;
+            break;
+        }
+    }
+    populated = populated && !token.stop_requested();
+    if (populated)
+    {
+        sync();
+        writeFile(shadow / partStampFile, stamp);
+        writeFile(shadow / partLabelFile, label + "\n");
+        syncDir(shadow);
+        log<level::INFO>("Populated the shadow running tree",
+                         entry("PARTLABEL=%s", label.c_str()),
+                         entry("CHANGED=%zu", plan.changed.size()),
+                         entry("UNCHANGED=%zu", plan.unchanged));
+    }
+    close(lock);
+    return populated;
+}
+
+bool refreshShadow(std::stop_token token)
+{
+    fs::path hostfwDir(paths::mediaDir() + "hostfw");
+    auto label = alternateLabel(hostfwDir);
+    if (label.empty())
+    {
+        return false;
+    }
+    return populateShadow(hostfwDir, hostfwDir / "alternate", label,
+                          std::move(token));
+}
+
+bool switchShadow(const fs::path& hostfwDir, const std::string& bootLabel,
+                  const fs::path& sideDir)
+{
+    // A population in progress is not waited for, the tree is copied instead
+    int lock = lockTrees(hostfwDir, false);
+    if (lock < 0)
+    {
+        return false;
+    }
+
+    auto running = hostfwDir / runningDir;
+    auto shadow = hostfwDir / shadowDir;
+    if ((readLabel(shadow) != bootLabel) ||
+        (readFile(shadow / partStampFile) != sideStamp(sideDir)))
+    {
+        log<level::INFO>("No shadow running tree for the boot side",
+                         entry("PARTLABEL=%s", bootLabel.c_str()));
+        close(lock);
+        return false;
+    }
+
+    // Carry the data the host kept in the preserved partitions over
+    std::error_code ec;
+    std::atomic<uint64_t> done = 0;
+    for (const auto& name : parsePreserved(readFile(shadow / tocLid)))
+    {
+        if (!fs::is_symlink(running / name, ec))
+        {
+            continue;
+        }
+        auto lid = fs::read_symlink(running / name, ec).filename();
+        if (ec || !fs::exists(running / lid, ec))
+        {
+            continue;
+        }
+        auto size = fs::file_size(running / lid, ec);
+        if (ec || (size != fs::file_size(shadow / lid, ec)))
+        {
+            // As when the tree is copied, a preserved partition whose size
+            // changed is not carried over
+            log<level::ERR>("Preserved partition size changed",
+                            entry("PARTITION=%s", name.c_str()),
+                            entry("FILE_NAME=%s", lid.c_str()));
+            continue;
+        }
+        writeLid(running / lid, shadow, done, {});
+    }
+
+    // Carry the well-known names of the LIDs over
+    for (const auto& file : fs::directory_iterator(shadow, ec))
+    {
+        if (file.is_symlink(ec))
+        {
+            fs::remove(file.path(), ec);
+        }
+    }
+    for (const auto& file : fs::directory_iterator(running, ec))
+    {
+        if (!file.is_symlink(ec))
+        {
+            continue;
+        }
+        auto target = fs::read_symlink(file.path(), ec);
+        if (!ec && fs::exists(shadow / target, ec))
+        {
+            fs::create_symlink(target, shadow / file.path().filename(), ec);
+        }
+    }
+    sync();
+
+    if (renameat2(AT_FDCWD, running.c_str(), AT_FDCWD, shadow.c_str(),
+                  RENAME_EXCHANGE) != 0)
+    {
+        log<level::ERR>("Unable to switch the running tree",
+                        entry("ERRNO=%d", errno));
+        close(lock);
+        return false;
+    }
+    syncDir(hostfwDir);
+
+    // The outgoing tree holds what the host wrote to the side that was
+    // running, its LIDs are compared with the side before it is switched to
+    fs::remove(shadow / partStampFile, ec);
+    syncDir(shadow);
+
+    log<level::INFO>("Switched the running tree to the shadow tree",
+                     entry("PARTLABEL=%s", bootLabel.c_str()));
+    close(lock);
+    return true;
+}
+
+} // namespace updater
+} // namespace software
+} // namespace openpower
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <filesystem>
+#include <stop_token>
+#include <string>
+#include <vector>
+
+namespace openpower
+{
+namespace software
+{
+namespace updater
+{
+
+/** @brief The tree of LIDs of the alternate side, kept ready to replace the
+ *  running tree, relative to the hostfw directory
+ */
+constexpr auto shadowDir = "running-shadow";
+
+/** @brief The side a running tree holds, in the tree */
+constexpr auto partLabelFile = "partlabel";
+
+/** @brief The stamp of the side a shadow tree was populated from, in the
+ *  tree */
+constexpr auto partStampFile = "partstamp";
+
+/** @brief Get the hostfw side not running
+ *
+ *  @param[in] hostfwDir - The hostfw directory
+ *
+ *  @return a or b, or empty if the running side is not known
+ */
+std::string alternateLabel(const std::filesystem::path& hostfwDir);
+
+/** @brief Parse the preserved partitions out of the host firmware TOC
+ *
+ *  @param[in] toc - The content of the TOC LID, with lines such as
+ *                   partition05=SECBOOT,0x00381000,0x003a5000,00,ECC,PRESERVED
+ *
+ *  @return The names of the preserved partitions
+ */
+std::vector<std::string> parsePreserved(const std::string& toc);
+
+/** @brief Get the LIDs of the preserved partitions of a running tree, which
+ *  the host writes to
+ *
+ *  @param[in] tree - The running tree, whose well-known partition names link
+ *                    to the LIDs
+ *
+ *  @return The LID file names
+ */
+std::vector<std::string> preservedLids(const std::filesystem::path& tree);
+
+/** @brief Get the stamp of a side, which changes whenever one of its LIDs
+ *  is rewritten
+ *
+ *  @param[in] sideDir - The directory the side is mounted to
+ *
+ *  @return The name, size and modification time of each LID
+ */
+std::string sideStamp(const std::filesystem::path& sideDir);
+
+/** @brief Bring the shadow tree up to date with a side, writing only the
+ *  LIDs that differ. Runs at idle CPU and I/O priority, as it is not
+ *  needed until the next side switch.
+ *
+ *  @param[in] hostfwDir - The hostfw directory
+ *  @param[in] sideDir   - The directory the side is mounted to
+ *  @param[in] label     - The side, a or b
+ *  @param[in] token     - Stops the population early
+ *
+ *  @return true if the shadow tree holds the side
+ */
+bool populateShadow(const std::filesystem::path& hostfwDir,
+                    const std::filesystem::path& sideDir,
+                    const std::string& label, std::stop_token token);
+
+/** @brief Bring the shadow tree up to date with the alternate side
+ *
+ *  @param[in] token - Stops the population early
+ *
+ *  @return true if the shadow tree holds the alternate side
+ */
+bool refreshShadow(std::stop_token token);
+
+/** @brief Switch the running tree to the shadow tree of the boot side, in
+ *  a single rename exchanging the two trees. The preserved partitions and
+ *  the well-known names of the running tree are carried over first. The
+ *  outgoing tree holds what the host wrote, it is left unstamped so that
+ *  its LIDs are compared with its side before it is switched to again.
+ *
+ *  @param[in] hostfwDir - The hostfw directory
+ *  @param[in] bootLabel - The boot side, a or b
+ *  @param[in] sideDir   - The directory the boot side is mounted to
+ *
+ *  @return true if the running tree was switched, false if the shadow tree
+ *          does not hold the boot side and the running tree must be copied
+ */
+bool switchShadow(const std::filesystem::path& hostfwDir,
+                  const std::string& bootLabel,
+                  const std::filesystem::path& sideDir);
+
+} // namespace updater
+} // namespace software
+} // namespace openpower
@@ -1,6 +1,14 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <compare>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <stdexcept>
 #include <string>
+#include <string_view>
 
 namespace openpower
 {
@@ -9,68 +17,207 @@ namespace software
 namespace image
 {
 
-/** @class MinimumShipLevel
- *  @brief Contains minimum ship level verification functions.
+/** @struct Version
+ *  @brief The components of a host firmware version, ordered numerically.
  */
-class MinimumShipLevel
+struct Version
 {
-  public:
-    MinimumShipLevel() = delete;
-    MinimumShipLevel(const MinimumShipLevel&) = delete;
-    MinimumShipLevel& operator=(const MinimumShipLevel&) = delete;
-    MinimumShipLevel(MinimumShipLevel&&) = default;
-    MinimumShipLevel& operator=(MinimumShipLevel&&) = default;
-    ~MinimumShipLevel() = default;
+    uint32_t major = 0;
+    uint32_t minor = 0;
+    uint32_t rev = 0;
 
-    /** @brief Constructs MinimumShipLevel.
-     *  @param[in] minShipLevel - Minimum Ship Level string
-     */
-    explicit MinimumShipLevel(const std::string& minShipLevel) :
-        minShipLevel(minShipLevel){};
+    constexpr auto operator<=>(const Version&) const = default;
+};
 
-    /** @brief Verify if the current PNOR version meets the min ship level
-     *  @return true if the verification succeeded, false otherwise
-     */
-    bool verify();
+namespace detail
+{
 
-    /** @brief Version components */
-    struct Version
+/** @brief Parse the decimal digits at a position, saturating at the
+ *  largest component value.
+ *
+ *  @param[in]     str - The string
+ *  @param[in,out] pos - The position, moved past the digits
+ *
+ *  @return The value, or nullopt if there are no digits
+ */
+constexpr std::optional<uint32_t> parseNumber(std::string_view str,
+                                              size_t& pos)
+{
+    auto start = pos;
+    uint64_t value = 0;
+    while ((pos < str.size()) && (str[pos] >= '0') && (str[pos] <= '9'))
     {
-        uint8_t major;
-        uint8_t minor;
-        uint8_t rev;
-    };
+        value = std::min<uint64_t>(value * 10 + (str[pos] - '0'), UINT32_MAX);
+        pos++;
+    }
+    if (pos == start)
+    {
+        return std::nullopt;
+    }
+    return static_cast<uint32_t>(value);
+}
 
-    /** @brief Get the functional PNOR version on the system
-     *  @details If the PNOR version file is not found, don't log an error since
-     *           all PNOR images may had been deleted. If there is an issue with
-     *           the VERSION partition, it should be caught by the host fw code.
-     *  @return The populated or empty version string
-     */
-    std::string getFunctionalVersion();
+/** @brief Match v-X.Y or v-X.Y.Z, with an optional dash, at a position
+ *
+ *  @param[in] str   - The string
+ *  @param[in] pos   - The position of the 'v'
+ *  @param[in] parts - The number of components, 2 or 3
+ *
+ *  @return The version, or nullopt if it does not match
+ */
+constexpr std::optional<Version> matchVersion(std::string_view str, size_t pos,
+                                              size_t parts)
+{
+    if (str[pos++] != 'v')
+    {
+        return std::nullopt;
+    }
+    if ((pos < str.size()) && (str[pos] == '-'))
+    {
+        pos++;
+    }
 
-    /** @brief Parse the version components into a struct
-     *  @details Version format follows a git tag convention: vX.Y[.Z]
-     *          Reference:
-     *          https://github.com/open-power/op-build/blob/master/openpower/package/VERSION.readme
-     * @param[in]  versionStr - The version string to be parsed
-     * @param[out] version    - The version struct to be populated
-     */
-    void parse(const std::string& versionStr, Version& version);
+    std::array<uint32_t, 3> fields{};
+    for (size_t i = 0; i < parts; i++)
+    {
+        if (i > 0)
+        {
+            if ((pos >= str.size()) || (str[pos] != '.'))
+            {
+                return std::nullopt;
+            }
+            pos++;
+        }
+        auto field = parseNumber(str, pos);
+        if (!field)
+        {
+            return std::nullopt;
+        }
+        fields[i] = *field;
+    }
+    return Version{fields[0], fields[1], fields[2]};
+}
 
-    /** @brief Compare the versions provided
-     *  @param[in] a - The first version to compare
-     *  @param[in] b - The second version to compare
-     *  @return 1 if a > b
-     *          0 if a = b
-     *         -1 if a < b
-     */
-    int compare(const Version& a, const Version& b);
+} // namespace detail
 
-  private:
-    /** Minimum Ship Level to compare against */
-    std::string minShipLevel;
-};
+/** @brief Parse the version components out of a version string
+ *  @details Version format follows a git tag convention: vX.Y[.Z]
+ *          Reference:
+ *          https://github.com/open-power/op-build/blob/master/openpower/package/VERSION.readme
+ *          The first vX.Y.Z anywhere in the string is used, else the first
+ *          vX.Y.
+ *
+ *  @param[in] str - The version string to be parsed
+ *
+ *  @return The version, or nullopt if none is found
+ */
+constexpr std::optional<Version> parseVersion(std::string_view str)
+{
+    for (size_t parts : {3, 2})
+    {
+        for (size_t pos = 0; pos < str.size(); pos++)
+        {
+            if (auto version = detail::matchVersion(str, pos, parts))
+            {
+                return version;
+            }
+        }
+    }
+    return std::nullopt;
+}
+
+/** @brief Count the space separated levels of a minimum ship level */
+constexpr size_t countLevels(std::string_view levels)
+{
+    size_t count = 0;
+    bool inLevel = false;
+    for (auto c : levels)
+    {
+        if (c == ' ')
+        {
+            inLevel = false;
+        }
+        else if (!inLevel)
+        {
+            inLevel = true;
+            count++;
+        }
+    }
+    return count;
+}
+
+/** @brief Parse a minimum ship level into a table sorted in ascending
+ *  order. Meant to be evaluated at compile time, where a level that does
+ *  not parse fails the build.
+ *
+ *  @tparam    N      - The number of levels, from countLevels()
+ *  @param[in] levels - The space separated levels
+ *
+ *  @return The levels, sorted
+ */
+template <size_t N>
+constexpr std::array<Version, N> makePolicy(std::string_view levels)
+{
+    std::array<Version, N> policy{};
+    size_t pos = 0;
+    for (size_t i = 0; i < N; i++)
+    {
+        pos = levels.find_first_not_of(' ', pos);
+        auto end = std::min(levels.find(' ', pos), levels.size());
+        auto level = parseVersion(levels.substr(pos, end - pos));
+        if (!level)
+        {
+            throw std::invalid_argument("Invalid minimum ship level");
+        }
+        policy[i] = *level;
+        pos = end;
+    }
+    std::sort(policy.begin(), policy.end());
+    return policy;
+}
+
+/** @brief Find the level of a policy a version does not meet
+ *  @details The levels may be on several major.minor lines, e.g. v2.0.10
+ *  and v2.2: the major.minor section is compared first, then the rev if it
+ *  is the same. A version passes with 2.0.11 but fails with 2.1.x.
+ *
+ *  @param[in] actual - The version
+ *  @param[in] policy - The levels, sorted in ascending order
+ *
+ *  @return The level not met, or nullopt if the version meets the policy
+ */
+constexpr std::optional<Version> unmetLevel(const Version& actual,
+                                            std::span<const Version> policy)
+{
+    for (const auto& level : policy)
+    {
+        auto line = Version{actual.major, actual.minor, 0} <=>
+                    Version{level.major, level.minor, 0};
+        if (line < 0)
+        {
+            return level;
+        }
+        if (line == 0)
+        {
+            if (actual.rev < level.rev)
+            {
+                return level;
+            }
+            return std::nullopt;
+        }
+    }
+    return std::nullopt;
+}
+
+/** @brief Check a host firmware version against the minimum ship level
+ *  built into the updater, and report an Incompatible error if it is not
+ *  met.
+ *
+ *  @param[in] version - The version string
+ *
+ *  @return true if the version meets the minimum ship level
+ */
+bool verifyMinimumShipLevel(const std::string& version);
 
 } // namespace image
 } // namespace software
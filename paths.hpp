@@ -0,0 +1,79 @@
+#pragma once
+
+#include "config.h"
+
+#include <cstdlib>
+#include <string>
+
+namespace openpower
+{
+namespace software
+{
+namespace updater
+{
+namespace paths
+{
+
+/** @brief Read a directory from the environment, or fall back to the
+ *  configured one. The environment is only read by the builds for the
+ *  latency harness, configured with test-paths, the daemon otherwise
+ *  always uses the configured directory.
+ *
+ *  @param[in] variable - The environment variable naming the directory
+ *  @param[in] fallback - The configured directory
+ *  @param[in] slash    - Whether the directory ends with a '/'
+ *
+ *  @return The directory
+ */
+inline std::string fromEnvironment([[maybe_unused]] const char* variable,
+                                   const char* fallback,
+                                   [[maybe_unused]] bool slash)
+{
+#ifdef TEST_PATHS
+    const char* value = std::getenv(variable);
+    if (value && *value)
+    {
+        std::string dir(value);
+        if (slash && (dir.back() != '/'))
+        {
+            dir += '/';
+        }
+        return dir;
+    }
+#endif
+    return fallback;
+}
+
+/** @brief The directory of the images staged by the image manager, IMG_DIR
+ *  unless a test build names another through OPENPOWER_UPDATE_IMG_DIR */
+inline const std::string& imgDir()
+{
+    static const std::string dir =
+        fromEnvironment("OPENPOWER_UPDATE_IMG_DIR", IMG_DIR, false);
+    return dir;
+}
+
+/** @brief The directory of the persisted updater data, PERSIST_DIR unless a
+ *  test build names another through OPENPOWER_UPDATE_PERSIST_DIR. Ends with
+ *  '/'. */
+inline const std::string& persistDir()
+{
+    static const std::string dir =
+        fromEnvironment("OPENPOWER_UPDATE_PERSIST_DIR", PERSIST_DIR, true);
+    return dir;
+}
+
+/** @brief The directory the host firmware is mounted under, MEDIA_DIR unless
+ *  a test build names another through OPENPOWER_UPDATE_MEDIA_DIR. Ends with
+ *  '/'. */
+inline const std::string& mediaDir()
+{
+    static const std::string dir =
+        fromEnvironment("OPENPOWER_UPDATE_MEDIA_DIR", MEDIA_DIR, true);
+    return dir;
+}
+
+} // namespace paths
+} // namespace updater
+} // namespace software
+} // namespace openpower
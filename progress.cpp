@@ -0,0 +1,200 @@
+#include "config.h"
+
+#include "progress.hpp"
+
+#include "paths.hpp"
+
+#include <cereal/archives/json.hpp>
+#include <cereal/types/map.hpp>
+#include <cereal/types/string.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+
+namespace openpower
+{
+namespace software
+{
+namespace updater
+{
+
+namespace fs = std::filesystem;
+
+namespace
+{
+
+constexpr auto throughputFile = "throughput";
+
+/** @brief Throughput assumed for a stage with no history, in bytes/s */
+constexpr double defaultRate = 1024 * 1024;
+
+/** @brief Weight of the latest activation in the throughput average */
+constexpr double ewmaWeight = 0.3;
+
+/** @brief Stages done quicker than this are too short to measure */
+constexpr auto minSampleTime = std::chrono::seconds(5);
+
+/** @brief Fraction of a stage the extrapolation stops at until it is done */
+constexpr double maxEstimated = 0.99;
+
+} // namespace
+
+Throughput restoreThroughput()
+{
+    Throughput throughput;
+    auto path = fs::path(paths::persistDir()) / throughputFile;
+    if (!fs::exists(path))
+    {
+        return throughput;
+    }
+
+    std::ifstream input(path.c_str(), std::ios::in);
+    try
+    {
+        cereal::JSONInputArchive archive(input);
+        archive(cereal::make_nvp("throughput", throughput));
+    }
+    catch (const cereal::RapidJSONException& e)
+    {
+        fs::remove(path);
+        throughput.clear();
+    }
+    return throughput;
+}
+
+void storeThroughput(const Throughput& throughput)
+{
+    auto path = fs::path(paths::persistDir()) / throughputFile;
+    fs::create_directories(path.parent_path());
+
+    auto tmpPath = fs::path(path).concat(".tmp");
+    {
+        std::ofstream output(tmpPath.c_str());
+        cereal::JSONOutputArchive archive(output);
+        archive(cereal::make_nvp("throughput", throughput));
+    }
+    fs::rename(tmpPath, path);
+}
+
+ProgressModel::ProgressModel(std::vector<ProgressStage> stages,
+                             Throughput throughput, Clock::time_point now) :
+    stages(std::move(stages)),
+    rates(std::move(throughput)), stageTimes(this->stages.size()),
+    stageStart(now), doneAt(now)
+{}
+
+double ProgressModel::rate(size_t stage) const
+{
+    auto it = rates.find(stages[stage].name);
+    return (it != rates.end() && it->second > 0) ? it->second : defaultRate;
+}
+
+void ProgressModel::advance(size_t stage, uint64_t bytesDone,
+                            Clock::time_point now)
+{
+    stage = std::min(stage, stages.size());
+    if (stage < current)
+    {
+        return;
+    }
+    if (stage == current)
+    {
+        done = bytesDone;
+        doneAt = now;
+        return;
+    }
+
+    // The stages done since the last stage change took elapsed instead of
+    // the expected time, scale their throughput accordingly
+    std::chrono::duration<double> elapsed = now - stageStart;
+    stageTimes[current] +=
+        std::chrono::duration_cast<std::chrono::milliseconds>(now - stageStart);
+    double expected = 0;
+    for (auto i = current; i < stage; i++)
+    {
+        auto bytes = stages[i].bytes;
+        if (i == current)
+        {
+            bytes -= std::min(bytes, startDone);
+        }
+        expected += bytes / rate(i);
+    }
+    if ((elapsed >= minSampleTime) && (expected > 0))
+    {
+        auto factor = expected / elapsed.count();
+        for (auto i = current; i < stage; i++)
+        {
+            auto observed = rate(i) * factor;
+            auto it = rates.find(stages[i].name);
+            if (it != rates.end() && it->second > 0)
+            {
+                it->second =
+                    ewmaWeight * observed + (1 - ewmaWeight) * it->second;
+            }
+            else
+            {
+                rates[stages[i].name] = observed;
+            }
+        }
+    }
+
+    current = stage;
+    stageStart = now;
+    startDone = bytesDone;
+    done = bytesDone;
+    doneAt = now;
+}
+
+uint64_t ProgressModel::estimatedDone(Clock::time_point now) const
+{
+    if (current >= stages.size())
+    {
+        return 0;
+    }
+    auto bytes = stages[current].bytes;
+    std::chrono::duration<double> elapsed = now - doneAt;
+    auto extrapolated = done + rate(current) * elapsed.count();
+    auto estimated = std::min(extrapolated, bytes * maxEstimated);
+    return std::max(std::min(done, bytes), static_cast<uint64_t>(estimated));
+}
+
+double ProgressModel::fraction(Clock::time_point now) const
+{
+    uint64_t total = 0;
+    uint64_t bytesDone = 0;
+    for (size_t i = 0; i < stages.size(); i++)
+    {
+        total += stages[i].bytes;
+        if (i < current)
+        {
+            bytesDone += stages[i].bytes;
+        }
+    }
+    if (total == 0)
+    {
+        return current >= stages.size() ? 1 : 0;
+    }
+    bytesDone += estimatedDone(now);
+    return static_cast<double>(bytesDone) / total;
+}
+
+std::chrono::seconds ProgressModel::remaining(Clock::time_point now) const
+{
+    if (current >= stages.size())
+    {
+        return std::chrono::seconds(0);
+    }
+    double seconds = (stages[current].bytes - estimatedDone(now)) /
+                     rate(current);
+    for (auto i = current + 1; i < stages.size(); i++)
+    {
+        seconds += stages[i].bytes / rate(i);
+    }
+    return std::chrono::seconds(static_cast<int64_t>(std::ceil(seconds)));
+}
+
+} // namespace updater
+} // namespace software
+} // namespace openpower
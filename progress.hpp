@@ -0,0 +1,145 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace openpower
+{
+namespace software
+{
+namespace updater
+{
+
+/** @brief Measured throughput in bytes per second, keyed by stage name */
+using Throughput = std::map<std::string, double>;
+
+/** @struct ProgressStage
+ *  @brief A stage of an activation and the bytes of work it does.
+ */
+struct ProgressStage
+{
+    /** @brief The stage name, the key of its throughput history */
+    std::string name;
+
+    /** @brief The bytes the stage reads or writes */
+    uint64_t bytes = 0;
+
+    /** @brief Whether the stage writes its bytes to flash */
+    bool writes = false;
+};
+
+/** @brief Restores the throughput measured by the past activations
+ *  @return The throughput of each stage, empty if there is no history
+ */
+Throughput restoreThroughput();
+
+/** @brief Stores the throughput measured by the activations
+ *  @param[in] throughput - The throughput of each stage
+ */
+void storeThroughput(const Throughput& throughput);
+
+/** @class ProgressModel
+ *  @brief Estimates the progress of an activation from the bytes of work
+ *  of its stages and the throughput measured by past activations.
+ *  @details The progress within a stage is extrapolated from the time
+ *  spent in it, or from the bytes reported done when the stage reports
+ *  them. The stage durations refine the throughput history as an
+ *  exponentially weighted moving average.
+ */
+class ProgressModel
+{
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    /** @brief Constructs ProgressModel
+     *
+     *  @param[in] stages     - The stages of the activation, in order
+     *  @param[in] throughput - The throughput history
+     *  @param[in] now        - The start time of the first stage
+     */
+    ProgressModel(std::vector<ProgressStage> stages, Throughput throughput,
+                  Clock::time_point now);
+
+    /** @brief Report the progress of the activation
+     *
+     *  @param[in] stage - The stage in progress, the number of stages once
+     *                     they are all done
+     *  @param[in] done  - The bytes of the stage done
+     *  @param[in] now   - The current time
+     */
+    void advance(size_t stage, uint64_t done, Clock::time_point now);
+
+    /** @brief Get the estimated fraction of the work done
+     *
+     *  @param[in] now - The current time
+     *
+     *  @return A value from 0 to 1
+     */
+    double fraction(Clock::time_point now) const;
+
+    /** @brief Get the estimated time left
+     *
+     *  @param[in] now - The current time
+     *
+     *  @return The remaining time
+     */
+    std::chrono::seconds remaining(Clock::time_point now) const;
+
+    /** @brief Get the stages of the activation */
+    const std::vector<ProgressStage>& stageList() const
+    {
+        return stages;
+    }
+
+    /** @brief Get the time spent in each stage. The stages done within the
+     *  same report are counted in the first of them.
+     */
+    const std::vector<std::chrono::milliseconds>& durations() const
+    {
+        return stageTimes;
+    }
+
+    /** @brief Get the throughput history refined by this activation */
+    const Throughput& throughput() const
+    {
+        return rates;
+    }
+
+  private:
+    /** @brief Get the throughput of a stage */
+    double rate(size_t stage) const;
+
+    /** @brief Get the bytes of the current stage estimated done */
+    uint64_t estimatedDone(Clock::time_point now) const;
+
+    /** @brief The stages of the activation */
+    std::vector<ProgressStage> stages;
+
+    /** @brief The throughput of each stage */
+    Throughput rates;
+
+    /** @brief The time spent in each stage */
+    std::vector<std::chrono::milliseconds> stageTimes;
+
+    /** @brief The current stage */
+    size_t current = 0;
+
+    /** @brief When the current stage started */
+    Clock::time_point stageStart;
+
+    /** @brief The bytes of the current stage done when it started */
+    uint64_t startDone = 0;
+
+    /** @brief The bytes of the current stage last reported done */
+    uint64_t done = 0;
+
+    /** @brief When the bytes done were last reported */
+    Clock::time_point doneAt;
+};
+
+} // namespace updater
+} // namespace software
+} // namespace openpower
@@ -0,0 +1,241 @@
+#include "config.h"
+
+#include "scrubber.hpp"
+
+#include "buffer_pool.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <phosphor-logging/log.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <string>
+#include <variant>
+
+namespace openpower
+{
+namespace software
+{
+namespace updater
+{
+
+using namespace phosphor::logging;
+namespace sdbusRule = sdbusplus::bus::match::rules;
+
+namespace
+{
+
+constexpr size_t chunkSize = 64 * 1024;
+constexpr auto startupDelay = std::chrono::minutes(15);
+constexpr auto passInterval = std::chrono::hours(SCRUB_INTERVAL);
+constexpr auto stepInterval = std::chrono::microseconds(
+    (std::chrono::microseconds(std::chrono::seconds(1)).count() * chunkSize) /
+    (SCRUB_RATE * 1024));
+
+} // namespace
+
+Scrubber::Scrubber(sdbusplus::bus::bus& bus, const sdeventplus::Event& event,
+                   ItemUpdater& updater) :
+    updater(updater),
+    passTimer(event, [this](auto&) { startPass(); }),
+    stepTimer(event, [this](auto&) { step(); }),
+    chassisStateSignals(
+        bus,
+        sdbusRule::type::signal() + sdbusRule::member("PropertiesChanged") +
+            sdbusRule::path(CHASSIS_STATE_PATH) +
+            sdbusRule::argN(0, CHASSIS_STATE_OBJ) +
+            sdbusRule::interface(SYSTEMD_PROPERTY_INTERFACE),
+        std::bind(std::mem_fn(&Scrubber::chassisStateChange), this,
+                  std::placeholders::_1))
+{
+    if (passInterval.count() == 0)
+    {
+        // Scrubbing is disabled
+        return;
+    }
+
+    // Leave the BMC time to settle before the first pass
+    passTimer.restartOnce(startupDelay);
+}
+
+void Scrubber::startPass()
+{
+    if (scrubbing)
+    {
+        return;
+    }
+
+    try
+    {
+        chassisOn = updater.isChassisOn();
+    }
+    catch (const std::exception& e)
+    {
+        // Unknown chassis state, assume the host may be using the flash
+        chassisOn = true;
+    }
+
+    if (chassisOn)
+    {
+        // Run the pass as soon as the chassis powers off
+        passPending = true;
+        return;
+    }
+
+    passPending = false;
+    targets = updater.scrubTargets();
+    if (targets.empty())
+    {
+        finishPass();
+        return;
+    }
+
+    log<level::INFO>("Starting integrity scrub of the installed images",
+                     entry("REGIONS=%zu", targets.size()));
+
+    scrubbing = true;
+    current = 0;
+    position = 0;
+    digest = std::make_unique<Digest>();
+    stepTimer.restartOnce(stepInterval);
+}
+
+void Scrubber::step()
+{
+    // The scrub waits for the activations rather than the other way round
+    auto buffer = BufferPool::get().tryAcquire();
+    if (!buffer)
+    {
+        stepTimer.restartOnce(stepInterval);
+        return;
+    }
+
+    const auto& target = targets[current];
+    auto want = static_cast<size_t>(
+        std::min<uint64_t>(chunkSize, target.region.length - position));
+
+    // The device is only held open for the duration of a single read so that
+    // the scrubber never prevents a version from being erased.
+    ssize_t rc = -1;
+    int fd = open(target.device.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd >= 0)
+    {
+        auto offset = target.region.offset + position;
+        rc = pread(fd, buffer.data(), want, offset);
+        posix_fadvise(fd, offset, want, POSIX_FADV_DONTNEED);
+        close(fd);
+    }
+
+    if (rc <= 0)
+    {
+        // The version may have been erased since the pass started, skip it.
+        log<level::ERR>("Failed to read the installed image, skipping it",
+                        entry("DEVICE=%s", target.device.c_str()),
+                        entry("REGION=%s", target.region.name.c_str()));
+        digest.reset();
+        finishRegion();
+        return;
+    }
+
+    digest->update(buffer.data(), rc);
+    position += rc;
+    if (position >= target.region.length)
+    {
+        finishRegion();
+        return;
+    }
+
+    stepTimer.restartOnce(stepInterval);
+}
+
+void Scrubber::finishRegion()
+{
+    const auto& target = targets[current];
+    if (digest)
+    {
+        auto actual = digest->final();
+        if (target.region.digest.empty())
+        {
+            // No digest was recorded for this image, take this read as the
+            // baseline for the next passes.
+            IntegrityRecord record;
+            record.regions.push_back(target.region);
+            record.regions.back().digest = actual;
+            record.stamp = target.stamp;
+            storeIntegrity(target.versionId, record);
+            updater.clearCorruption(target.versionId);
+        }
+        else if (actual != target.region.digest)
+        {
+            updater.flagCorruption(target.versionId, target.region.name);
+        }
+    }
+
+    current++;
+    position = 0;
+    if (current >= targets.size())
+    {
+        finishPass();
+        return;
+    }
+
+    digest = std::make_unique<Digest>();
+    stepTimer.restartOnce(stepInterval);
+}
+
+void Scrubber::finishPass()
+{
+    if (scrubbing)
+    {
+        log<level::INFO>("Integrity scrub of the installed images complete");
+    }
+
+    scrubbing = false;
+    targets.clear();
+    digest.reset();
+    passTimer.restartOnce(passInterval);
+}
+
+void Scrubber::chassisStateChange(sdbusplus::message::message& msg)
+{
+    std::string interface, chassisState;
+    std::map<std::string, std::variant<std::string>> properties;
+
+    msg.read(interface, properties);
+
+    for (const auto& p : properties)
+    {
+        if (p.first == "CurrentPowerState")
+        {
+            chassisState = std::get<std::string>(p.second);
+        }
+    }
+    if (chassisState.empty())
+    {
+        // The chassis power state property did not change, return.
+        return;
+    }
+
+    chassisOn = (chassisState != CHASSIS_STATE_OFF);
+    if (chassisOn)
+    {
+        // Pause the pass, it resumes where it left off once the chassis is
+        // powered off again.
+        stepTimer.setEnabled(false);
+    }
+    else if (scrubbing)
+    {
+        stepTimer.restartOnce(stepInterval);
+    }
+    else if (passPending)
+    {
+        startPass();
+    }
+}
+
+} // namespace updater
+} // namespace software
+} // namespace openpower
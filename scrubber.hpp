@@ -0,0 +1,107 @@
+#pragma once
+
+#include "integrity.hpp"
+#include "item_updater.hpp"
+
+#include <sdbusplus/bus.hpp>
+#include <sdbusplus/bus/match.hpp>
+#include <sdeventplus/clock.hpp>
+#include <sdeventplus/event.hpp>
+#include <sdeventplus/utility/timer.hpp>
+
+#include <memory>
+#include <vector>
+
+namespace openpower
+{
+namespace software
+{
+namespace updater
+{
+
+using ScrubTimer = sdeventplus::utility::Timer<sdeventplus::ClockId::Monotonic>;
+
+/** @class Scrubber
+ *  @brief Periodically re-verifies the installed host images against the
+ *  digests recorded when they were activated.
+ *  @details The images are read in small chunks spaced out to honour the
+ *  configured scrub rate, and only while the chassis is powered off so the
+ *  host never competes with the scrubber for the flash. A region that does
+ *  not match its recorded digest is flagged on its Activation.
+ */
+class Scrubber
+{
+  public:
+    Scrubber() = delete;
+    Scrubber(const Scrubber&) = delete;
+    Scrubber& operator=(const Scrubber&) = delete;
+    Scrubber(Scrubber&&) = delete;
+    Scrubber& operator=(Scrubber&&) = delete;
+    ~Scrubber() = default;
+
+    /** @brief Constructs Scrubber
+     *
+     * @param[in] bus     - The D-Bus bus object
+     * @param[in] event   - The event loop to schedule the reads on
+     * @param[in] updater - The item updater owning the installed versions
+     */
+    Scrubber(sdbusplus::bus::bus& bus, const sdeventplus::Event& event,
+             ItemUpdater& updater);
+
+  private:
+    /** @brief Start a scrub pass over all the installed images */
+    void startPass();
+
+    /** @brief Verify the next chunk of the current region */
+    void step();
+
+    /** @brief Complete the current region and move to the next one */
+    void finishRegion();
+
+    /** @brief Complete the scrub pass and schedule the next one */
+    void finishPass();
+
+    /** @brief Callback for the chassis power state changes, pauses and
+     *  resumes the scrub pass.
+     *
+     * @param[in]  msg       - Data associated with subscribed signal
+     */
+    void chassisStateChange(sdbusplus::message::message& msg);
+
+    /** @brief The item updater owning the installed versions */
+    ItemUpdater& updater;
+
+    /** @brief Timer scheduling the scrub passes */
+    ScrubTimer passTimer;
+
+    /** @brief Timer pacing the reads within a scrub pass */
+    ScrubTimer stepTimer;
+
+    /** @brief sdbusplus signal match for the chassis power state */
+    sdbusplus::bus::match_t chassisStateSignals;
+
+    /** @brief The regions being verified by the current pass */
+    std::vector<ScrubTarget> targets;
+
+    /** @brief Index of the region being verified */
+    size_t current = 0;
+
+    /** @brief Number of bytes of the current region verified so far */
+    uint64_t position = 0;
+
+    /** @brief Running digest of the current region */
+    std::unique_ptr<Digest> digest;
+
+    /** @brief Whether a pass is in progress */
+    bool scrubbing = false;
+
+    /** @brief Whether a pass is due but waiting for the chassis to be off */
+    bool passPending = false;
+
+    /** @brief Last known chassis power state */
+    bool chassisOn = true;
+};
+
+} // namespace updater
+} // namespace software
+} // namespace openpower
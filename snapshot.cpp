@@ -0,0 +1,118 @@
+#include "config.h"
+
+#include "snapshot.hpp"
+
+#include "paths.hpp"
+
+#include <cereal/archives/json.hpp>
+#include <cereal/types/string.hpp>
+#include <cereal/types/vector.hpp>
+
+#include <filesystem>
+#include <fstream>
+
+namespace openpower
+{
+namespace software
+{
+namespace updater
+{
+
+namespace fs = std::filesystem;
+namespace server = sdbusplus::xyz::openbmc_project::Software::server;
+
+namespace
+{
+
+constexpr auto snapshotFile = "discovery";
+
+fs::path snapshotPath()
+{
+    return fs::path(paths::persistDir()) / snapshotFile;
+}
+
+} // namespace
+
+template <class Archive>
+void save(Archive& archive, const DiscoveredVersion& found)
+{
+    archive(cereal::make_nvp("versionId", found.versionId),
+            cereal::make_nvp("version", found.version),
+            cereal::make_nvp("extendedVersion", found.extendedVersion),
+            cereal::make_nvp("activation",
+                             server::Activation::convertActivationsToString(
+                                 found.activationState)),
+            cereal::make_nvp("priority", found.priority));
+}
+
+template <class Archive>
+void load(Archive& archive, DiscoveredVersion& found)
+{
+    std::string activation;
+    archive(cereal::make_nvp("versionId", found.versionId),
+            cereal::make_nvp("version", found.version),
+            cereal::make_nvp("extendedVersion", found.extendedVersion),
+            cereal::make_nvp("activation", activation),
+            cereal::make_nvp("priority", found.priority));
+    found.activationState =
+        server::Activation::convertActivationsFromString(activation);
+}
+
+template <class Archive>
+void serialize(Archive& archive, DiscoverySnapshot& snapshot)
+{
+    archive(cereal::make_nvp("fingerprint", snapshot.fingerprint),
+            cereal::make_nvp("versions", snapshot.versions),
+            cereal::make_nvp("functionalId", snapshot.functionalId));
+}
+
+void storeSnapshot(const DiscoverySnapshot& snapshot)
+{
+    auto path = snapshotPath();
+    fs::create_directories(path.parent_path());
+
+    // Replace the file at once, a partly written snapshot would otherwise
+    // be discarded on the next start only after failing to parse.
+    auto tmpPath = fs::path(path).concat(".tmp");
+    {
+        std::ofstream output(tmpPath.c_str());
+        cereal::JSONOutputArchive archive(output);
+        archive(cereal::make_nvp("snapshot", snapshot));
+    }
+    std::error_code ec;
+    fs::rename(tmpPath, path, ec);
+}
+
+bool restoreSnapshot(const std::string& fingerprint,
+                     DiscoverySnapshot& snapshot)
+{
+    auto path = snapshotPath();
+    if (fingerprint.empty() || !fs::exists(path))
+    {
+        return false;
+    }
+
+    std::ifstream input(path.c_str(), std::ios::in);
+    try
+    {
+        cereal::JSONInputArchive archive(input);
+        archive(cereal::make_nvp("snapshot", snapshot));
+        return snapshot.fingerprint == fingerprint;
+    }
+    catch (const std::exception& e)
+    {
+        // Either not valid JSON or an unknown activation state
+        fs::remove(path);
+    }
+    return false;
+}
+
+void removeSnapshot()
+{
+    std::error_code ec;
+    fs::remove(snapshotPath(), ec);
+}
+
+} // namespace updater
+} // namespace software
+} // namespace openpower
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "item_updater.hpp"
+
+#include <string>
+#include <vector>
+
+namespace openpower
+{
+namespace software
+{
+namespace updater
+{
+
+/** @struct DiscoverySnapshot
+ *  @brief The host versions found on flash at startup, persisted so that a
+ *  restart of the updater can publish them without reading the flash again.
+ */
+struct DiscoverySnapshot
+{
+    /** @brief Layout specific summary of the flash state the versions were
+     *  discovered from. The snapshot is only used while it matches. */
+    std::string fingerprint;
+
+    /** @brief The discovered versions */
+    std::vector<DiscoveredVersion> versions;
+
+    /** @brief The id of the functional version */
+    std::string functionalId;
+};
+
+/** @brief Stores the discovery snapshot
+ *  @param[in] snapshot - The snapshot.
+ */
+void storeSnapshot(const DiscoverySnapshot& snapshot);
+
+/** @brief Restores the discovery snapshot if it matches the flash state
+ *  @param[in] fingerprint - The fingerprint of the current flash state.
+ *  @param[out] snapshot - The snapshot.
+ *  @return true if a matching snapshot was restored
+ */
+bool restoreSnapshot(const std::string& fingerprint,
+                     DiscoverySnapshot& snapshot);
+
+/** @brief Removes the discovery snapshot, if it exists. */
+void removeSnapshot();
+
+} // namespace updater
+} // namespace software
+} // namespace openpower
@@ -1,9 +1,16 @@
 #include "activation_static.hpp"
 
+#include "flash_health.hpp"
 #include "item_updater.hpp"
+#include "item_updater_static.hpp"
+#include "paths.hpp"
+#include "snapshot.hpp"
 
 #include <phosphor-logging/log.hpp>
 
+#include <filesystem>
+#include <limits>
+
 namespace openpower
 {
 namespace software
@@ -25,7 +32,7 @@ auto ActivationStatic::activation(Activations value) -> Activations
 
     if (value == softwareServer::Activation::Activations::Activating)
     {
-        fs::path imagePath(IMG_DIR);
+        fs::path imagePath(paths::imgDir());
         imagePath /= versionId;
 
         for (const auto& entry : fs::directory_iterator(imagePath))
@@ -43,16 +50,42 @@ auto ActivationStatic::activation(Activations value) -> Activations
             ret = softwareServer::Activation::Activations::Failed;
             goto out;
         }
+
+        // A system with several host flash devices programs one image to each
+        imageDir = imagePath;
+        deviceImages = readDeviceMap(imagePath);
+        for (const auto& device : deviceImages)
+        {
+            if (device.device.empty() || !fs::exists(device.image))
+            {
+                log<level::ERR>("Unable to find the image of a flash device",
+                                entry("IMAGE=%s", device.image.c_str()),
+                                entry("DEVICE=%s", device.device.c_str()));
+                ret = softwareServer::Activation::Activations::Failed;
+                goto out;
+            }
+        }
 #ifdef WANT_SIGNATURE_VERIFY
-        // Validate the signed image.
-        if (!validateSignature(pnorFilePath.filename()))
+        // Validate the signed image, and every image programmed to a device
+        std::vector<fs::path> signedImages{pnorFilePath};
+        for (const auto& device : deviceImages)
         {
-            // Cleanup
-            activationBlocksTransition.reset(nullptr);
-            activationProgress.reset(nullptr);
+            if (device.image != pnorFilePath)
+            {
+                signedImages.push_back(device.image);
+            }
+        }
+        for (const auto& image : signedImages)
+        {
+            if (!validateSignature(image.lexically_relative(imagePath)))
+            {
+                // Cleanup
+                activationBlocksTransition.reset(nullptr);
+                activationProgress.reset(nullptr);
 
-            ret = softwareServer::Activation::Activations::Failed;
-            goto out;
+                ret = softwareServer::Activation::Activations::Failed;
+                goto out;
+            }
         }
 #endif
         if (parent.freeSpace())
@@ -91,13 +124,22 @@ void ActivationStatic::startActivation()
     // function?
     subscribeToSystemdSignals();
 
+    // The VERSION partition may change under an unchanged TOC
+    removeSnapshot();
+
+    // The update service programs the devices of a device map together
+    const auto& target = deviceImages.empty() ? pnorFilePath : imageDir;
     log<level::INFO>("Start programming...",
-                     entry("PNOR=%s", pnorFilePath.c_str()));
+                     entry("PNOR=%s", target.c_str()));
 
-    std::string pnorFileEscaped = pnorFilePath.string();
+    std::string pnorFileEscaped = target.string();
     // Escape all '/' to '-'
     std::replace(pnorFileEscaped.begin(), pnorFileEscaped.end(), '/', '-');
 
+    // Drop the progress of an earlier attempt
+    std::error_code ec;
+    fs::remove(imageDir / programProgressFile, ec);
+
     constexpr auto updatePNORService = "openpower-pnor-update@";
     pnorUpdateUnit =
         std::string(updatePNORService) + pnorFileEscaped + ".service";
@@ -106,7 +148,32 @@ void ActivationStatic::startActivation()
     method.append(pnorUpdateUnit, "replace");
     bus.call_noreply(method);
 
-    activationProgress->progress(10);
+    // pflash programs the whole image, or the image of each device
+    std::vector<fs::path> images{pnorFilePath};
+    if (!deviceImages.empty())
+    {
+        images.clear();
+        for (const auto& device : deviceImages)
+        {
+            images.push_back(device.image);
+        }
+    }
+    uint64_t size = 0;
+    for (const auto& image : images)
+    {
+        std::error_code ec;
+        auto imageSize = std::filesystem::file_size(image, ec);
+        size += ec ? 0 : imageSize;
+    }
+    // The update service publishes the bytes programmed to all the devices
+    activationProgress->start(
+        {{"pflash", size, true}},
+        [imageDir = imageDir](ProgressModel& model) {
+            if (auto bytes = readProgramProgress(imageDir))
+            {
+                model.advance(0, *bytes, ProgressModel::Clock::now());
+            }
+        });
 }
 
 void ActivationStatic::unitStateChange(sdbusplus::message::message& msg)
@@ -127,15 +194,16 @@ void ActivationStatic::unitStateChange(sdbusplus::message::message& msg)
         }
         if (newStateResult == "failed" || newStateResult == "dependency")
         {
-            Activation::activation(
-                softwareServer::Activation::Activations::Failed);
+            // Dropping the progress stops its timer and records the failed
+            // attempt in the history, as the other layouts do
+            activation(softwareServer::Activation::Activations::Failed);
         }
     }
 }
 
 void ActivationStatic::finishActivation()
 {
-    activationProgress->progress(90);
+    activationProgress->finish();
 
     // Set Redundancy Priority before setting to Active
     if (!redundancyPriority)
@@ -150,6 +218,12 @@ void ActivationStatic::finishActivation()
     activationProgress.reset();
 
     unsubscribeFromSystemdSignals();
+    // Record the digests of the partitions written to flash
+    parent.recordIntegrity(versionId, pnorFilePath);
+    // The update rewrites the whole flash, store the count before the
+    // reboot that usually follows
+    recordFlashWrite(0, std::numeric_limits<uint64_t>::max());
+    flushFlashWrites();
     // Remove version object from image manager
     deleteImageManagerObject();
     // Create active association
@@ -1,9 +1,11 @@
 #pragma once
 
 #include "activation.hpp"
+#include "flash_device.hpp"
 
 #include <filesystem>
 #include <string>
+#include <vector>
 
 namespace openpower
 {
@@ -32,6 +34,13 @@ class ActivationStatic : public Activation
     std::string pnorUpdateUnit;
 
     fs::path pnorFilePath;
+
+    /** @brief The directory of the image */
+    fs::path imageDir;
+
+    /** @brief The image of each host flash device, empty for a system with
+     *  a single PNOR flash device */
+    std::vector<DeviceImage> deviceImages;
 };
 
 } // namespace updater
@@ -3,19 +3,31 @@
 #include "item_updater_static.hpp"
 
 #include "activation_static.hpp"
+#include "flash_device.hpp"
+#include "flash_health.hpp"
+#include "history.hpp"
 #include "utils.hpp"
 #include "version.hpp"
 
+#include <endian.h>
+
 #include <phosphor-logging/elog-errors.hpp>
 #include <phosphor-logging/log.hpp>
 #include <xyz/openbmc_project/Common/error.hpp>
 
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <cstring>
 #include <filesystem>
 #include <fstream>
+#include <mutex>
+#include <optional>
 #include <sstream>
 #include <string>
+#include <thread>
 #include <tuple>
 
 using namespace sdbusplus::xyz::openbmc_project::Common::Error;
@@ -192,6 +204,166 @@ std::vector<PartClear> getPartsToClear()
     return getPartsToClear(pflashInfo);
 }
 
+using openpower::software::updater::IntegrityRegion;
+
+// Parse a partition line of "pflash -i" into its region and flags
+bool parsePartLine(const std::string& line, IntegrityRegion& region,
+                   std::string& flags)
+{
+    // Each line looks like
+    // ID=08 HBB 0x00205000..0x00305000 (actual=0x00100000) [EL--R-----]
+    auto pos = line.find('[');
+    if (pos == std::string::npos)
+    {
+        return false;
+    }
+    flags = line.substr(pos);
+
+    std::istringstream fields(line.substr(0, pos));
+    std::string id, name, range;
+    if (!(fields >> id >> name >> range) || (id.rfind("ID=", 0) != 0))
+    {
+        return false;
+    }
+
+    pos = range.find("..");
+    if (pos == std::string::npos)
+    {
+        return false;
+    }
+    try
+    {
+        auto start = std::stoull(range.substr(0, pos), nullptr, 16);
+        auto end = std::stoull(range.substr(pos + 2), nullptr, 16);
+        if (end <= start)
+        {
+            return false;
+        }
+        region = {name, start, end - start, {}};
+        return true;
+    }
+    catch (const std::exception& e)
+    {
+        return false;
+    }
+}
+
+std::vector<IntegrityRegion> getPartRegions(const std::string& info)
+{
+    std::vector<IntegrityRegion> ret;
+    std::istringstream iss(info);
+    std::string line;
+    IntegrityRegion region;
+    std::string flags;
+
+    while (std::getline(iss, line))
+    {
+        if (parsePartLine(line, region, flags))
+        {
+            ret.push_back(region);
+        }
+    }
+    return ret;
+}
+
+std::vector<IntegrityRegion> getReadOnlyParts(const std::string& info)
+{
+    std::vector<IntegrityRegion> ret;
+    std::istringstream iss(info);
+    std::string line;
+    IntegrityRegion region;
+    std::string flags;
+
+    while (std::getline(iss, line))
+    {
+        // Flag 'R' means READONLY
+        // Flag 'B' means BACKUP, the TOC of the other side
+        // Flag 'F' means REPROVISION, cleared by a factory reset
+        if (!parsePartLine(line, region, flags) ||
+            (flags.find('R') == std::string::npos) ||
+            (flags.find('B') != std::string::npos) ||
+            (flags.find('F') != std::string::npos))
+        {
+            continue;
+        }
+        ret.push_back(region);
+    }
+    return ret;
+}
+
+// Get the regions of the partitions with the given names
+std::vector<IntegrityRegion>
+    findPartRegions(const std::vector<std::string>& names)
+{
+    std::vector<IntegrityRegion> ret;
+    const auto& [rc, pflashInfo] = pflash("-i | grep ^ID");
+    for (auto& region : getPartRegions(pflashInfo))
+    {
+        if (std::find(names.begin(), names.end(), region.name) != names.end())
+        {
+            ret.push_back(region);
+        }
+    }
+    return ret;
+}
+
+// Get the mtd device of a flash partition
+fs::path getMtdDevice(const std::string& name)
+{
+    // Each line looks like
+    // mtd6: 04000000 00010000 "pnor"
+    std::ifstream mtdFile("/proc/mtd");
+    std::string line;
+    while (std::getline(mtdFile, line))
+    {
+        auto pos = line.find(':');
+        if ((pos != std::string::npos) &&
+            (line.find("\"" + name + "\"") != std::string::npos))
+        {
+            return fs::path("/dev") / line.substr(0, pos);
+        }
+    }
+    return {};
+}
+
+// Get the mtd device of the PNOR flash
+fs::path getPNORDevice()
+{
+    return getMtdDevice("pnor");
+}
+
+// Get the digest of the FFS TOC of the PNOR flash: the header and the
+// partition entries, along with their checksums
+std::string getTOCDigest()
+{
+    constexpr uint32_t ffsMagic = 0x50415254; // "PART"
+
+    auto device = getPNORDevice();
+    if (device.empty())
+    {
+        return {};
+    }
+
+    // magic, version, size, entry_size, entry_count, block_size,
+    // block_count, resvd[4] and checksum, all big endian
+    std::array<uint32_t, 12> header{};
+    std::ifstream f(device, std::ios::in | std::ios::binary);
+    if (!f.read(reinterpret_cast<char*>(header.data()), sizeof(header)) ||
+        (be32toh(header[0]) != ffsMagic))
+    {
+        return {};
+    }
+
+    uint64_t tocSize = uint64_t{be32toh(header[2])} * be32toh(header[5]);
+    uint64_t length =
+        sizeof(header) + uint64_t{be32toh(header[3])} * be32toh(header[4]);
+    if (length > tocSize)
+    {
+        return {};
+    }
+    return openpower::software::updater::digestRange(device, 0, length);
+}
+
 } // namespace utils
 
 namespace openpower
@@ -234,6 +406,14 @@ bool ItemUpdaterStatic::validateImage(const std::string&)
 
 void ItemUpdaterStatic::processPNORImage()
 {
+    // The updater drops the snapshot before writing the flash, so an
+    // unchanged TOC means an unchanged VERSION partition.
+    auto fingerprint = utils::getTOCDigest();
+    if (restoreDiscovered(fingerprint))
+    {
+        return;
+    }
+
     auto fullVersion = utils::getPNORVersion();
 
     const auto& [version, extendedVersion] = Version::getVersions(fullVersion);
@@ -260,65 +440,119 @@ void ItemUpdaterStatic::processPNORImage()
         activationState = server::Activation::Activations::Invalid;
     }
 
-    auto purpose = server::Version::VersionPurpose::Host;
-    auto path = fs::path(SOFTWARE_OBJPATH) / id;
-    AssociationList associations = {};
+    // For now only one PNOR is supported with static layout. The D-Bus
+    // objects are created by publishPNORImages().
+    discovered.push_back({id, version, extendedVersion, activationState, 0});
+    discoveredFunctionalId = id;
+    storeDiscovered(fingerprint);
+}
 
-    if (activationState == server::Activation::Activations::Active)
+void ItemUpdaterStatic::reset()
+{
+    if (resetting)
     {
-        // Create an association to the host inventory item
-        associations.emplace_back(std::make_tuple(ACTIVATION_FWD_ASSOCIATION,
-                                                  ACTIVATION_REV_ASSOCIATION,
-                                                  HOST_INVENTORY_PATH));
-
-        // Create an active association since this image is active
-        createActiveAssociation(path);
+        log<level::INFO>("Factory reset already in progress");
+        return;
     }
+    resetting = true;
+    utils::rebootGuard(bus, true);
+    utils::hiomapdSuspend(bus);
 
-    // All updateable firmware components must expose the updateable
-    // association.
-    createUpdateableAssociation(path);
-
-    // Create Activation instance for this version.
-    activations.insert(std::make_pair(
-        id, std::make_unique<ActivationStatic>(bus, path, *this, id,
-                                               extendedVersion, activationState,
-                                               associations)));
+    // pflash runs on a worker thread, hiomapd is resumed once it is done.
+    auto history = std::make_shared<HistoryEntry>("FactoryReset", "");
+    auto cleared = std::make_shared<std::vector<IntegrityRegion>>();
+    executor.post(
+        [cleared](std::stop_token) {
+            auto partitions = utils::getPartsToClear();
+            std::vector<std::string> names;
+            for (auto p : partitions)
+            {
+                utils::pnorClear(p.first, p.second);
+                names.push_back(p.first);
+            }
+            *cleared = utils::findPartRegions(names);
+        },
+        [this, history, cleared]() {
+            for (const auto& region : *cleared)
+            {
+                recordFlashWrite(region.offset, region.length);
+                history->addWritten(region.length);
+            }
+            flushFlashWrites();
+            utils::hiomapdResume(bus);
+            utils::rebootGuard(bus, false);
+            resetting = false;
+            history->finish(true);
+        });
+}
 
-    // If Active, create RedundancyPriority instance for this version.
-    if (activationState == server::Activation::Activations::Active)
+std::vector<ScrubTarget> ItemUpdaterStatic::scrubTargets()
+{
+    std::vector<ScrubTarget> targets;
+    IntegrityRecord record;
+    if (functionalVersionId.empty() ||
+        !restoreIntegrity(functionalVersionId, record))
     {
-        // For now only one PNOR is supported with static layout
-        activations.find(id)->second->redundancyPriority =
-            std::make_unique<RedundancyPriority>(
-                bus, path, *(activations.find(id)->second), 0);
+        return targets;
     }
 
-    // Create Version instance for this version.
-    auto versionPtr = std::make_unique<Version>(
-        bus, path, *this, id, version, purpose, "",
-        std::bind(&ItemUpdaterStatic::erase, this, std::placeholders::_1));
-    versionPtr->deleteObject = std::make_unique<Delete>(bus, path, *versionPtr);
-    versions.insert(std::make_pair(id, std::move(versionPtr)));
+    auto device = utils::getPNORDevice();
+    if (device.empty())
+    {
+        log<level::ERR>("Unable to find the PNOR flash device");
+        return targets;
+    }
 
-    if (!id.empty())
+    for (const auto& region : record.regions)
     {
-        updateFunctionalAssociation(id);
+        targets.push_back({functionalVersionId, device, region});
     }
+    return targets;
 }
 
-void ItemUpdaterStatic::reset()
+fs::path ItemUpdaterStatic::imageFile(const fs::path& imageDir) const
 {
-    auto partitions = utils::getPartsToClear();
-
-    utils::hiomapdSuspend(bus);
+    std::error_code ec;
+    for (const auto& entry : fs::directory_iterator(imageDir, ec))
+    {
+        if (entry.path().extension() == ".pnor")
+        {
+            return entry.path();
+        }
+    }
+    return {};
+}
 
-    for (auto p : partitions)
+std::optional<IntegrityRecord>
+    ItemUpdaterStatic::digestImage(const fs::path& image, const std::string&,
+                                   std::stop_token token) const
+{
+    const auto& [rc, pflashInfo] =
+        utils::pflash("-F", image.string(), "-i | grep ^ID");
+    if (rc != 0)
     {
-        utils::pnorClear(p.first, p.second);
+        log<level::ERR>("Failed to read the image partitions",
+                        entry("RETURNCODE=%d", rc));
+        return std::nullopt;
     }
 
-    utils::hiomapdResume(bus);
+    IntegrityRecord record;
+    for (auto& region : utils::getReadOnlyParts(pflashInfo))
+    {
+        if (token.stop_requested())
+        {
+            return std::nullopt;
+        }
+        region.digest = digestRange(image, region.offset, region.length);
+        if (region.digest.empty())
+        {
+            log<level::ERR>("Unable to digest the partition",
+                            entry("PART=%s", region.name.c_str()));
+            return std::nullopt;
+        }
+        record.regions.push_back(std::move(region));
+    }
+    return record;
 }
 
 bool ItemUpdaterStatic::isVersionFunctional(const std::string& versionId)
@@ -360,12 +594,179 @@ void ItemUpdaterStatic::updateFunctionalAssociation(
 
 void GardResetStatic::reset()
 {
+    if (parent.resetInProgress())
+    {
+        log<level::ERR>("Factory reset in progress, GARD reset rejected");
+        return;
+    }
+
+    HistoryEntry history("GardReset", "");
+
     // Clear gard partition
     utils::hiomapdSuspend(bus);
 
     utils::pnorClear("GUARD");
+    for (const auto& region : utils::findPartRegions({"GUARD"}))
+    {
+        recordFlashWrite(region.offset, region.length);
+        history.addWritten(region.length);
+    }
+    flushFlashWrites();
 
     utils::hiomapdResume(bus);
+    history.finish(true);
+}
+
+std::vector<DeviceImage> readDeviceMap(const fs::path& imageDir)
+{
+    std::vector<DeviceImage> images;
+    std::ifstream mapFile(PNOR_DEVICE_MAP);
+    if (!mapFile)
+    {
+        return images;
+    }
+
+    std::stringstream content;
+    content << mapFile.rdbuf();
+    for (const auto& [image, device] : parseDeviceMap(content.str()))
+    {
+        // A device is named by its MTD partition, or by its path
+        fs::path path(device);
+        if (!path.is_absolute())
+        {
+            path = utils::getMtdDevice(device);
+        }
+        if (path.empty())
+        {
+            log<level::ERR>("Unable to find the flash device",
+                            entry("DEVICE=%s", device.c_str()));
+        }
+        images.push_back({path, imageDir / image});
+    }
+    return images;
+}
+
+ProgressReporter::ProgressReporter(const fs::path& imageDir,
+                                   const std::atomic<uint64_t>& done) :
+    file(imageDir / programProgressFile),
+    thread([this, &done](std::stop_token token) {
+        std::mutex mutex;
+        std::condition_variable_any wake;
+        std::unique_lock lock(mutex);
+        while (!token.stop_requested())
+        {
+            publish(done);
+            wake.wait_for(lock, token, std::chrono::seconds(1),
+                          [] { return false; });
+        }
+    })
+{}
+
+ProgressReporter::~ProgressReporter()
+{
+    thread.request_stop();
+    thread.join();
+    std::error_code ec;
+    fs::remove(file, ec);
+}
+
+void ProgressReporter::publish(uint64_t bytes) const
+{
+    auto tmp = file;
+    tmp += ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::trunc);
+        out << bytes << std::endl;
+        if (!out)
+        {
+            return;
+        }
+    }
+    std::error_code ec;
+    fs::rename(tmp, file, ec);
+}
+
+std::optional<uint64_t> readProgramProgress(const fs::path& imageDir)
+{
+    std::ifstream in(imageDir / programProgressFile);
+    uint64_t bytes{};
+    if (!(in >> bytes))
+    {
+        return std::nullopt;
+    }
+    return bytes;
+}
+
+bool writePnorImage(const fs::path& image)
+{
+    if (fs::is_directory(image))
+    {
+        return writePnorImages(image);
+    }
+
+    auto device = utils::getPNORDevice();
+    if (device.empty())
+    {
+        log<level::ERR>("Unable to find the PNOR flash device");
+        return false;
+    }
+
+    ProgramStats stats;
+    std::atomic<uint64_t> done = 0;
+    ProgressReporter reporter(image.parent_path(), done);
+    if (!programImage(device, image, stats, &done))
+    {
+        log<level::ERR>("Failed to program the PNOR image",
+                        entry("IMAGE=%s", image.c_str()));
+        return false;
+    }
+    log<level::INFO>("Programmed the PNOR image",
+                     entry("IMAGE=%s", image.c_str()),
+                     entry("WRITTEN=%llu",
+                           static_cast<unsigned long long>(stats.written)),
+                     entry("SKIPPED=%llu",
+                           static_cast<unsigned long long>(stats.skipped)));
+    return true;
+}
+
+bool writePnorImages(const fs::path& imageDir)
+{
+    auto images = readDeviceMap(imageDir);
+    if (images.empty())
+    {
+        log<level::ERR>("No flash device map for the PNOR images",
+                        entry("MAP=%s", PNOR_DEVICE_MAP));
+        return false;
+    }
+
+    std::atomic<uint64_t> done = 0;
+    std::vector<DeviceResult> results;
+    {
+        ProgressReporter reporter(imageDir, done);
+        results = programDevices(images, done);
+    }
+    bool programmed = true;
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const auto& result = results[i];
+        if (!result.programmed)
+        {
+            log<level::ERR>("Failed to program the PNOR image",
+                            entry("IMAGE=%s", images[i].image.c_str()),
+                            entry("DEVICE=%s", result.device.c_str()));
+            programmed = false;
+            continue;
+        }
+        log<level::INFO>(
+            "Programmed the PNOR image",
+            entry("IMAGE=%s", images[i].image.c_str()),
+            entry("DEVICE=%s", result.device.c_str()),
+            entry("WRITTEN=%llu",
+                  static_cast<unsigned long long>(result.stats.written)),
+            entry("SKIPPED=%llu",
+                  static_cast<unsigned long long>(result.stats.skipped)));
+    }
+    return programmed;
 }
 
 } // namespace updater
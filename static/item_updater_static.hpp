@@ -1,8 +1,15 @@
 #pragma once
 
+#include "flash_device.hpp"
 #include "item_updater.hpp"
 
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
 #include <string>
+#include <thread>
+#include <vector>
 
 namespace openpower
 {
@@ -34,7 +41,7 @@ class ItemUpdaterStatic : public ItemUpdater
         ItemUpdater(bus, path)
     {
         processPNORImage();
-        gardReset = std::make_unique<GardResetStatic>(bus, GARD_PATH);
+        gardReset = std::make_unique<GardResetStatic>(bus, GARD_PATH, *this);
         volatileEnable = std::make_unique<ObjectEnable>(bus, volatilePath);
 
         // Emit deferred signal.
@@ -54,7 +61,20 @@ class ItemUpdaterStatic : public ItemUpdater
 
     bool isVersionFunctional(const std::string& versionId) override;
 
+    std::vector<ScrubTarget> scrubTargets() override;
+
   private:
+    /** @brief The PNOR file of an upload */
+    std::filesystem::path
+        imageFile(const std::filesystem::path& imageDir) const override;
+
+    /** @brief Compute the digests of the read-only partitions of a PNOR
+     *  file, the others being written by the host */
+    std::optional<IntegrityRecord>
+        digestImage(const std::filesystem::path& image,
+                    const std::string& name,
+                    std::stop_token token) const override;
+
     /** @brief Create Activation object */
     std::unique_ptr<Activation> createActivationObject(
         const std::string& path, const std::string& versionId,
@@ -83,6 +103,86 @@ class ItemUpdaterStatic : public ItemUpdater
     std::string functionalVersionId;
 };
 
+/** @brief Erase the PNOR flash and program an image to it, skipping the
+ *  pages of the image that are all 0xFF.
+ *
+ *  @param[in] image - The PNOR image file, or the directory of the images
+ *                     of a system with a flash device map
+ *
+ *  @return true if the image is programmed
+ */
+bool writePnorImage(const std::filesystem::path& image);
+
+/** @brief The file of an image directory holding the bytes programmed so
+ *  far, written by the update service while it programs the flash */
+constexpr auto programProgressFile = "program.progress";
+
+/** @class ProgressReporter
+ *  @brief Publishes the bytes programmed so far to the progress file of the
+ *  image directory once a second, for the updater to poll, until destroyed
+ */
+class ProgressReporter
+{
+  public:
+    ProgressReporter() = delete;
+    ProgressReporter(const ProgressReporter&) = delete;
+    ProgressReporter& operator=(const ProgressReporter&) = delete;
+    ProgressReporter(ProgressReporter&&) = delete;
+    ProgressReporter& operator=(ProgressReporter&&) = delete;
+
+    /** @brief Starts publishing
+     *
+     *  @param[in] imageDir - The directory of the images
+     *  @param[in] done     - The bytes programmed so far, outlives the
+     *                        reporter
+     */
+    ProgressReporter(const std::filesystem::path& imageDir,
+                     const std::atomic<uint64_t>& done);
+
+    /** @brief Stops publishing and removes the progress file */
+    ~ProgressReporter();
+
+  private:
+    /** @brief Replace the progress file, so that a reader never sees it
+     *  partly written */
+    void publish(uint64_t bytes) const;
+
+    /** @brief The progress file */
+    std::filesystem::path file;
+
+    /** @brief The thread publishing the progress */
+    std::jthread thread;
+};
+
+/** @brief Read the bytes programmed so far from an image directory
+ *
+ *  @param[in] imageDir - The directory of the images
+ *
+ *  @return The bytes programmed, none if the update service has not
+ *          published any
+ */
+std::optional<uint64_t> readProgramProgress(
+    const std::filesystem::path& imageDir);
+
+/** @brief Read the flash device map of the system, which names the image
+ *  programmed to each of its host flash devices
+ *
+ *  @param[in] imageDir - The directory of the images
+ *
+ *  @return The images and their devices, empty if the system has a single
+ *          PNOR flash device
+ */
+std::vector<DeviceImage> readDeviceMap(const std::filesystem::path& imageDir);
+
+/** @brief Program the images of a device map to their flash devices, the
+ *  devices concurrently.
+ *
+ *  @param[in] imageDir - The directory of the images
+ *
+ *  @return true if every image is programmed
+ */
+bool writePnorImages(const std::filesystem::path& imageDir);
+
 } // namespace updater
 } // namespace software
 } // namespace openpower
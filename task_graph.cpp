@@ -0,0 +1,97 @@
+#include "task_graph.hpp"
+
+#include <phosphor-logging/log.hpp>
+
+#include <exception>
+
+namespace openpower
+{
+namespace software
+{
+namespace updater
+{
+
+using namespace phosphor::logging;
+
+size_t TaskGraph::add(const std::string& name, Step step,
+                      const std::vector<size_t>& after)
+{
+    auto index = nodes.size();
+    nodes.push_back({name, std::move(step), {}, after.size(), {name, {}}});
+    for (auto dependency : after)
+    {
+        nodes.at(dependency).dependents.push_back(index);
+    }
+    return index;
+}
+
+void TaskGraph::run(Executor& executor, Completion done)
+{
+    this->executor = &executor;
+    this->done = std::move(done);
+    remaining = nodes.size();
+    if (remaining == 0)
+    {
+        this->done({});
+        return;
+    }
+
+    for (size_t index = 0; index < nodes.size(); index++)
+    {
+        if (nodes[index].waiting == 0)
+        {
+            start(index);
+        }
+    }
+}
+
+void TaskGraph::start(size_t index)
+{
+    auto self = shared_from_this();
+    executor->post(
+        [self, index](std::stop_token) {
+            auto& node = self->nodes[index];
+            auto begin = std::chrono::steady_clock::now();
+            try
+            {
+                node.step();
+            }
+            catch (const std::exception& e)
+            {
+                log<level::ERR>("Step failed",
+                                entry("STEP=%s", node.name.c_str()),
+                                entry("ERROR=%s", e.what()));
+                node.timing.failed = true;
+            }
+            node.timing.duration =
+                std::chrono::duration_cast<std::chrono::milliseconds>(
+                    std::chrono::steady_clock::now() - begin);
+        },
+        [self, index]() { self->finished(index); });
+}
+
+void TaskGraph::finished(size_t index)
+{
+    for (auto dependent : nodes[index].dependents)
+    {
+        if (--nodes[dependent].waiting == 0)
+        {
+            start(dependent);
+        }
+    }
+
+    if (--remaining == 0)
+    {
+        std::vector<StepTiming> timings;
+        for (const auto& node : nodes)
+        {
+            timings.push_back(node.timing);
+        }
+        auto complete = std::move(done);
+        complete(timings);
+    }
+}
+
+} // namespace updater
+} // namespace software
+} // namespace openpower
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "executor.hpp"
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace openpower
+{
+namespace software
+{
+namespace updater
+{
+
+/** @struct StepTiming
+ *  @brief How long a step of a TaskGraph ran.
+ */
+struct StepTiming
+{
+    /** @brief The step name */
+    std::string name;
+
+    /** @brief The time the step ran for */
+    std::chrono::milliseconds duration;
+
+    /** @brief Whether the step threw */
+    bool failed = false;
+};
+
+/** @class TaskGraph
+ *  @brief A set of steps run on an Executor, each step starting as soon as
+ *  the steps it depends on are complete, so that independent steps run
+ *  concurrently.
+ *  @details The steps run on the worker threads, so a step making D-Bus
+ *  calls must use its own bus connection. A step that throws is logged and
+ *  counted as complete.
+ */
+class TaskGraph : public std::enable_shared_from_this<TaskGraph>
+{
+  public:
+    /** @brief A step of the graph */
+    using Step = std::function<void()>;
+
+    /** @brief Called on the event loop once all the steps are complete */
+    using Completion = std::function<void(const std::vector<StepTiming>&)>;
+
+    /** @brief Add a step to the graph
+     *
+     * @param[in] name  - The step name, for the timings
+     * @param[in] step  - The step
+     * @param[in] after - The steps to complete before this one
+     *
+     * @return The step index, for later steps to depend on
+     */
+    size_t add(const std::string& name, Step step,
+               const std::vector<size_t>& after = {});
+
+    /** @brief Run the steps. The graph must be owned by a shared_ptr, which
+     *  is kept until the completion is called.
+     *
+     * @param[in] executor - The executor to run the steps on
+     * @param[in] done     - Called with the timings of all the steps
+     */
+    void run(Executor& executor, Completion done);
+
+  private:
+    /** @brief A step and the steps waiting for it */
+    struct Node
+    {
+        std::string name;
+        Step step;
+        std::vector<size_t> dependents;
+        size_t waiting = 0;
+        StepTiming timing;
+    };
+
+    /** @brief Post a step whose dependencies are complete */
+    void start(size_t index);
+
+    /** @brief Account for a complete step, starting its dependents */
+    void finished(size_t index);
+
+    /** @brief The steps */
+    std::vector<Node> nodes;
+
+    /** @brief The executor the steps run on */
+    Executor* executor = nullptr;
+
+    /** @brief The completion of the run */
+    Completion done;
+
+    /** @brief The number of steps not complete yet */
+    size_t remaining = 0;
+};
+
+} // namespace updater
+} // namespace software
+} // namespace openpower
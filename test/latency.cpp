@@ -0,0 +1,831 @@
+#include "config.h"
+
+#include "paths.hpp"
+#include "stand_in.hpp"
+
+#include <signal.h>
+#include <spawn.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <CLI/CLI.hpp>
+#include <nlohmann/json.hpp>
+#include <sdbusplus/bus.hpp>
+#include <sdbusplus/message.hpp>
+#include <sdeventplus/event.hpp>
+#include <sdeventplus/source/io.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stop_token>
+#include <string>
+#include <thread>
+#include <variant>
+#include <vector>
+
+extern char** environ;
+
+using namespace openpower::software::updater::test;
+namespace paths = openpower::software::updater::paths;
+using json = nlohmann::json;
+namespace fs = std::filesystem;
+using namespace std::chrono_literals;
+
+namespace
+{
+
+/** @brief The exit status meson reports as a skipped test */
+constexpr int skipped = 77;
+
+/** @brief Longer than the 25 s default of sd-bus, so that a call stuck on
+ *  a dropped reply shows as such rather than as a timeout of its own */
+constexpr auto callTimeout = 30s;
+
+/** @brief The time the updater has to claim its bus name */
+constexpr auto startTimeout = 30s;
+
+/** @brief The time an activation, reset or subcommand has to finish */
+constexpr auto actionTimeout = 120s;
+
+constexpr auto versionId = "1a7e4c79";
+constexpr auto activationIntf = "xyz.openbmc_project.Software.Activation";
+constexpr auto objectManagerIntf = "org.freedesktop.DBus.ObjectManager";
+constexpr auto propertiesIntf = "org.freedesktop.DBus.Properties";
+constexpr auto versionService = "xyz.openbmc_project.Software.Version";
+constexpr auto hostStatePath = "/xyz/openbmc_project/state/host0";
+constexpr auto hostStateIntf = "xyz.openbmc_project.State.Host";
+
+using Milliseconds = std::chrono::duration<double, std::milli>;
+
+/** @brief The objects the mapper stand-in knows: their services, and the
+ *  interfaces of each service */
+using Objects =
+    std::map<std::string, std::map<std::string, std::vector<std::string>>>;
+
+/** @struct Options
+ *  @brief What the harness runs, and against which faults.
+ */
+struct Options
+{
+    /** @brief The updater executable */
+    std::string updater;
+
+    /** @brief The faults of each peer, as peer:spec */
+    std::vector<std::string> faults;
+
+    /** @brief The number of threads reading the properties of the updater */
+    size_t probes = 4;
+
+    /** @brief The pause between the reads of a probe thread, in ms */
+    unsigned interval = 20;
+
+    /** @brief The time a systemd job takes, in ms */
+    unsigned jobTime = 200;
+
+    /** @brief The time the probes keep running after an action, in ms */
+    unsigned settle = 2000;
+
+    /** @brief The p99 latency above which the run fails, in ms, 0 to only
+     *  report */
+    double maxP99 = 0;
+
+    /** @brief The seed of the fault draws */
+    uint32_t seed = 1;
+};
+
+/** @brief Call a method, with the timeout of the harness
+ *
+ *  @param[in]  bus   - The connection
+ *  @param[in]  m     - The method call
+ *  @param[out] reply - If set, the reply
+ *
+ *  @return The error name, empty if the call succeeded
+ */
+std::string call(sdbusplus::bus::bus& bus, sdbusplus::message::message& m,
+                 sdbusplus::message::message* reply = nullptr)
+{
+    sd_bus_error error = SD_BUS_ERROR_NULL;
+    sd_bus_message* r = nullptr;
+    auto rc = sd_bus_call(
+        bus.get(), m.get(),
+        std::chrono::duration_cast<std::chrono::microseconds>(callTimeout)
+            .count(),
+        &error, &r);
+    std::string name;
+    if (rc < 0)
+    {
+        name = error.name ? error.name : "unknown";
+    }
+    sd_bus_error_free(&error);
+    if (r && reply)
+    {
+        *reply = sdbusplus::message::message(r, std::false_type());
+    }
+    else if (r)
+    {
+        sd_bus_message_unref(r);
+    }
+    return name;
+}
+
+/** @brief Summarise latencies
+ *
+ *  @param[in] samples - The latencies in ms
+ *
+ *  @return The count, p50, p99 and max
+ */
+json summarize(std::vector<double> samples)
+{
+    json summary = {{"samples", samples.size()}};
+    if (samples.empty())
+    {
+        return summary;
+    }
+    std::sort(samples.begin(), samples.end());
+    auto rank = [&samples](double q) {
+        auto index = static_cast<size_t>(
+            std::ceil(q * static_cast<double>(samples.size())));
+        return samples[std::max<size_t>(index, 1) - 1];
+    };
+    summary["p50_ms"] = rank(0.50);
+    summary["p99_ms"] = rank(0.99);
+    summary["max_ms"] = samples.back();
+    return summary;
+}
+
+/** @class Probe
+ *  @brief Reads all the properties of the updater from several threads,
+ *  each on its own connection, and keeps the latency of every read.
+ */
+class Probe
+{
+  public:
+    Probe(size_t threads, std::chrono::milliseconds interval) :
+        interval(interval)
+    {
+        for (size_t i = 0; i < threads; i++)
+        {
+            workers.emplace_back([this](std::stop_token token) { run(token); });
+        }
+    }
+
+    /** @brief Stop the reads
+     *
+     *  @return The summary of the latencies, and the reads that failed
+     */
+    json stop()
+    {
+        for (auto& worker : workers)
+        {
+            worker.request_stop();
+        }
+        workers.clear();
+        auto summary = summarize(latencies);
+        summary["failed"] = failures;
+        return summary;
+    }
+
+  private:
+    void run(std::stop_token token)
+    {
+        auto bus = sdbusplus::bus::new_system();
+        while (!token.stop_requested())
+        {
+            auto m = bus.new_method_call(BUSNAME_UPDATER, SOFTWARE_OBJPATH,
+                                         objectManagerIntf,
+                                         "GetManagedObjects");
+            auto start = std::chrono::steady_clock::now();
+            auto error = call(bus, m);
+            auto elapsed = Milliseconds(std::chrono::steady_clock::now() -
+                                        start);
+            {
+                std::lock_guard lock(mutex);
+                latencies.push_back(elapsed.count());
+                failures += error.empty() ? 0 : 1;
+            }
+            std::this_thread::sleep_for(interval);
+        }
+    }
+
+    std::chrono::milliseconds interval;
+    std::mutex mutex;
+    std::vector<double> latencies;
+    uint64_t failures = 0;
+    std::vector<std::jthread> workers;
+};
+
+/** @brief Start a process, with the environment of the harness
+ *
+ *  @param[in] args - The executable and its arguments
+ *
+ *  @return The process id, or -1
+ */
+pid_t spawn(const std::vector<std::string>& args)
+{
+    std::vector<char*> argv;
+    for (const auto& arg : args)
+    {
+        argv.push_back(const_cast<char*>(arg.c_str()));
+    }
+    argv.push_back(nullptr);
+    pid_t pid = -1;
+    if (posix_spawn(&pid, argv[0], nullptr, nullptr, argv.data(), environ) !=
+        0)
+    {
+        return -1;
+    }
+    return pid;
+}
+
+/** @brief Wait for a process to exit, killing it past the action timeout
+ *
+ *  @param[in] pid - The process
+ *
+ *  @return The exit status, or -1 if it was killed
+ */
+int waitExit(pid_t pid)
+{
+    auto deadline = std::chrono::steady_clock::now() + actionTimeout;
+    int status = 0;
+    while (waitpid(pid, &status, WNOHANG) == 0)
+    {
+        if (std::chrono::steady_clock::now() > deadline)
+        {
+            kill(pid, SIGKILL);
+            waitpid(pid, &status, 0);
+            return -1;
+        }
+        std::this_thread::sleep_for(50ms);
+    }
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+/** @brief Wait for the updater to claim its bus name
+ *
+ *  @param[in] bus - The connection
+ *  @param[in] pid - The updater process, which may exit instead
+ *
+ *  @return true once the name is claimed
+ */
+bool waitForUpdater(sdbusplus::bus::bus& bus, pid_t pid)
+{
+    auto deadline = std::chrono::steady_clock::now() + startTimeout;
+    while (std::chrono::steady_clock::now() < deadline)
+    {
+        auto m = bus.new_method_call("org.freedesktop.DBus",
+                                     "/org/freedesktop/DBus",
+                                     "org.freedesktop.DBus", "NameHasOwner");
+        m.append(BUSNAME_UPDATER);
+        sdbusplus::message::message reply;
+        bool owned = false;
+        if (call(bus, m, &reply).empty())
+        {
+            reply.read(owned);
+        }
+        if (owned)
+        {
+            return true;
+        }
+        int status = 0;
+        if (waitpid(pid, &status, WNOHANG) != 0)
+        {
+            return false;
+        }
+        std::this_thread::sleep_for(100ms);
+    }
+    return false;
+}
+
+/** @brief Stand in for the object mapper, from a fixed set of objects */
+void serveMapper(StandIn& mapper, const Objects& objects)
+{
+    using Services = std::map<std::string, std::vector<std::string>>;
+    auto matching = [](const Services& services,
+                       const std::vector<std::string>& interfaces) {
+        Services found;
+        for (const auto& [service, serviceInterfaces] : services)
+        {
+            if (interfaces.empty() ||
+                std::any_of(interfaces.begin(), interfaces.end(),
+                            [&serviceInterfaces](const auto& interface) {
+                                return std::find(serviceInterfaces.begin(),
+                                                 serviceInterfaces.end(),
+                                                 interface) !=
+                                       serviceInterfaces.end();
+                            }))
+            {
+                found.emplace(service, serviceInterfaces);
+            }
+        }
+        return found;
+    };
+
+    mapper.method(MAPPER_INTERFACE, "GetObject",
+                  [&objects, matching](auto& call, auto& reply) {
+                      std::string path;
+                      std::vector<std::string> interfaces;
+                      call.read(path, interfaces);
+                      auto object = objects.find(path);
+                      auto found = object == objects.end()
+                                       ? Services{}
+                                       : matching(object->second, interfaces);
+                      if (found.empty())
+                      {
+                          throw std::runtime_error("Object not found: " +
+                                                   path);
+                      }
+                      reply.append(found);
+                  });
+    mapper.method(MAPPER_INTERFACE, "GetSubTree",
+                  [&objects, matching](auto& call, auto& reply) {
+                      std::string root;
+                      int32_t depth = 0;
+                      std::vector<std::string> interfaces;
+                      call.read(root, depth, interfaces);
+                      std::map<std::string, Services> tree;
+                      for (const auto& [path, services] : objects)
+                      {
+                          auto found = matching(services, interfaces);
+                          if ((path.rfind(root, 0) == 0) && !found.empty())
+                          {
+                              tree.emplace(path, std::move(found));
+                          }
+                      }
+                      reply.append(tree);
+                  });
+}
+
+/** @brief Stand in for systemd, whose jobs end after the job time */
+void serveSystemd(StandIn& systemd, std::chrono::milliseconds jobTime)
+{
+    auto nothing = [](auto&, auto&) {};
+    systemd.method(SYSTEMD_INTERFACE, "Subscribe", nothing);
+    systemd.method(SYSTEMD_INTERFACE, "Unsubscribe", nothing);
+
+    auto startJob = [&systemd, jobTime](auto& call, auto& reply) {
+        static uint32_t jobs = 0;
+        std::string unit;
+        std::string mode;
+        call.read(unit, mode);
+        auto id = ++jobs;
+        sdbusplus::message::object_path job(SYSTEMD_PATH "/job/" +
+                                            std::to_string(id));
+        reply.append(job);
+        systemd.later(jobTime, [&systemd, id, job, unit]() {
+            auto signal = systemd.getBus().new_signal(
+                SYSTEMD_PATH, SYSTEMD_INTERFACE, "JobRemoved");
+            signal.append(id, job, unit, std::string("done"));
+            signal.signal_send();
+        });
+    };
+    systemd.method(SYSTEMD_INTERFACE, "StartUnit", startJob);
+    systemd.method(SYSTEMD_INTERFACE, "StopUnit", startJob);
+    systemd.method(SYSTEMD_INTERFACE, "RestartUnit", startJob);
+}
+
+/** @brief Stand in for the services whose properties are set but not
+ *  looked at, and read as strings */
+void serveProperties(StandIn& standIn,
+                     std::map<std::string, std::string> values)
+{
+    standIn.method(propertiesIntf, "Get", [values](auto& call, auto& reply) {
+        std::string interface;
+        std::string property;
+        call.read(interface, property);
+        auto value = values.find(property);
+        reply.append(std::variant<std::string>(
+            value == values.end() ? std::string() : value->second));
+    });
+    standIn.method(propertiesIntf, "Set", [](auto&, auto&) {});
+}
+
+/** @brief Stand in for EntityManager, with an IBM compatible system */
+void serveEntityManager(StandIn& entityManager)
+{
+    entityManager.method(
+        objectManagerIntf, "GetManagedObjects", [](auto&, auto& reply) {
+            using Names = std::variant<std::vector<std::string>>;
+            std::map<sdbusplus::message::object_path,
+                     std::map<std::string, std::map<std::string, Names>>>
+                objects;
+            objects[sdbusplus::message::object_path(
+                "/xyz/openbmc_project/inventory/system/chassis/motherboard")]
+                   ["xyz.openbmc_project.Configuration.IBMCompatibleSystem"]
+                   ["Names"] = std::vector<std::string>{"ibm,rainier-2u"};
+            reply.append(objects);
+        });
+}
+
+/** @brief Stand in for the logging service */
+void serveLogging(StandIn& logging)
+{
+    auto nothing = [](auto&, auto&) {};
+    logging.method("xyz.openbmc_project.Logging.Create", "Create", nothing);
+    logging.method("xyz.openbmc_project.Collection.DeleteAll", "DeleteAll",
+                   nothing);
+    auto commit = [](auto&, auto& reply) { reply.append(uint32_t{1}); };
+    logging.method("xyz.openbmc_project.Logging.Internal.Manager", "Commit",
+                   commit);
+    logging.method("xyz.openbmc_project.Logging.Internal.Manager",
+                   "CommitWithLvl", commit);
+}
+
+/** @class ScratchDirs
+ *  @brief The image, persisted data and host firmware directories of the
+ *  updater, in a temporary directory removed with this object, so that the
+ *  resets and deletes of the scenarios never touch those of the host.
+ */
+class ScratchDirs
+{
+  public:
+    ScratchDirs()
+    {
+        auto base = fs::temp_directory_path() / "latency-XXXXXX";
+        std::string dir = base.string();
+        if (!mkdtemp(dir.data()))
+        {
+            return;
+        }
+        root = dir;
+        fs::create_directories(root / "images");
+        fs::create_directories(root / "persist");
+        fs::create_directories(root / "media" / "hostfw" / "running");
+
+        // The updater and its subcommands inherit the environment, which
+        // a test-paths build reads the directories from
+        setenv("OPENPOWER_UPDATE_IMG_DIR", (root / "images").c_str(), 1);
+        setenv("OPENPOWER_UPDATE_PERSIST_DIR", (root / "persist").c_str(),
+               1);
+        setenv("OPENPOWER_UPDATE_MEDIA_DIR", (root / "media").c_str(), 1);
+    }
+
+    ~ScratchDirs()
+    {
+        if (!root.empty())
+        {
+            std::error_code ec;
+            fs::remove_all(root, ec);
+        }
+    }
+
+    ScratchDirs(const ScratchDirs&) = delete;
+    ScratchDirs& operator=(const ScratchDirs&) = delete;
+
+    /** @brief Whether the directories were created */
+    explicit operator bool() const
+    {
+        return !root.empty();
+    }
+
+  private:
+    fs::path root;
+};
+
+/** @brief Stage an image as the image manager would, and announce it
+ *
+ *  @param[in] bus - The connection
+ *
+ *  @return The directory of the image
+ */
+fs::path stageImage(sdbusplus::bus::bus& bus)
+{
+    fs::path imageDir = fs::path(paths::imgDir()) / versionId;
+    fs::create_directories(imageDir);
+    {
+        std::ofstream manifest(imageDir / MANIFEST_FILE);
+        manifest << "purpose=xyz.openbmc_project.Software.Version."
+                    "VersionPurpose.Host\n"
+                 << "version=latency-test\n"
+                 << "extended_version=latency-test\n";
+    }
+    {
+        // An image of each layout: the static PNOR and the UBI squashfs
+        std::ofstream pnor(imageDir / "latency.pnor", std::ios::binary);
+        std::string erased(1024 * 1024, '\xff');
+        pnor << erased;
+        std::ofstream squashfs(imageDir / "pnor.xz.squashfs",
+                               std::ios::binary);
+        squashfs << erased;
+    }
+
+    std::map<std::string, std::map<std::string, std::variant<std::string>>>
+        interfaces;
+    interfaces[VERSION_IFACE]["Version"] = "latency-test";
+    interfaces[VERSION_IFACE]["Purpose"] =
+        "xyz.openbmc_project.Software.Version.VersionPurpose.Host";
+    interfaces[FILEPATH_IFACE]["Path"] = imageDir.string();
+    auto signal =
+        bus.new_signal(SOFTWARE_OBJPATH, objectManagerIntf, "InterfacesAdded");
+    signal.append(sdbusplus::message::object_path(
+                      std::string(SOFTWARE_OBJPATH) + "/" + versionId),
+                  interfaces);
+    signal.signal_send();
+    return imageDir;
+}
+
+/** @brief Read the activation state of the staged image
+ *
+ *  @param[in] bus - The connection
+ *
+ *  @return The state, empty if the activation is not published
+ */
+std::string activationState(sdbusplus::bus::bus& bus)
+{
+    auto path = std::string(SOFTWARE_OBJPATH) + "/" + versionId;
+    auto m = bus.new_method_call(BUSNAME_UPDATER, path.c_str(),
+                                 propertiesIntf, "Get");
+    m.append(activationIntf, "Activation");
+    sdbusplus::message::message reply;
+    if (!call(bus, m, &reply).empty())
+    {
+        return {};
+    }
+    std::variant<std::string> state;
+    reply.read(state);
+    auto value = std::get<std::string>(state);
+    return value.substr(value.rfind('.') + 1);
+}
+
+/** @brief Activate a staged image, and wait for it to settle */
+json activate(sdbusplus::bus::bus& bus)
+{
+    auto imageDir = stageImage(bus);
+    auto deadline = std::chrono::steady_clock::now() + actionTimeout;
+    auto state = activationState(bus);
+    while (state.empty() && (std::chrono::steady_clock::now() < deadline))
+    {
+        std::this_thread::sleep_for(100ms);
+        state = activationState(bus);
+    }
+
+    if (state == "Ready")
+    {
+        auto path = std::string(SOFTWARE_OBJPATH) + "/" + versionId;
+        auto m = bus.new_method_call(BUSNAME_UPDATER, path.c_str(),
+                                     propertiesIntf, "Set");
+        m.append(activationIntf, "RequestedActivation",
+                 std::variant<std::string>(
+                     "xyz.openbmc_project.Software.Activation."
+                     "RequestedActivations.Active"));
+        call(bus, m);
+        do
+        {
+            std::this_thread::sleep_for(100ms);
+            state = activationState(bus);
+        } while (((state == "Ready") || (state == "Activating")) &&
+                 (std::chrono::steady_clock::now() < deadline));
+    }
+
+    std::error_code ec;
+    fs::remove_all(imageDir, ec);
+    return {{"result", state.empty() ? "NotPublished" : state}};
+}
+
+/** @brief Call a method of the software manager of the updater */
+json callManager(sdbusplus::bus::bus& bus, const char* interface,
+                 const char* member)
+{
+    auto m = bus.new_method_call(BUSNAME_UPDATER, SOFTWARE_OBJPATH, interface,
+                                 member);
+    auto error = call(bus, m);
+    return {{"result", error.empty() ? "done" : error}};
+}
+
+/** @brief Run a subcommand of the updater */
+json runSubcommand(const std::string& updater, const std::string& subcommand)
+{
+    auto pid = spawn({updater, subcommand});
+    if (pid < 0)
+    {
+        return {{"result", "not started"}};
+    }
+    return {{"result", waitExit(pid)}};
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    CLI::App app{"Latency of the updater with slow and failing D-Bus peers"};
+    Options options;
+    app.add_option("--updater", options.updater, "The updater executable")
+        ->required();
+    app.add_option("--fault", options.faults,
+                   "Faults of a peer, e.g. mapper:delay=200,jitter=50,"
+                   "drop=0.01,error=0.05. The peers are mapper, systemd, "
+                   "bios, entity-manager, logging, image-manager, state, "
+                   "and all");
+    app.add_option("--probes", options.probes,
+                   "Threads reading the properties of the updater");
+    app.add_option("--interval", options.interval,
+                   "Pause between the reads of a probe thread in ms");
+    app.add_option("--job-time", options.jobTime,
+                   "Time a systemd job takes in ms");
+    app.add_option("--settle", options.settle,
+                   "Time the probes keep running after an action in ms");
+    app.add_option("--max-p99-ms", options.maxP99,
+                   "Fail when a p99 latency is above this, 0 to only report");
+    app.add_option("--seed", options.seed, "Seed of the fault draws");
+    CLI11_PARSE(app, argc, argv);
+
+    // The updater and the stand-ins share the private bus of the session
+    auto address = getenv("DBUS_SESSION_BUS_ADDRESS");
+    if (!address)
+    {
+        std::cerr << "Skipped: no private bus, run under dbus-run-session\n";
+        return skipped;
+    }
+    setenv("DBUS_SYSTEM_BUS_ADDRESS", address, 1);
+    setenv("DBUS_STARTER_BUS_TYPE", "system", 1);
+
+    ScratchDirs scratch;
+    if (!scratch)
+    {
+        std::cerr << "Skipped: unable to create the scratch directories\n";
+        return skipped;
+    }
+
+    std::map<std::string, Faults> faults;
+    json faultReport = json::object();
+    for (const auto& spec : options.faults)
+    {
+        auto colon = spec.find(':');
+        if (colon == std::string::npos)
+        {
+            std::cerr << "Bad fault: " << spec << "\n";
+            return 1;
+        }
+        faults[spec.substr(0, colon)] = parseFaults(spec.substr(colon + 1));
+        faultReport[spec.substr(0, colon)] = spec.substr(colon + 1);
+    }
+    auto faultsOf = [&faults](const std::string& peer) {
+        auto found = faults.find(peer);
+        if (found == faults.end())
+        {
+            found = faults.find("all");
+        }
+        return found == faults.end() ? Faults{} : found->second;
+    };
+
+    auto event = sdeventplus::Event::get_new();
+    std::map<std::string, std::unique_ptr<StandIn>> peers;
+    auto addPeer = [&](const std::string& peer, const std::string& busName) {
+        auto seed = options.seed + static_cast<uint32_t>(peers.size());
+        return peers
+            .emplace(busName, std::make_unique<StandIn>(event, busName,
+                                                        faultsOf(peer), seed))
+            .first->second.get();
+    };
+
+    Objects objects;
+    objects["/xyz/openbmc_project/bios_config/manager"]
+           ["xyz.openbmc_project.BIOSConfigManager"] = {
+               "xyz.openbmc_project.BIOSConfig.Manager"};
+    objects["/xyz/openbmc_project/logging"]["xyz.openbmc_project.Logging"] = {
+        "xyz.openbmc_project.Collection.DeleteAll",
+        "xyz.openbmc_project.Logging.Create"};
+    objects["/xyz/openbmc_project/logging/internal/manager"]
+           ["xyz.openbmc_project.Logging"] = {
+               "xyz.openbmc_project.Logging.Internal.Manager"};
+    objects[CHASSIS_STATE_PATH]["xyz.openbmc_project.State.Chassis"] = {
+        CHASSIS_STATE_OBJ};
+    objects[hostStatePath]["xyz.openbmc_project.State.Host"] = {
+        hostStateIntf};
+    objects[std::string(SOFTWARE_OBJPATH) + "/" + versionId][versionService] =
+        {"xyz.openbmc_project.Object.Delete"};
+
+    serveMapper(*addPeer("mapper", MAPPER_BUSNAME), objects);
+    serveSystemd(*addPeer("systemd", SYSTEMD_BUSNAME),
+                 std::chrono::milliseconds(options.jobTime));
+    serveProperties(*addPeer("bios", "xyz.openbmc_project.BIOSConfigManager"),
+                    {});
+    serveEntityManager(
+        *addPeer("entity-manager", "xyz.openbmc_project.EntityManager"));
+    serveLogging(*addPeer("logging", "xyz.openbmc_project.Logging"));
+    addPeer("image-manager", versionService)
+        ->method("xyz.openbmc_project.Object.Delete", "Delete",
+                 [](auto&, auto&) {});
+    serveProperties(*addPeer("state", "xyz.openbmc_project.State.Chassis"),
+                    {{"CurrentPowerState", CHASSIS_STATE_OFF}});
+    serveProperties(
+        *addPeer("state", "xyz.openbmc_project.State.Host"),
+        {{"CurrentHostState", "xyz.openbmc_project.State.Host.HostState.Off"}});
+
+    // The event loop of the stand-ins is stopped through an eventfd, the
+    // only way to reach it from another thread
+    int stopFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    sdeventplus::source::IO stop(
+        event, stopFd, EPOLLIN, [&event](auto&, auto, auto) { event.exit(0); });
+    std::thread loop([&event]() { event.loop(); });
+    auto stopPeers = [&loop, stopFd]() {
+        uint64_t one = 1;
+        if (write(stopFd, &one, sizeof(one)) == sizeof(one))
+        {
+            loop.join();
+        }
+        else
+        {
+            loop.detach();
+        }
+        close(stopFd);
+    };
+
+    auto bus = sdbusplus::bus::new_system();
+    auto updater = spawn({options.updater});
+    if ((updater < 0) || !waitForUpdater(bus, updater))
+    {
+        std::cerr << "Skipped: the updater did not claim its bus name\n";
+        if (updater > 0)
+        {
+            kill(updater, SIGKILL);
+            waitpid(updater, nullptr, 0);
+        }
+        stopPeers();
+        return skipped;
+    }
+
+    auto settle = std::chrono::milliseconds(options.settle);
+    std::vector<std::pair<std::string, std::function<json()>>> scenarios = {
+        {"idle",
+         [settle]() {
+             std::this_thread::sleep_for(settle);
+             return json::object();
+         }},
+        {"activation", [&bus]() { return activate(bus); }},
+        {"process-host-firmware",
+         [&options]() {
+             return runSubcommand(options.updater, "process-host-firmware");
+         }},
+        {"update-bios-attr-table",
+         [&options]() {
+             return runSubcommand(options.updater, "update-bios-attr-table");
+         }},
+        {"reset",
+         [&bus]() {
+             return callManager(bus, "xyz.openbmc_project.Common.FactoryReset",
+                                "Reset");
+         }},
+        {"delete-all",
+         [&bus]() {
+             return callManager(
+                 bus, "xyz.openbmc_project.Collection.DeleteAll", "DeleteAll");
+         }},
+    };
+
+    json report = {{"faults", faultReport},
+                   {"probes", options.probes},
+                   {"scenarios", json::array()}};
+    bool guarded = true;
+    for (const auto& [name, action] : scenarios)
+    {
+        Probe probe(options.probes,
+                    std::chrono::milliseconds(options.interval));
+        auto start = std::chrono::steady_clock::now();
+        auto result = action();
+        result["action_ms"] =
+            Milliseconds(std::chrono::steady_clock::now() - start).count();
+        std::this_thread::sleep_for(settle);
+        result["name"] = name;
+        result["latency"] = probe.stop();
+
+        const auto& latency = result["latency"];
+        if ((options.maxP99 > 0) && latency.contains("p99_ms") &&
+            (latency.at("p99_ms").get<double>() > options.maxP99))
+        {
+            guarded = false;
+        }
+        report["scenarios"].push_back(std::move(result));
+    }
+
+    kill(updater, SIGTERM);
+    waitExit(updater);
+    stopPeers();
+
+    for (const auto& [busName, peer] : peers)
+    {
+        const auto& counts = peer->counts();
+        report["peers"][busName] = {{"calls", counts.calls},
+                                    {"dropped", counts.dropped},
+                                    {"failed", counts.failed}};
+    }
+    std::cout << report.dump(4) << std::endl;
+
+    if (!guarded)
+    {
+        std::cerr << "A p99 latency is above " << options.maxP99 << " ms\n";
+        return 1;
+    }
+    return 0;
+}
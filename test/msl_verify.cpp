@@ -9,80 +9,69 @@ namespace software
 namespace image
 {
 
-class MinimumShipLevelTest : public testing::Test
+TEST(MinimumShipLevel, compare)
 {
-  protected:
-    std::string minShipLevel = "v.2.2";
-    std::unique_ptr<MinimumShipLevel> minimumShipLevel;
-
-    virtual void SetUp()
-    {
-        minimumShipLevel = std::make_unique<MinimumShipLevel>(minShipLevel);
-    }
-};
-
-TEST_F(MinimumShipLevelTest, compare)
-{
-    MinimumShipLevel::Version min;
-    MinimumShipLevel::Version actual;
-
-    min = {3, 5, 7};
+    Version min = {3, 5, 7};
 
     // actual = min
-    actual = {3, 5, 7};
-    EXPECT_EQ(0, minimumShipLevel->compare(actual, min));
+    EXPECT_EQ(Version({3, 5, 7}), min);
 
     // actual < min
-    actual = {3, 5, 6};
-    EXPECT_EQ(-1, minimumShipLevel->compare(actual, min));
-    actual = {3, 4, 7};
-    EXPECT_EQ(-1, minimumShipLevel->compare(actual, min));
-    actual = {2, 5, 7};
-    EXPECT_EQ(-1, minimumShipLevel->compare(actual, min));
+    EXPECT_LT(Version({3, 5, 6}), min);
+    EXPECT_LT(Version({3, 4, 7}), min);
+    EXPECT_LT(Version({2, 5, 7}), min);
 
     // actual > min
-    actual = {3, 5, 8};
-    EXPECT_EQ(1, minimumShipLevel->compare(actual, min));
-    actual = {3, 6, 7};
-    EXPECT_EQ(1, minimumShipLevel->compare(actual, min));
-    actual = {4, 5, 7};
-    EXPECT_EQ(1, minimumShipLevel->compare(actual, min));
+    EXPECT_GT(Version({3, 5, 8}), min);
+    EXPECT_GT(Version({3, 6, 7}), min);
+    EXPECT_GT(Version({4, 5, 7}), min);
+
+    // Components are compared as numbers, not as strings
+    EXPECT_GT(Version({2, 10, 0}), Version({2, 9, 0}));
+    EXPECT_GT(Version({300, 0, 0}), Version({255, 0, 0}));
+}
+
+TEST(MinimumShipLevel, parse)
+{
+    EXPECT_FALSE(parseVersion("nomatch-1.2.3-abc"));
+    EXPECT_FALSE(parseVersion("v"));
+    EXPECT_FALSE(parseVersion("v1."));
+
+    EXPECT_EQ(Version({1, 2, 3}), parseVersion("xyzformat-v1.2.3-4.5abc"));
+    EXPECT_EQ(Version({6, 7, 0}), parseVersion("xyformat-system-v6.7-abc"));
+    EXPECT_EQ(Version({4, 1, 1}), parseVersion("Vendor-Model-v-4.1.01"));
+    EXPECT_EQ(Version({4, 1, 0}), parseVersion("Vendor-Model-v-4.1-abc"));
+
+    // A three component version is preferred wherever it is
+    EXPECT_EQ(Version({3, 4, 5}), parseVersion("v1.2-v3.4.5"));
+}
+
+TEST(MinimumShipLevel, policyIsSortedNumerically)
+{
+    constexpr std::string_view levels = " v2.10  v2.9.3 v-1.2 ";
+    static_assert(countLevels(levels) == 3);
+    constexpr auto policy = makePolicy<countLevels(levels)>(levels);
+    static_assert(policy[0] == Version{1, 2, 0});
+    static_assert(policy[1] == Version{2, 9, 3});
+    static_assert(policy[2] == Version{2, 10, 0});
+    EXPECT_EQ(3, policy.size());
 }
 
-TEST_F(MinimumShipLevelTest, parse)
+TEST(MinimumShipLevel, unmetLevel)
 {
-    MinimumShipLevel::Version version;
-    std::string versionStr;
-
-    versionStr = "nomatch-1.2.3-abc";
-    minimumShipLevel->parse(versionStr, version);
-    EXPECT_EQ(0, version.major);
-    EXPECT_EQ(0, version.minor);
-    EXPECT_EQ(0, version.rev);
-
-    versionStr = "xyzformat-v1.2.3-4.5abc";
-    minimumShipLevel->parse(versionStr, version);
-    EXPECT_EQ(1, version.major);
-    EXPECT_EQ(2, version.minor);
-    EXPECT_EQ(3, version.rev);
-
-    versionStr = "xyformat-system-v6.7-abc";
-    minimumShipLevel->parse(versionStr, version);
-    EXPECT_EQ(6, version.major);
-    EXPECT_EQ(7, version.minor);
-    EXPECT_EQ(0, version.rev);
-
-    versionStr = "Vendor-Model-v-4.1.01";
-    minimumShipLevel->parse(versionStr, version);
-    EXPECT_EQ(4, version.major);
-    EXPECT_EQ(1, version.minor);
-    EXPECT_EQ(1, version.rev);
-
-    versionStr = "Vendor-Model-v-4.1-abc";
-    minimumShipLevel->parse(versionStr, version);
-    EXPECT_EQ(4, version.major);
-    EXPECT_EQ(1, version.minor);
-    EXPECT_EQ(0, version.rev);
+    constexpr std::string_view levels = "v2.0.10 v2.2";
+    constexpr auto policy = makePolicy<countLevels(levels)>(levels);
+
+    EXPECT_FALSE(unmetLevel({2, 0, 11}, policy));
+    EXPECT_FALSE(unmetLevel({2, 2, 0}, policy));
+    EXPECT_FALSE(unmetLevel({2, 10, 0}, policy));
+    EXPECT_FALSE(unmetLevel({3, 0, 0}, policy));
+
+    EXPECT_EQ(Version({2, 0, 10}), unmetLevel({2, 0, 9}, policy));
+    EXPECT_EQ(Version({2, 2, 0}), unmetLevel({2, 1, 5}, policy));
+    EXPECT_EQ(Version({2, 0, 10}), unmetLevel({1, 9, 0}, policy));
+
+    EXPECT_FALSE(unmetLevel({0, 0, 0}, {}));
 }
 
 } // namespace image
@@ -0,0 +1,200 @@
+#include "stand_in.hpp"
+
+#include <sdbusplus/exception.hpp>
+
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+
+namespace openpower
+{
+namespace software
+{
+namespace updater
+{
+namespace test
+{
+
+namespace
+{
+
+constexpr auto injectedError =
+    "xyz.openbmc_project.Common.Error.InternalFailure";
+constexpr auto unknownMethod = "org.freedesktop.DBus.Error.UnknownMethod";
+constexpr auto invalidArgs = "org.freedesktop.DBus.Error.InvalidArgs";
+constexpr auto failed = "org.freedesktop.DBus.Error.Failed";
+
+} // namespace
+
+Faults parseFaults(const std::string& spec)
+{
+    Faults faults;
+    std::istringstream iss(spec);
+    std::string field;
+    while (std::getline(iss, field, ','))
+    {
+        auto eq = field.find('=');
+        if (eq == std::string::npos)
+        {
+            throw std::invalid_argument("Bad fault: " + field);
+        }
+        auto name = field.substr(0, eq);
+        auto value = field.substr(eq + 1);
+        if (name == "delay")
+        {
+            faults.delay = std::chrono::milliseconds(std::stoul(value));
+        }
+        else if (name == "jitter")
+        {
+            faults.jitter = std::chrono::milliseconds(std::stoul(value));
+        }
+        else if (name == "drop")
+        {
+            faults.drop = std::stod(value);
+        }
+        else if (name == "error")
+        {
+            faults.error = std::stod(value);
+        }
+        else
+        {
+            throw std::invalid_argument("Unknown fault: " + name);
+        }
+    }
+    return faults;
+}
+
+StandIn::StandIn(const sdeventplus::Event& event, const std::string& busName,
+                 const Faults& faults, uint32_t seed) :
+    busName(busName),
+    faults(faults), random(seed), bus(sdbusplus::bus::new_system()),
+    timer(event, [this](auto&) { runDue(); })
+{
+    bus.attach_event(event.get(), SD_EVENT_PRIORITY_NORMAL);
+    sd_bus_add_fallback(bus.get(), &slot, "/", dispatch, this);
+    bus.request_name(busName.c_str());
+}
+
+StandIn::~StandIn()
+{
+    sd_bus_slot_unref(slot);
+}
+
+void StandIn::method(const std::string& interface, const std::string& member,
+                     Handler handler)
+{
+    handlers[{interface, member}] = std::move(handler);
+}
+
+void StandIn::later(std::chrono::milliseconds delay, Callback callback)
+{
+    pending.emplace(Clock::now() + delay, std::move(callback));
+    rearm();
+}
+
+int StandIn::dispatch(sd_bus_message* m, void* context, sd_bus_error*)
+{
+    auto standIn = static_cast<StandIn*>(context);
+    sdbusplus::message::message call(m);
+    standIn->answer(call);
+
+    // Handled, even when the reply is dropped
+    return 1;
+}
+
+void StandIn::answer(sdbusplus::message::message& call)
+{
+    count.calls++;
+    std::uniform_real_distribution<double> chance(0, 1);
+    if (chance(random) < faults.drop)
+    {
+        count.dropped++;
+        return;
+    }
+
+    sd_bus_message* m = nullptr;
+    auto interface = sd_bus_message_get_interface(call.get());
+    auto member = sd_bus_message_get_member(call.get());
+    auto handler = handlers.find(
+        {interface ? interface : "", member ? member : ""});
+    if (handler == handlers.end())
+    {
+        sd_bus_message_new_method_errorf(call.get(), &m, unknownMethod,
+                                         "Not served by the stand-in %s",
+                                         busName.c_str());
+    }
+    else if (chance(random) < faults.error)
+    {
+        count.failed++;
+        sd_bus_message_new_method_errorf(call.get(), &m, injectedError,
+                                         "Injected failure");
+    }
+    else
+    {
+        auto reply = call.new_method_return();
+        try
+        {
+            handler->second(call, reply);
+            m = sd_bus_message_ref(reply.get());
+        }
+        catch (const sdbusplus::exception::exception& e)
+        {
+            sd_bus_message_new_method_errorf(call.get(), &m, invalidArgs, "%s",
+                                             e.what());
+        }
+        catch (const std::exception& e)
+        {
+            sd_bus_message_new_method_errorf(call.get(), &m, failed, "%s",
+                                             e.what());
+        }
+    }
+    if (!m)
+    {
+        return;
+    }
+    sdbusplus::message::message reply(m, std::false_type());
+
+    auto delay = faults.delay;
+    if (faults.jitter.count() > 0)
+    {
+        std::uniform_int_distribution<int64_t> jitter(0,
+                                                      faults.jitter.count());
+        delay += std::chrono::milliseconds(jitter(random));
+    }
+    auto sendReply = [this, reply]() mutable {
+        sd_bus_send(bus.get(), reply.get(), nullptr);
+    };
+    if (delay.count() == 0)
+    {
+        sendReply();
+        return;
+    }
+    later(delay, std::move(sendReply));
+}
+
+void StandIn::runDue()
+{
+    while (!pending.empty() && (pending.begin()->first <= Clock::now()))
+    {
+        auto callback = std::move(pending.begin()->second);
+        pending.erase(pending.begin());
+        callback();
+    }
+    if (!pending.empty())
+    {
+        rearm();
+    }
+}
+
+void StandIn::rearm()
+{
+    auto wait = std::max(pending.begin()->first - Clock::now(),
+                         Clock::duration::zero());
+    timer.restartOnce(
+        std::chrono::duration_cast<std::chrono::microseconds>(wait));
+}
+
+} // namespace test
+} // namespace updater
+} // namespace software
+} // namespace openpower
@@ -0,0 +1,188 @@
+#pragma once
+
+#include <sdbusplus/bus.hpp>
+#include <sdbusplus/message.hpp>
+#include <sdeventplus/clock.hpp>
+#include <sdeventplus/event.hpp>
+#include <sdeventplus/utility/timer.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <random>
+#include <string>
+#include <utility>
+
+namespace openpower
+{
+namespace software
+{
+namespace updater
+{
+namespace test
+{
+
+/** @struct Faults
+ *  @brief The faults a stand-in service injects into its replies.
+ */
+struct Faults
+{
+    /** @brief The delay added to every reply */
+    std::chrono::milliseconds delay{0};
+
+    /** @brief The most extra delay added to a reply, picked uniformly */
+    std::chrono::milliseconds jitter{0};
+
+    /** @brief The fraction of the calls never replied to, which the caller
+     *  waits its whole timeout for */
+    double drop = 0;
+
+    /** @brief The fraction of the calls failed with an error */
+    double error = 0;
+};
+
+/** @brief Parse a fault specification
+ *
+ *  @param[in] spec - e.g. "delay=200,jitter=50,drop=0.01,error=0.05", the
+ *                    times in milliseconds
+ *
+ *  @return The faults, with the unnamed ones left at none
+ *
+ *  @throw std::invalid_argument for an unknown fault or a bad value
+ */
+Faults parseFaults(const std::string& spec);
+
+/** @class StandIn
+ *  @brief A D-Bus service standing in for one of the peers of the updater,
+ *  answering any object path with the registered methods, and injecting
+ *  delays, drops and errors into its replies.
+ *  @details The replies are sent from the event loop of the stand-in, a
+ *  delayed reply does not hold the other calls back, as with a real peer
+ *  that is slow rather than stuck.
+ */
+class StandIn
+{
+  public:
+    /** @brief Reads the arguments of a call and appends its reply, or
+     *  throws to fail the call */
+    using Handler = std::function<void(sdbusplus::message::message& call,
+                                       sdbusplus::message::message& reply)>;
+
+    /** @brief Run later on the event loop of the stand-in */
+    using Callback = std::function<void()>;
+
+    StandIn() = delete;
+    StandIn(const StandIn&) = delete;
+    StandIn& operator=(const StandIn&) = delete;
+    StandIn(StandIn&&) = delete;
+    StandIn& operator=(StandIn&&) = delete;
+
+    /** @brief Constructs StandIn, claiming its bus name on the system bus
+     *
+     *  @param[in] event   - The event loop the stand-in runs on
+     *  @param[in] busName - The bus name of the peer
+     *  @param[in] faults  - The faults to inject
+     *  @param[in] seed    - The seed of the fault draws, for repeatable runs
+     */
+    StandIn(const sdeventplus::Event& event, const std::string& busName,
+            const Faults& faults, uint32_t seed);
+
+    ~StandIn();
+
+    /** @brief Register a method, on every object path
+     *
+     *  @param[in] interface - The interface of the method
+     *  @param[in] member    - The name of the method
+     *  @param[in] handler   - Builds the reply
+     */
+    void method(const std::string& interface, const std::string& member,
+                Handler handler);
+
+    /** @brief Run a callback on the event loop after a delay, e.g. to signal
+     *  the end of a job
+     *
+     *  @param[in] delay    - The delay
+     *  @param[in] callback - The callback
+     */
+    void later(std::chrono::milliseconds delay, Callback callback);
+
+    /** @brief The connection of the stand-in, only used on its event loop */
+    sdbusplus::bus::bus& getBus()
+    {
+        return bus;
+    }
+
+    /** @brief The bus name of the stand-in */
+    const std::string& name() const
+    {
+        return busName;
+    }
+
+    /** @struct Counts
+     *  @brief The calls a stand-in received, and the faults it injected.
+     */
+    struct Counts
+    {
+        uint64_t calls = 0;
+        uint64_t dropped = 0;
+        uint64_t failed = 0;
+    };
+
+    /** @brief The counts so far, read once the event loop stopped */
+    const Counts& counts() const
+    {
+        return count;
+    }
+
+  private:
+    using Clock = std::chrono::steady_clock;
+
+    /** @brief sd-bus callback for the calls to any object path */
+    static int dispatch(sd_bus_message* m, void* context, sd_bus_error* error);
+
+    /** @brief Answer a call, as the faults have it
+     *
+     *  @param[in] call - The call
+     */
+    void answer(sdbusplus::message::message& call);
+
+    /** @brief Run the callbacks that are due, and rearm the timer for the
+     *  next one */
+    void runDue();
+
+    /** @brief Arm the timer for the first pending callback */
+    void rearm();
+
+    /** @brief The bus name of the stand-in */
+    std::string busName;
+
+    /** @brief The faults to inject */
+    Faults faults;
+
+    /** @brief The fault draws */
+    std::mt19937 random;
+
+    /** @brief The connection of the stand-in */
+    sdbusplus::bus::bus bus;
+
+    /** @brief The slot of the fallback handler of every object path */
+    sd_bus_slot* slot = nullptr;
+
+    /** @brief The methods, by interface and name */
+    std::map<std::pair<std::string, std::string>, Handler> handlers;
+
+    /** @brief The delayed replies and callbacks, by when they are due */
+    std::multimap<Clock::time_point, Callback> pending;
+
+    /** @brief The calls and faults so far */
+    Counts count;
+
+    /** @brief Fires when the first pending callback is due */
+    sdeventplus::utility::Timer<sdeventplus::ClockId::Monotonic> timer;
+};
+
+} // namespace test
+} // namespace updater
+} // namespace software
+} // namespace openpower
@@ -0,0 +1,86 @@
+#include "buffer_pool.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using namespace openpower::software::updater;
+
+TEST(BufferPool, buffersAreAlignedAndRoundedUp)
+{
+    BufferPool pool(100 * 1024, 2);
+    EXPECT_EQ(2 * BufferPool::alignment, pool.bufferSize());
+
+    auto buffer = pool.acquire();
+    ASSERT_TRUE(buffer);
+    EXPECT_EQ(pool.bufferSize(), buffer.size());
+    EXPECT_EQ(0, reinterpret_cast<uintptr_t>(buffer.data()) %
+                     BufferPool::alignment);
+}
+
+TEST(BufferPool, buffersAreReused)
+{
+    BufferPool pool(BufferPool::alignment, 2);
+    char* first = nullptr;
+    {
+        auto buffer = pool.acquire();
+        first = buffer.data();
+    }
+    for (int i = 0; i < 100; i++)
+    {
+        auto buffer = pool.acquire();
+        EXPECT_EQ(first, buffer.data());
+    }
+    EXPECT_EQ(1, pool.allocated());
+}
+
+TEST(BufferPool, poolIsBounded)
+{
+    BufferPool pool(BufferPool::alignment, 2);
+    auto a = pool.tryAcquire();
+    auto b = pool.tryAcquire();
+    EXPECT_TRUE(a);
+    EXPECT_TRUE(b);
+    EXPECT_NE(a.data(), b.data());
+    EXPECT_FALSE(pool.tryAcquire());
+
+    // A moved buffer is returned once, by its new holder
+    auto c = std::move(a);
+    EXPECT_FALSE(a);
+    EXPECT_FALSE(pool.tryAcquire());
+    c = {};
+    EXPECT_TRUE(pool.tryAcquire());
+    EXPECT_EQ(2, pool.allocated());
+}
+
+TEST(BufferPool, acquireWaitsForAReturnedBuffer)
+{
+    BufferPool pool(BufferPool::alignment, 1);
+    std::atomic<int> holders = 0;
+    std::atomic<int> most = 0;
+    {
+        std::vector<std::jthread> threads;
+        for (int i = 0; i < 4; i++)
+        {
+            threads.emplace_back([&pool, &holders, &most]() {
+                for (int j = 0; j < 50; j++)
+                {
+                    auto buffer = pool.acquire();
+                    ASSERT_TRUE(buffer);
+                    auto now = ++holders;
+                    int seen = most;
+                    while ((now > seen) &&
+                           !most.compare_exchange_weak(seen, now))
+                    {}
+                    buffer.data()[0] = static_cast<char>(j);
+                    --holders;
+                }
+            });
+        }
+    }
+    EXPECT_EQ(1, most);
+    EXPECT_EQ(1, pool.allocated());
+}
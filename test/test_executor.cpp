@@ -0,0 +1,148 @@
+#include "executor.hpp"
+
+#include <sdeventplus/clock.hpp>
+#include <sdeventplus/event.hpp>
+#include <sdeventplus/utility/timer.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <optional>
+#include <stop_token>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+using openpower::software::updater::Executor;
+using namespace std::chrono_literals;
+using Timer = sdeventplus::utility::Timer<sdeventplus::ClockId::Monotonic>;
+
+namespace
+{
+
+/** @brief Wait for a condition set by another thread, for at most 5s */
+template <typename Condition>
+bool waitFor(Condition condition)
+{
+    auto deadline = std::chrono::steady_clock::now() + 5s;
+    while (!condition())
+    {
+        if (std::chrono::steady_clock::now() > deadline)
+        {
+            return false;
+        }
+        std::this_thread::sleep_for(1ms);
+    }
+    return true;
+}
+
+} // namespace
+
+TEST(Executor, completionRunsOnTheLoopThread)
+{
+    auto event = sdeventplus::Event::get_new();
+    Executor executor(event, 2);
+
+    std::thread::id workThread, doneThread;
+    executor.post(
+        [&](std::stop_token) { workThread = std::this_thread::get_id(); },
+        [&]() {
+            doneThread = std::this_thread::get_id();
+            event.exit(0);
+        });
+    EXPECT_EQ(0, event.loop());
+
+    EXPECT_NE(std::this_thread::get_id(), workThread);
+    EXPECT_EQ(std::this_thread::get_id(), doneThread);
+}
+
+TEST(Executor, cancelledWorkIsSkipped)
+{
+    auto event = sdeventplus::Event::get_new();
+    Executor executor(event, 1);
+
+    std::atomic<bool> release = false;
+    bool cancelledRan = false;
+    executor.post(
+        [&](std::stop_token) { waitFor([&] { return release.load(); }); });
+    auto cancelled =
+        executor.post([&](std::stop_token) { cancelledRan = true; },
+                      [&]() { cancelledRan = true; });
+    executor.post([](std::stop_token) {}, [&]() { event.exit(0); });
+
+    cancelled.request_stop();
+    release = true;
+    EXPECT_EQ(0, event.loop());
+
+    EXPECT_FALSE(cancelledRan);
+}
+
+TEST(Executor, loopKeepsRunningDuringWork)
+{
+    auto event = sdeventplus::Event::get_new();
+    Executor executor(event, 1);
+
+    // Stands for the D-Bus requests served while a reset is running
+    std::atomic<int> ticks = 0;
+    Timer timer(event, [&](Timer&) { ticks++; }, 1ms);
+
+    bool served = false;
+    executor.post(
+        [&](std::stop_token) { served = waitFor([&] { return ticks >= 3; }); },
+        [&]() { event.exit(0); });
+    EXPECT_EQ(0, event.loop());
+
+    EXPECT_TRUE(served);
+}
+
+TEST(Executor, destructionCancelsRunningWork)
+{
+    auto event = sdeventplus::Event::get_new();
+    std::atomic<bool> started = false;
+    bool stopped = false;
+    bool doneRan = false;
+    {
+        Executor executor(event, 1);
+        executor.post(
+            [&](std::stop_token token) {
+                started = true;
+                stopped = waitFor([&] { return token.stop_requested(); });
+            },
+            [&]() { doneRan = true; });
+        ASSERT_TRUE(waitFor([&] { return started.load(); }));
+    }
+
+    EXPECT_TRUE(stopped);
+    EXPECT_FALSE(doneRan);
+}
+
+TEST(Executor, cancellationCompletes)
+{
+    auto event = sdeventplus::Event::get_new();
+    Executor executor(event, 1);
+
+    std::atomic<bool> started = false;
+    std::atomic<bool> release = false;
+    bool doneRan = false;
+    int cancelledRan = 0;
+    auto running = executor.post(
+        [&](std::stop_token) {
+            started = true;
+            waitFor([&] { return release.load(); });
+        },
+        [&]() { doneRan = true; }, [&]() { cancelledRan++; });
+    auto queued = executor.post(
+        [](std::stop_token) {}, [&]() { doneRan = true; },
+        [&]() { cancelledRan++; });
+    executor.post([](std::stop_token) {}, [&]() { event.exit(0); });
+
+    // Both the running work and the work dropped before it started
+    // complete through their cancellation
+    ASSERT_TRUE(waitFor([&] { return started.load(); }));
+    running.request_stop();
+    queued.request_stop();
+    release = true;
+    EXPECT_EQ(0, event.loop());
+
+    EXPECT_FALSE(doneRan);
+    EXPECT_EQ(2, cancelledRan);
+}
@@ -0,0 +1,177 @@
+#include "flash_device.hpp"
+
+#include <unistd.h>
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using namespace openpower::software::updater;
+namespace fs = std::filesystem;
+
+TEST(FlashDevice, emptyIsErased)
+{
+    EXPECT_TRUE(isErased(nullptr, 0));
+}
+
+TEST(FlashDevice, allOnesIsErasedAtAnyAlignment)
+{
+    std::vector<uint8_t> data(4096 + 64, 0xFF);
+    for (size_t start = 0; start < 16; start++)
+    {
+        for (size_t size : {1, 7, 31, 32, 33, 255, 4096})
+        {
+            EXPECT_TRUE(isErased(data.data() + start, size))
+                << "start " << start << " size " << size;
+        }
+    }
+}
+
+TEST(FlashDevice, anyClearedBitIsNotErased)
+{
+    std::vector<uint8_t> data(100, 0xFF);
+    for (size_t start = 0; start < 8; start++)
+    {
+        auto size = data.size() - start;
+        for (size_t pos = 0; pos < size; pos++)
+        {
+            data[start + pos] = 0xFE;
+            EXPECT_FALSE(isErased(data.data() + start, size))
+                << "start " << start << " pos " << pos;
+            data[start + pos] = 0xFF;
+        }
+    }
+}
+
+TEST(FlashDevice, bytesPastTheSizeAreIgnored)
+{
+    std::vector<uint8_t> data(64, 0xFF);
+    data[40] = 0;
+    EXPECT_TRUE(isErased(data.data(), 40));
+    EXPECT_FALSE(isErased(data.data(), 41));
+}
+
+class FlashSimulatorTest : public testing::Test
+{
+  protected:
+    void SetUp() override
+    {
+        char dir[] = "/tmp/flashXXXXXX";
+        base = mkdtemp(dir);
+    }
+
+    void TearDown() override
+    {
+        fs::remove_all(base);
+    }
+
+    void writeFile(const fs::path& path, const std::vector<uint8_t>& content)
+    {
+        std::ofstream file(path, std::ios::binary);
+        file.write(reinterpret_cast<const char*>(content.data()),
+                   content.size());
+    }
+
+    std::vector<uint8_t> readFile(const fs::path& path)
+    {
+        std::ifstream file(path, std::ios::binary);
+        return {std::istreambuf_iterator<char>(file), {}};
+    }
+
+    fs::path base;
+};
+
+TEST_F(FlashSimulatorTest, programOnlyClearsBits)
+{
+    auto size = 2 * FlashDevice::simulatedEraseSize;
+    writeFile(base / "mtd", std::vector<uint8_t>(size, 0x0F));
+
+    FlashDevice device(base / "mtd");
+    ASSERT_TRUE(device);
+    EXPECT_EQ(size, device.size());
+    EXPECT_EQ(FlashDevice::simulatedEraseSize, device.eraseSize());
+
+    // Programming over unerased cells clears the bits of both
+    ProgramStats stats;
+    std::vector<uint8_t> data(16, 0xF1);
+    EXPECT_TRUE(device.program(0, data.data(), data.size(), stats, false));
+    EXPECT_EQ(0x01, readFile(base / "mtd")[0]);
+
+    EXPECT_TRUE(device.erase(0, 1));
+    auto content = readFile(base / "mtd");
+    EXPECT_EQ(0xFF, content[0]);
+    EXPECT_EQ(0xFF, content[FlashDevice::simulatedEraseSize - 1]);
+    EXPECT_EQ(0x0F, content[FlashDevice::simulatedEraseSize]);
+
+    EXPECT_TRUE(device.program(0, data.data(), data.size(), stats, false));
+    EXPECT_EQ(0xF1, readFile(base / "mtd")[0]);
+}
+
+TEST_F(FlashSimulatorTest, programDevicesConcurrently)
+{
+    auto size = 4 * FlashDevice::simulatedEraseSize;
+    std::vector<uint8_t> image0(size, 0xFF);
+    std::vector<uint8_t> image1(size / 2, 0x5A);
+    image0[size / 2] = 0xA5;
+    writeFile(base / "image0", image0);
+    writeFile(base / "image1", image1);
+    writeFile(base / "mtd0", std::vector<uint8_t>(size, 0));
+    writeFile(base / "mtd1", std::vector<uint8_t>(size, 0));
+
+    std::atomic<uint64_t> done = 0;
+    auto results = programDevices({{base / "mtd0", base / "image0"},
+                                   {base / "mtd1", base / "image1"}},
+                                  done);
+    ASSERT_EQ(2, results.size());
+    EXPECT_TRUE(results[0].programmed);
+    EXPECT_TRUE(results[1].programmed);
+    EXPECT_EQ(base / "mtd1", results[1].device);
+    EXPECT_EQ(image0.size() + image1.size(), done);
+
+    EXPECT_EQ(image0, readFile(base / "mtd0"));
+    auto content = readFile(base / "mtd1");
+    EXPECT_TRUE(std::equal(image1.begin(), image1.end(), content.begin()));
+    EXPECT_TRUE(isErased(content.data() + image1.size(), size / 2));
+}
+
+TEST_F(FlashSimulatorTest, failedDeviceDoesNotStopTheOthers)
+{
+    auto size = FlashDevice::simulatedEraseSize;
+    writeFile(base / "image", std::vector<uint8_t>(size, 0x12));
+    writeFile(base / "mtd0", std::vector<uint8_t>(size, 0));
+
+    std::atomic<uint64_t> done = 0;
+    auto results = programDevices({{base / "missing", base / "image"},
+                                   {base / "mtd0", base / "image"}},
+                                  done);
+    ASSERT_EQ(2, results.size());
+    EXPECT_FALSE(results[0].programmed);
+    EXPECT_TRUE(results[1].programmed);
+    EXPECT_EQ(size, done);
+
+    // A device mapped twice is not programmed at all
+    done = 0;
+    results = programDevices({{base / "mtd0", base / "image"},
+                              {base / "mtd0", base / "image"}},
+                             done);
+    for (const auto& result : results)
+    {
+        EXPECT_FALSE(result.programmed);
+    }
+    EXPECT_EQ(0, done);
+}
+
+TEST(FlashDeviceMap, parseDeviceMap)
+{
+    constexpr auto content = "# image device\n"
+                             "host0.pnor pnor\n"
+                             "\n"
+                             "  host1.pnor   /dev/mtd7\n"
+                             "incomplete\n";
+    EXPECT_EQ((std::vector<std::pair<std::string, std::string>>{
+                  {"host0.pnor", "pnor"}, {"host1.pnor", "/dev/mtd7"}}),
+              parseDeviceMap(content));
+}
@@ -0,0 +1,117 @@
+#include "config.h"
+
+#include "mmc/fsverity.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+#include <gtest/gtest.h>
+
+using namespace openpower::software::updater;
+
+TEST(FsVerityTest, ParseVerityList)
+{
+    constexpr auto list =
+        "sha256:"
+        "3c1b5d0e6a8f28c1c2d5b8d1a5c9c0f9a1f7f0e3b6f5c2d4a1e9b8c7d6e5f4a3 "
+        "81e00994.lid\n"
+        "sha256:"
+        "0f1e2d3c4b5a69788796a5b4c3d2e1f00f1e2d3c4b5a69788796a5b4c3d2e1f0 "
+        "/tmp/lids/81e0066a.lid\n";
+
+    auto lids = parseVerityList(list);
+    ASSERT_EQ(2, lids.size());
+    EXPECT_EQ("sha256:"
+              "3c1b5d0e6a8f28c1c2d5b8d1a5c9c0f9a1f7f0e3b6f5c2d4a1e9b8c7d6e5f4a3",
+              lids.at("81e00994.lid"));
+    EXPECT_EQ("sha256:"
+              "0f1e2d3c4b5a69788796a5b4c3d2e1f00f1e2d3c4b5a69788796a5b4c3d2e1f0",
+              lids.at("81e0066a.lid"));
+}
+
+TEST(FsVerityTest, ParseVerityListMalformed)
+{
+    // Verify it does not crash on malformed texts
+    constexpr auto list =
+        "sha256:3c1b5d0e\n"               // missing file name
+        "sha512:0f1e2d3c 81e0066a.lid\n"  // unsupported algorithm
+        "81e00994.lid sha256:3c1b5d0e\n"  // swapped fields
+        "sha256:00aa11bb 81e00995.lid\n"; // The only valid one
+
+    auto lids = parseVerityList(list);
+    ASSERT_EQ(1, lids.size());
+    EXPECT_EQ("sha256:00aa11bb", lids.at("81e00995.lid"));
+}
+
+class VerifyLidsTest : public testing::Test
+{
+  protected:
+    VerifyLidsTest()
+    {
+        char dirTemplate[] = "/tmp/VerifyLidsTest-XXXXXX";
+        dir = mkdtemp(dirTemplate);
+        std::ofstream(dir / "81e00994.lid") << "toc";
+        std::ofstream(dir / "81e0066a.lid") << "lid";
+    }
+
+    ~VerifyLidsTest()
+    {
+        std::filesystem::remove_all(dir);
+    }
+
+    std::filesystem::path dir;
+};
+
+TEST_F(VerifyLidsTest, ComputeVerity)
+{
+    // As computed by the fsverity digest command
+    std::ofstream(dir / "empty.lid");
+    EXPECT_EQ("sha256:"
+              "3d248ca542a24fc62d1c43b916eae5016878e2533c88238480b26128a1f1af95",
+              computeVerity(dir / "empty.lid"));
+    EXPECT_EQ("sha256:"
+              "cfff3b6f824b754d94a960230f25bc37f4f28f7911b5ce1f1a86f6bcd4f728c8",
+              computeVerity(dir / "81e0066a.lid"));
+
+    // Two levels of tree blocks above the data blocks
+    std::string data(4096 * 200 + 17, '\0');
+    for (size_t i = 0; i < data.size(); i++)
+    {
+        data[i] = static_cast<char>(i % 251);
+    }
+    std::ofstream(dir / "large.lid", std::ios::binary) << data;
+    EXPECT_EQ("sha256:"
+              "6ea849731ea300e31527be3663c9141c176682b2a2f4c33e114cda5df12f915e",
+              computeVerity(dir / "large.lid"));
+
+    EXPECT_EQ("", computeVerity(dir / "no-such.lid"));
+}
+
+TEST_F(VerifyLidsTest, VerifyLidsWithoutList)
+{
+    // Without a digest list no LID is verified
+    EXPECT_FALSE(verifyLids(dir, dir / "no-such-dir", {"81e0066a.lid"}, true));
+    EXPECT_TRUE(verifyLids(dir, dir / "no-such-dir", {}, true));
+}
+
+#ifndef WANT_SIGNATURE_VERIFY
+TEST_F(VerifyLidsTest, VerifyLidsByDigest)
+{
+    std::ofstream(dir / "lids.fsverity")
+        << computeVerity(dir / "81e00994.lid") << " 81e00994.lid\n"
+        << computeVerity(dir / "81e0066a.lid") << " 81e0066a.lid\n";
+    EXPECT_TRUE(
+        verifyLids(dir, dir, {"81e00994.lid", "81e0066a.lid"}, false));
+
+    // A LID the list does not name, or that is missing, is not verified
+    std::ofstream(dir / "81e00995.lid") << "unsigned";
+    EXPECT_FALSE(verifyLids(dir, dir, {"81e0066a.lid", "81e00995.lid"}, false));
+    std::filesystem::remove(dir / "81e0066a.lid");
+    EXPECT_FALSE(verifyLids(dir, dir, {"81e00994.lid", "81e0066a.lid"}, false));
+
+    // Nor is a LID that changed
+    std::ofstream(dir / "81e00994.lid") << "tampered";
+    EXPECT_FALSE(verifyLids(dir, dir, {"81e00994.lid"}, false));
+}
+#endif
@@ -0,0 +1,83 @@
+#include "mmc/host_lids.hpp"
+
+#include <filesystem>
+#include <fstream>
+
+#include <gtest/gtest.h>
+
+using namespace openpower::software::updater;
+namespace fs = std::filesystem;
+
+class HostLidsTest : public testing::Test
+{
+  protected:
+    void SetUp() override
+    {
+        char dir[] = "/tmp/hostlidsXXXXXX";
+        base = mkdtemp(dir);
+        fs::create_directories(base / "image");
+        fs::create_directories(base / "side");
+    }
+
+    void TearDown() override
+    {
+        fs::remove_all(base);
+    }
+
+    void writeFile(const fs::path& path, const std::string& content)
+    {
+        std::ofstream file(path);
+        file << content;
+    }
+
+    fs::path base;
+};
+
+TEST_F(HostLidsTest, PlanSkipsUnchangedLids)
+{
+    writeFile(base / "image" / "81e00994.lid", "toc");
+    writeFile(base / "image" / "81e00600.lid", "same");
+    writeFile(base / "image" / "81e00601.lid", "newer");
+    writeFile(base / "image" / "81e00602.lid", "added");
+    writeFile(base / "image" / "MANIFEST", "purpose=Host");
+
+    writeFile(base / "side" / "81e00994.lid", "toc");
+    writeFile(base / "side" / "81e00600.lid", "same");
+    writeFile(base / "side" / "81e00601.lid", "older");
+    writeFile(base / "side" / "81e00700.lid", "stale");
+
+    auto plan = planLids(base / "image", base / "side", {});
+    EXPECT_EQ(2, plan.unchanged);
+    EXPECT_EQ((std::vector<std::string>{"81e00601.lid", "81e00602.lid"}),
+              plan.changed);
+    EXPECT_EQ(std::vector<std::string>{"81e00700.lid"}, plan.stale);
+    EXPECT_EQ(10, plan.bytes);
+}
+
+TEST_F(HostLidsTest, SameContentComparesSizeAndBytes)
+{
+    writeFile(base / "a", "content");
+    writeFile(base / "b", "content");
+    writeFile(base / "c", "contenT");
+    writeFile(base / "d", "content!");
+
+    EXPECT_TRUE(sameContent(base / "a", base / "b"));
+    EXPECT_FALSE(sameContent(base / "a", base / "c"));
+    EXPECT_FALSE(sameContent(base / "a", base / "d"));
+    EXPECT_FALSE(sameContent(base / "a", base / "missing"));
+}
+
+TEST_F(HostLidsTest, WriteLidReplacesTarget)
+{
+    std::string content(600 * 1024, 'x');
+    writeFile(base / "image" / "81e00601.lid", content);
+    writeFile(base / "side" / "81e00601.lid", "older");
+
+    std::atomic<uint64_t> done = 0;
+    EXPECT_TRUE(
+        writeLid(base / "image" / "81e00601.lid", base / "side", done, {}));
+    EXPECT_EQ(content.size(), done);
+    EXPECT_FALSE(fs::exists(base / "side" / "81e00601.lid.tmp"));
+    EXPECT_TRUE(readBackLid(base / "image" / "81e00601.lid",
+                            base / "side" / "81e00601.lid"));
+}
@@ -0,0 +1,44 @@
+#include "item_updater.hpp"
+
+#include <filesystem>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using namespace openpower::software::updater;
+using Activations =
+    sdbusplus::xyz::openbmc_project::Software::server::Activation::Activations;
+namespace fs = std::filesystem;
+
+TEST(TestItemUpdater, RemoveStaleImages)
+{
+    char dir[] = "/tmp/imagesXXXXXX";
+    fs::path imgDir = mkdtemp(dir);
+    for (const auto& id : {"failed", "invalid", "ready", "active"})
+    {
+        fs::create_directories(imgDir / id);
+    }
+
+    // Only the staged images of the failed and invalid versions go, the
+    // versions themselves stay for the operator to delete
+    std::map<std::string, Activations> states = {
+        {"failed", Activations::Failed},
+        {"invalid", Activations::Invalid},
+        {"ready", Activations::Ready},
+        {"active", Activations::Active},
+        {"installed", Activations::Failed},
+    };
+    EXPECT_EQ((std::vector<std::string>{"failed", "invalid"}),
+              removeStaleImages(states, imgDir));
+    EXPECT_FALSE(fs::exists(imgDir / "failed"));
+    EXPECT_FALSE(fs::exists(imgDir / "invalid"));
+    EXPECT_TRUE(fs::exists(imgDir / "ready"));
+    EXPECT_TRUE(fs::exists(imgDir / "active"));
+
+    // Nothing is left to reclaim on the next pass
+    EXPECT_TRUE(removeStaleImages(states, imgDir).empty());
+
+    fs::remove_all(imgDir);
+}
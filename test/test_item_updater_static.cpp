@@ -1,12 +1,24 @@
+#include "integrity.hpp"
+#include "static/item_updater_static.hpp"
+
+#include <stdlib.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
 #include <string>
+#include <thread>
 #include <utility>
 
 #include <gtest/gtest.h>
 
 using PartClear = std::pair<std::string, bool>;
+using openpower::software::updater::IntegrityRegion;
 namespace utils
 {
 extern std::vector<PartClear> getPartsToClear(const std::string& info);
+extern std::vector<IntegrityRegion> getReadOnlyParts(const std::string& info);
 }
 
 TEST(TestItemUpdaterStatic, getPartsToClearOK)
@@ -186,3 +198,78 @@ ID=28      OTHER_SIDE 0x02000000..0x02008000 (actual=0x00000000) [----RB----]
     EXPECT_EQ("IMA_CATALOG", parts[10].first);
     EXPECT_TRUE(parts[10].second);
 }
+
+TEST(TestItemUpdaterStatic, getReadOnlyPartsOK)
+{
+    constexpr auto info =
+        "TOC@0x00000000 Partitions:\n"
+        "-----------\n"
+        "ID=00        part 0x00000000..0x00002000 (actual=0x00002000) "
+        "[----------]\n"
+        "ID=01        HBEL 0x00008000..0x0002c000 (actual=0x00024000) "
+        "[E-----F-C-]\n"
+        "ID=08         HBB 0x00205000..0x00305000 (actual=0x00100000) "
+        "[EL--R-----]\n"
+        "ID=09         HBD 0x00305000..0x00425000 (actual=0x00120000) "
+        "[EL--------]\n"
+        "ID=23     VERSION 0x02d28000..0x02d2a000 (actual=0x00002000) "
+        "[-L--R-----]\n"
+        "ID=24     IMA_CATALOG 0x01ec6000..0x01ecf000 (actual=0x00009000) "
+        "[E---R-F---]\n"
+        "ID=27     BACKUP_PART 0x01ff8000..0x02000000 (actual=0x00000000) "
+        "[----RB----]\n";
+
+    auto parts = utils::getReadOnlyParts(info);
+    ASSERT_EQ(2, parts.size());
+
+    EXPECT_EQ("HBB", parts[0].name);
+    EXPECT_EQ(0x00205000, parts[0].offset);
+    EXPECT_EQ(0x00100000, parts[0].length);
+    EXPECT_TRUE(parts[0].digest.empty());
+
+    EXPECT_EQ("VERSION", parts[1].name);
+    EXPECT_EQ(0x02d28000, parts[1].offset);
+    EXPECT_EQ(0x00002000, parts[1].length);
+}
+
+TEST(TestItemUpdaterStatic, getReadOnlyPartsNotOK)
+{
+    // Verify the it does not crash on malformed texts
+    constexpr auto info =
+        "0x0308a000..0x0308f000(actual=0x00005000)"
+        "[EL--R-----]\n" // missing ID and name
+        "ID=26     WOFDATA 0x02d8a000..0x0308a000 (actual=0x00300000) "
+        "EL--R-----]\n" // missing [
+        "ID=28        MEMD 0x0309d000..0x0308f000 (actual=0x0000e000) "
+        "[EL--R-----]\n" // end before start
+        "ID=29        SBKT 0x0309d000 (actual=0x00004000) "
+        "[EL--R-----]\n" // missing end
+        "ID=30        HDAT 0x030a1000..0x030a9000 (actual=0x00008000) "
+        "[EL--R-----]\n"; // The only valid one
+
+    auto parts = utils::getReadOnlyParts(info);
+    ASSERT_EQ(1, parts.size());
+    EXPECT_EQ("HDAT", parts[0].name);
+}
+
+TEST(TestItemUpdaterStatic, progressReporterStops)
+{
+    using openpower::software::updater::ProgressReporter;
+    using openpower::software::updater::readProgramProgress;
+
+    std::array<char, 15> tmpl{"/tmp/tmpXXXXXX"};
+    std::filesystem::path workdir = mkdtemp(&tmpl[0]);
+    std::atomic<uint64_t> done = 4096;
+    {
+        // The first publish happens as the reporter starts
+        ProgressReporter reporter(workdir, done);
+        for (int i = 0; (i < 100) && !readProgramProgress(workdir); i++)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        EXPECT_EQ(4096, readProgramProgress(workdir).value_or(0));
+    }
+    // The reporter stops and removes its file when destroyed
+    EXPECT_FALSE(readProgramProgress(workdir));
+    std::filesystem::remove_all(workdir);
+}
@@ -0,0 +1,38 @@
+#include "loop_monitor.hpp"
+
+#include <chrono>
+#include <numeric>
+
+#include <gtest/gtest.h>
+
+using openpower::software::updater::DispatchHistogram;
+using namespace std::chrono_literals;
+
+TEST(DispatchHistogram, countsEachDispatchOnce)
+{
+    DispatchHistogram histogram;
+    ASSERT_EQ(DispatchHistogram::bounds.size() + 1,
+              histogram.counts().size());
+
+    histogram.record(0us);
+    histogram.record(999us);
+    histogram.record(1000us);
+    histogram.record(1001us);
+
+    const auto& counts = histogram.counts();
+    EXPECT_EQ(2, counts[0]);
+    EXPECT_EQ(2, counts[1]);
+    EXPECT_EQ(4, std::accumulate(counts.begin(), counts.end(), uint64_t{0}));
+}
+
+TEST(DispatchHistogram, slowestGoPastTheLastBound)
+{
+    DispatchHistogram histogram;
+    histogram.record(4095999us);
+    histogram.record(4096000us);
+    histogram.record(10min);
+
+    const auto& counts = histogram.counts();
+    EXPECT_EQ(1, counts[counts.size() - 2]);
+    EXPECT_EQ(2, counts.back());
+}
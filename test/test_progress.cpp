@@ -0,0 +1,109 @@
+#include "progress.hpp"
+
+#include <chrono>
+
+#include <gtest/gtest.h>
+
+using namespace openpower::software::updater;
+using namespace std::chrono_literals;
+
+namespace
+{
+
+constexpr uint64_t MiB = 1024 * 1024;
+
+} // namespace
+
+TEST(ProgressModel, extrapolatesFromThroughput)
+{
+    auto start = ProgressModel::Clock::now();
+    ProgressModel model({{"write", 100 * MiB}}, {{"write", 10.0 * MiB}},
+                        start);
+
+    EXPECT_DOUBLE_EQ(0, model.fraction(start));
+    EXPECT_EQ(10s, model.remaining(start));
+    EXPECT_NEAR(0.5, model.fraction(start + 5s), 0.01);
+    EXPECT_EQ(5s, model.remaining(start + 5s));
+}
+
+TEST(ProgressModel, stopsShortOfDoneUntilReported)
+{
+    auto start = ProgressModel::Clock::now();
+    ProgressModel model({{"write", 100 * MiB}}, {{"write", 10.0 * MiB}},
+                        start);
+
+    EXPECT_NEAR(0.99, model.fraction(start + 60s), 0.001);
+
+    model.advance(1, 0, start + 60s);
+    EXPECT_DOUBLE_EQ(1, model.fraction(start + 60s));
+    EXPECT_EQ(0s, model.remaining(start + 60s));
+}
+
+TEST(ProgressModel, weightsStagesByBytes)
+{
+    auto start = ProgressModel::Clock::now();
+    ProgressModel model({{"digest", 100 * MiB}, {"write", 300 * MiB}},
+                        {{"digest", 100.0 * MiB}, {"write", 10.0 * MiB}},
+                        start);
+
+    EXPECT_EQ(31s, model.remaining(start));
+    model.advance(1, 150 * MiB, start + 2s);
+    EXPECT_DOUBLE_EQ(0.625, model.fraction(start + 2s));
+    EXPECT_EQ(15s, model.remaining(start + 2s));
+}
+
+TEST(ProgressModel, measuresThroughputWithoutHistory)
+{
+    auto start = ProgressModel::Clock::now();
+    ProgressModel model({{"write", 100 * MiB}}, {}, start);
+
+    model.advance(1, 0, start + 10s);
+    ASSERT_EQ(1, model.throughput().count("write"));
+    EXPECT_NEAR(10.0 * MiB, model.throughput().at("write"), 1);
+}
+
+TEST(ProgressModel, averagesThroughputWithHistory)
+{
+    auto start = ProgressModel::Clock::now();
+    ProgressModel model({{"write", 100 * MiB}}, {{"write", 10.0 * MiB}},
+                        start);
+
+    // 20 MiB/s this time, weighted 0.3 against the history
+    model.advance(1, 0, start + 5s);
+    EXPECT_NEAR(13.0 * MiB, model.throughput().at("write"), 1);
+}
+
+TEST(ProgressModel, skipsShortStages)
+{
+    auto start = ProgressModel::Clock::now();
+    ProgressModel model({{"digest", MiB}, {"write", 100 * MiB}}, {}, start);
+
+    model.advance(1, 0, start + 1s);
+    EXPECT_EQ(0, model.throughput().count("digest"));
+}
+
+TEST(ProgressModel, resumedStageCountsOnlyTheRest)
+{
+    auto start = ProgressModel::Clock::now();
+    ProgressModel model({{"digest", MiB}, {"write", 100 * MiB}},
+                        {{"write", 10.0 * MiB}}, start);
+
+    // The write resumes half way and takes 5s for the other half
+    model.advance(1, 50 * MiB, start);
+    model.advance(2, 0, start + 5s);
+    EXPECT_NEAR(10.0 * MiB, model.throughput().at("write"), 1);
+}
+
+TEST(ProgressModel, measuresStageDurations)
+{
+    auto start = ProgressModel::Clock::now();
+    ProgressModel model({{"digest", MiB}, {"write", 100 * MiB, true}}, {},
+                        start);
+
+    model.advance(1, 0, start + 2s);
+    model.advance(2, 0, start + 7s);
+    ASSERT_EQ(2, model.durations().size());
+    EXPECT_EQ(2s, model.durations()[0]);
+    EXPECT_EQ(5s, model.durations()[1]);
+    EXPECT_TRUE(model.stageList()[1].writes);
+}
@@ -0,0 +1,123 @@
+#include "mmc/shadow.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+#include <gtest/gtest.h>
+
+using namespace openpower::software::updater;
+namespace fs = std::filesystem;
+
+class ShadowTest : public testing::Test
+{
+  protected:
+    void SetUp() override
+    {
+        char dir[] = "/tmp/shadowXXXXXX";
+        hostfw = mkdtemp(dir);
+        fs::create_directories(hostfw / "running");
+        fs::create_directories(hostfw / "side-a");
+        fs::create_directories(hostfw / "side-b");
+    }
+
+    void TearDown() override
+    {
+        fs::remove_all(hostfw);
+    }
+
+    void writeFile(const fs::path& path, const std::string& content)
+    {
+        std::ofstream file(path);
+        file << content;
+    }
+
+    std::string readFile(const fs::path& path)
+    {
+        std::ifstream file(path);
+        std::stringstream content;
+        content << file.rdbuf();
+        return content.str();
+    }
+
+    fs::path hostfw;
+};
+
+TEST_F(ShadowTest, ParsePreserved)
+{
+    constexpr auto toc =
+        "partition01=HBB,0x00020000,0x00120000,00,ECC\n"
+        "partition05=SECBOOT,0x00381000,0x003a5000,00,ECC,PRESERVED\n"
+        "version=1\n"
+        "partition07=GUARD,0x00500000,0x00505000,00,ECC,PRESERVED\n";
+
+    EXPECT_EQ((std::vector<std::string>{"SECBOOT", "GUARD"}),
+              parsePreserved(toc));
+}
+
+TEST_F(ShadowTest, PreservedLids)
+{
+    auto running = hostfw / "running";
+    writeFile(running / "81e00994.lid",
+              "partition01=HBB,0x00020000,0x00120000,00,ECC\n"
+              "partition05=SECBOOT,0x00381000,0x003a5000,00,ECC,PRESERVED\n"
+              "partition07=GUARD,0x00500000,0x00505000,00,ECC,PRESERVED\n");
+    writeFile(running / "81e00600.lid", "hbb");
+    writeFile(running / "81e00700.lid", "secboot");
+    fs::create_symlink("81e00600.lid", running / "HBB");
+    fs::create_symlink("81e00700.lid", running / "SECBOOT");
+
+    // GUARD has no LID in the tree
+    EXPECT_EQ((std::vector<std::string>{"81e00700.lid"}),
+              preservedLids(running));
+}
+
+TEST_F(ShadowTest, SwitchAndRollBack)
+{
+    constexpr auto toc =
+        "partition05=SECBOOT,0x00381000,0x003a5000,00,ECC,PRESERVED\n";
+
+    // Side a runs, with data the host wrote to its preserved partition
+    writeFile(hostfw / "side-a" / "81e00994.lid", toc);
+    writeFile(hostfw / "side-a" / "81e00600.lid", "code-a");
+    writeFile(hostfw / "side-a" / "81e00700.lid", "secboot");
+    writeFile(hostfw / "side-a" / "81e00800.lid", "hbel");
+    fs::copy(hostfw / "side-a", hostfw / "running",
+             fs::copy_options::recursive);
+    writeFile(hostfw / "running" / "81e00700.lid", "hostdat");
+    writeFile(hostfw / "running" / "81e00800.lid", "hdat");
+    writeFile(hostfw / "running" / "partlabel", "a\n");
+    fs::create_symlink("81e00700.lid", hostfw / "running" / "SECBOOT");
+
+    // Side b is written by an update
+    writeFile(hostfw / "side-b" / "81e00994.lid", toc);
+    writeFile(hostfw / "side-b" / "81e00600.lid", "code-b");
+    writeFile(hostfw / "side-b" / "81e00700.lid", "secboot");
+
+    EXPECT_EQ("b", alternateLabel(hostfw));
+    EXPECT_TRUE(populateShadow(hostfw, hostfw / "side-b", "b", {}));
+
+    // Not switched to a side the shadow tree does not hold
+    EXPECT_FALSE(switchShadow(hostfw, "a", hostfw / "side-a"));
+
+    EXPECT_TRUE(switchShadow(hostfw, "b", hostfw / "side-b"));
+    EXPECT_EQ("a", alternateLabel(hostfw));
+    EXPECT_EQ("code-b", readFile(hostfw / "running" / "81e00600.lid"));
+    EXPECT_EQ("hostdat", readFile(hostfw / "running" / "81e00700.lid"));
+    EXPECT_EQ("81e00700.lid",
+              fs::read_symlink(hostfw / "running" / "SECBOOT").string());
+
+    // The tree of side a is kept with what the host wrote to it, it is
+    // only switched back to once its LIDs are compared with the side
+    EXPECT_EQ("code-a", readFile(hostfw / shadowDir / "81e00600.lid"));
+    EXPECT_FALSE(switchShadow(hostfw, "a", hostfw / "side-a"));
+    EXPECT_TRUE(populateShadow(hostfw, hostfw / "side-a", "a", {}));
+    EXPECT_TRUE(switchShadow(hostfw, "a", hostfw / "side-a"));
+    EXPECT_EQ("code-a", readFile(hostfw / "running" / "81e00600.lid"));
+    EXPECT_EQ("hbel", readFile(hostfw / "running" / "81e00800.lid"));
+    EXPECT_EQ("hostdat", readFile(hostfw / "running" / "81e00700.lid"));
+
+    // A side written without the shadow tree is not switched to
+    writeFile(hostfw / "side-b" / "81e00600.lid", "code-c");
+    EXPECT_FALSE(switchShadow(hostfw, "b", hostfw / "side-b"));
+}
@@ -1,9 +1,11 @@
+#include "buffer_pool.hpp"
 #include "image_verify.hpp"
 
 #include <openssl/sha.h>
 
 #include <filesystem>
 #include <string>
+#include <vector>
 
 #include <gtest/gtest.h>
 
@@ -101,6 +103,19 @@ TEST_F(SignatureTest, TestSignatureVerify)
     EXPECT_TRUE(signature->verify());
 }
 
+/** @brief Verify while the workers hold every buffer of the pool, which the
+ *  event loop must not wait for */
+TEST_F(SignatureTest, TestSignatureVerifyWithBusyPool)
+{
+    std::vector<openpower::software::updater::IoBuffer> held;
+    auto& pool = openpower::software::updater::BufferPool::get();
+    while (auto buffer = pool.tryAcquire())
+    {
+        held.push_back(std::move(buffer));
+    }
+    EXPECT_TRUE(signature->verify());
+}
+
 /** @brief Test failure scenario with corrupted signature file*/
 TEST_F(SignatureTest, TestCorruptSignatureFile)
 {
@@ -0,0 +1,116 @@
+#include "executor.hpp"
+#include "task_graph.hpp"
+
+#include <sdeventplus/event.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using namespace openpower::software::updater;
+using namespace std::chrono_literals;
+
+namespace
+{
+
+/** @brief Wait for a condition set by another thread, for at most 5s */
+template <typename Condition>
+bool waitFor(Condition condition)
+{
+    auto deadline = std::chrono::steady_clock::now() + 5s;
+    while (!condition())
+    {
+        if (std::chrono::steady_clock::now() > deadline)
+        {
+            return false;
+        }
+        std::this_thread::sleep_for(1ms);
+    }
+    return true;
+}
+
+} // namespace
+
+TEST(TaskGraph, stepsRunAfterTheirDependencies)
+{
+    auto event = sdeventplus::Event::get_new();
+    Executor executor(event, 4);
+    auto graph = std::make_shared<TaskGraph>();
+
+    std::mutex mutex;
+    std::vector<std::string> order;
+    auto record = [&](const std::string& name) {
+        return [&, name]() {
+            std::lock_guard lock(mutex);
+            order.push_back(name);
+        };
+    };
+    auto a = graph->add("a", record("a"));
+    auto b = graph->add("b", record("b"), {a});
+    graph->add("c", record("c"), {a, b});
+
+    std::vector<StepTiming> timings;
+    graph->run(executor, [&](const auto& result) {
+        timings = result;
+        event.exit(0);
+    });
+    EXPECT_EQ(0, event.loop());
+
+    EXPECT_EQ((std::vector<std::string>{"a", "b", "c"}), order);
+    ASSERT_EQ(3u, timings.size());
+    EXPECT_EQ("a", timings[0].name);
+    EXPECT_EQ("c", timings[2].name);
+}
+
+TEST(TaskGraph, independentStepsRunConcurrently)
+{
+    auto event = sdeventplus::Event::get_new();
+    Executor executor(event, 4);
+    auto graph = std::make_shared<TaskGraph>();
+
+    // Each step waits for the other one to start
+    std::atomic<int> started = 0;
+    std::atomic<bool> overlapped = true;
+    auto step = [&]() {
+        started++;
+        overlapped = overlapped && waitFor([&] { return started == 2; });
+    };
+    graph->add("first", step);
+    graph->add("second", step);
+
+    graph->run(executor, [&](const auto&) { event.exit(0); });
+    EXPECT_EQ(0, event.loop());
+
+    EXPECT_TRUE(overlapped);
+}
+
+TEST(TaskGraph, failedStepDoesNotStopTheGraph)
+{
+    auto event = sdeventplus::Event::get_new();
+    Executor executor(event, 1);
+    auto graph = std::make_shared<TaskGraph>();
+
+    bool ran = false;
+    auto failing =
+        graph->add("failing", []() { throw std::runtime_error("failed"); });
+    graph->add("after", [&]() { ran = true; }, {failing});
+
+    std::vector<StepTiming> timings;
+    graph->run(executor, [&](const auto& result) {
+        timings = result;
+        event.exit(0);
+    });
+    EXPECT_EQ(0, event.loop());
+
+    EXPECT_TRUE(ran);
+    ASSERT_EQ(2u, timings.size());
+    EXPECT_TRUE(timings[0].failed);
+    EXPECT_FALSE(timings[1].failed);
+}
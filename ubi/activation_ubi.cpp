@@ -1,7 +1,10 @@
 #include "activation_ubi.hpp"
 
 #include "item_updater.hpp"
+#include "journal.hpp"
+#include "paths.hpp"
 #include "serialize.hpp"
+#include "volumes.hpp"
 
 #include <phosphor-logging/log.hpp>
 
@@ -40,9 +43,30 @@ auto ActivationUbi::activation(Activations value) -> Activations
             // Enable systemd signals
             subscribeToSystemdSignals();
 
+            // A root hash without its hash tree would have the squashfs
+            // written and mounted unverified
+            auto imageDir = std::filesystem::path(paths::imgDir()) / versionId;
+            auto hasRootHash =
+                std::filesystem::exists(imageDir / squashFSRootHash);
+            if (hasRootHash &&
+                !std::filesystem::exists(imageDir / squashFSHashTree))
+            {
+                log<level::ERR>("The image has a dm-verity root hash but no "
+                                "hash tree",
+                                entry("VERSIONID=%s", versionId.c_str()));
+                activationBlocksTransition.reset(nullptr);
+                activationProgress.reset(nullptr);
+
+                return softwareServer::Activation::activation(
+                    softwareServer::Activation::Activations::Failed);
+            }
+
 #ifdef WANT_SIGNATURE_VERIFY
-            // Validate the signed image.
-            if (!validateSignature(squashFSImage))
+            // Validate the signed image. An image with a dm-verity hash tree
+            // only needs its root hash validated, the squashfs blocks are
+            // then verified by the kernel as they are read from the volume.
+            if (!validateSignature(hasRootHash ? squashFSRootHash
+                                               : squashFSImage))
             {
                 // Cleanup
                 activationBlocksTransition.reset(nullptr);
@@ -106,7 +130,27 @@ void ActivationUbi::startActivation()
     // Since the squashfs image has not yet been loaded to pnor and the
     // RW volumes have not yet been created, we need to start the
     // service files for each of those actions.
+    constexpr auto ubimountService = "obmc-flash-bios-ubimount@";
+    auto ubimountServiceFile =
+        std::string(ubimountService) + versionId + ".service";
+    auto method = bus.new_method_call(SYSTEMD_BUSNAME, SYSTEMD_PATH,
+                                      SYSTEMD_INTERFACE, "StartUnit");
+    method.append(ubimountServiceFile, "replace");
+    bus.call_noreply(method);
+
+    trackProgress();
+}
+
+void ActivationUbi::resumeActivation()
+{
+    subscribeToSystemdSignals();
+    softwareServer::Activation::activation(
+        softwareServer::Activation::Activations::Activating);
+    trackProgress();
+}
 
+void ActivationUbi::trackProgress()
+{
     if (!activationProgress)
     {
         activationProgress = std::make_unique<ActivationProgress>(bus, path);
@@ -118,15 +162,36 @@ void ActivationUbi::startActivation()
             std::make_unique<ActivationBlocksTransition>(bus, path);
     }
 
-    constexpr auto ubimountService = "obmc-flash-bios-ubimount@";
-    auto ubimountServiceFile =
-        std::string(ubimountService) + versionId + ".service";
-    auto method = bus.new_method_call(SYSTEMD_BUSNAME, SYSTEMD_PATH,
-                                      SYSTEMD_INTERFACE, "StartUnit");
-    method.append(ubimountServiceFile, "replace");
-    bus.call_noreply(method);
-
-    activationProgress->progress(10);
+    // The service digests the RO image, writes it and reads it back, the
+    // activation journal tells how far the write got
+    auto size = readOnlyImageSize(versionId);
+    activationProgress->start(
+        {{"ubi-digest", size},
+         {"ubi-write", size, true},
+         {"ubi-verify", size}},
+        [versionId = versionId](ProgressModel& model) {
+            ActivationJournal journal;
+            if (!restoreJournal(versionId, journal))
+            {
+                return;
+            }
+            auto now = ProgressModel::Clock::now();
+            if (journal.stage == ActivationJournal::stageWritten)
+            {
+                model.advance(3, 0, now);
+            }
+            else if (journal.stage == ActivationJournal::stageVerifying)
+            {
+                model.advance(2, 0, now);
+            }
+            else
+            {
+                model.advance(1,
+                              static_cast<uint64_t>(journal.lebsWritten) *
+                                  journal.lebSize,
+                              now);
+            }
+        });
 }
 
 void ActivationUbi::unitStateChange(sdbusplus::message::message& msg)
@@ -145,7 +210,6 @@ void ActivationUbi::unitStateChange(sdbusplus::message::message& msg)
     if (newStateUnit == ubimountServiceFile && newStateResult == "done")
     {
         ubiVolumesCreated = true;
-        activationProgress->progress(activationProgress->progress() + 50);
     }
 
     if (ubiVolumesCreated)
@@ -156,6 +220,8 @@ void ActivationUbi::unitStateChange(sdbusplus::message::message& msg)
     if ((newStateUnit == ubimountServiceFile) &&
         (newStateResult == "failed" || newStateResult == "dependency"))
     {
+        // The volumes are removed by the OnFailure services
+        removeJournal(versionId);
         activation(softwareServer::Activation::Activations::Failed);
     }
 
@@ -164,7 +230,7 @@ void ActivationUbi::unitStateChange(sdbusplus::message::message& msg)
 
 void ActivationUbi::finishActivation()
 {
-    activationProgress->progress(90);
+    activationProgress->finish();
 
     // Set Redundancy Priority before setting to Active
     if (!redundancyPriority)
@@ -180,6 +246,11 @@ void ActivationUbi::finishActivation()
 
     ubiVolumesCreated = false;
     unsubscribeFromSystemdSignals();
+    // The RO volume is complete, there is nothing left to recover
+    removeJournal(versionId);
+    // Record the digest of the image written to the read-only volume
+    parent.recordIntegrity(versionId, std::filesystem::path(paths::imgDir()) /
+                                          versionId / squashFSImage);
     // Remove version object from image manager
     deleteImageManagerObject();
     // Create active association
@@ -12,6 +12,8 @@ namespace updater
 {
 
 constexpr auto squashFSImage = "pnor.xz.squashfs";
+constexpr auto squashFSRootHash = "pnor.xz.squashfs.roothash";
+constexpr auto squashFSHashTree = "pnor.xz.squashfs.verity";
 
 class RedundancyPriorityUbi : public RedundancyPriority
 {
@@ -55,6 +57,10 @@ class ActivationUbi : public Activation
     RequestedActivations
         requestedActivation(RequestedActivations value) override;
 
+    /** @brief Follow an activation interrupted by a reboot, whose write the
+     *  item updater restarted, to its end as if it had been started here */
+    void resumeActivation();
+
   private:
     /** @brief Tracks whether the read-only & read-write volumes have been
      *created as part of the activation process. **/
@@ -63,6 +69,10 @@ class ActivationUbi : public Activation
     void unitStateChange(sdbusplus::message::message& msg) override;
     void startActivation() override;
     void finishActivation() override;
+
+    /** @brief Publish the progress of the write, read from the activation
+     *  journal of the mount service */
+    void trackProgress();
 };
 
 } // namespace updater
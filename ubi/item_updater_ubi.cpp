@@ -3,9 +3,13 @@
 #include "item_updater_ubi.hpp"
 
 #include "activation_ubi.hpp"
+#include "history.hpp"
+#include "journal.hpp"
+#include "paths.hpp"
 #include "serialize.hpp"
 #include "utils.hpp"
 #include "version.hpp"
+#include "volumes.hpp"
 #include "xyz/openbmc_project/Common/error.hpp"
 
 #include <phosphor-logging/elog-errors.hpp>
@@ -14,7 +18,10 @@
 
 #include <filesystem>
 #include <fstream>
+#include <map>
 #include <queue>
+#include <set>
+#include <sstream>
 #include <string>
 
 namespace openpower
@@ -55,19 +62,43 @@ std::unique_ptr<Version> ItemUpdaterUbi::createVersionObject(
     return version;
 }
 
+std::unique_ptr<RedundancyPriority>
+    ItemUpdaterUbi::createRedundancyPriorityObject(const std::string& path,
+                                                   Activation& activation,
+                                                   uint8_t priority)
+{
+    return std::make_unique<RedundancyPriorityUbi>(bus, path, activation,
+                                                   priority);
+}
+
 bool ItemUpdaterUbi::validateImage(const std::string& path)
 {
     return validateSquashFSImage(path) == 0;
 }
 
+std::filesystem::path
+    ItemUpdaterUbi::imageFile(const std::filesystem::path& imageDir) const
+{
+    return imageDir / squashFSImage;
+}
+
 void ItemUpdaterUbi::processPNORImage()
 {
+    // Deal with the activations interrupted by a reboot first, so that
+    // their half written volumes are not taken for broken versions.
+    recoverActivations();
+
+    // A resumed version is published once its volume is mounted, which the
+    // snapshot cannot tell, so only use the snapshot when nothing resumes.
+    if (recovering.empty() && restoreDiscovered(discoveryFingerprint()))
+    {
+        return;
+    }
+
     // Read pnor.toc from folders under /media/
     // to get Active Software Versions.
     for (const auto& iter : std::filesystem::directory_iterator(MEDIA_DIR))
     {
-        auto activationState = server::Activation::Activations::Active;
-
         static const auto PNOR_RO_PREFIX_LEN = strlen(PNOR_RO_PREFIX);
         static const auto PNOR_RW_PREFIX_LEN = strlen(PNOR_RW_PREFIX);
 
@@ -78,100 +109,372 @@ void ItemUpdaterUbi::processPNORImage()
             // The versionId is extracted from the path
             // for example /media/pnor-ro-2a1022fe.
             auto id = iter.path().native().substr(PNOR_RO_PREFIX_LEN);
-            auto pnorTOC = iter.path() / PNOR_TOC_FILE;
-            if (!std::filesystem::is_regular_file(pnorTOC))
+            if (!recovering.contains(id))
             {
-                log<level::ERR>("Failed to read pnorTOC.",
-                                entry("FILENAME=%s", pnorTOC.c_str()));
-                ItemUpdaterUbi::erase(id);
-                continue;
+                discoverVersion(id);
             }
-            auto keyValues = Version::getValue(
-                pnorTOC, {{"version", ""}, {"extended_version", ""}});
-            auto& version = keyValues.at("version");
-            if (version.empty())
+        }
+        else if (0 == iter.path().native().compare(0, PNOR_RW_PREFIX_LEN,
+                                                   PNOR_RW_PREFIX))
+        {
+            auto id = iter.path().native().substr(PNOR_RW_PREFIX_LEN);
+            auto roDir = PNOR_RO_PREFIX + id;
+            if (!std::filesystem::is_directory(roDir) &&
+                !recovering.contains(id))
             {
-                log<level::ERR>("Failed to read version from pnorTOC",
-                                entry("FILENAME=%s", pnorTOC.c_str()));
-                activationState = server::Activation::Activations::Invalid;
+                log<level::ERR>("No corresponding read-only volume found.",
+                                entry("DIRNAME=%s", roDir.c_str()));
+                ItemUpdaterUbi::erase(id);
             }
+        }
+    }
+
+    // Look at the RO symlink to determine if there is a functional image
+    discoveredFunctionalId = determineId(PNOR_RO_ACTIVE_PATH);
+
+    // Fingerprint the state left by the discovery, which may have erased
+    // broken versions.
+    storeDiscovered(recovering.empty() ? discoveryFingerprint()
+                                      : std::string{});
+}
 
-            auto& extendedVersion = keyValues.at("extended_version");
-            if (extendedVersion.empty())
+void ItemUpdaterUbi::discoverVersion(const std::string& id)
+{
+    auto activationState = server::Activation::Activations::Active;
+    auto pnorTOC = std::filesystem::path(PNOR_RO_PREFIX + id) / PNOR_TOC_FILE;
+    if (!std::filesystem::is_regular_file(pnorTOC))
+    {
+        log<level::ERR>("Failed to read pnorTOC.",
+                        entry("FILENAME=%s", pnorTOC.c_str()));
+        ItemUpdaterUbi::erase(id);
+        return;
+    }
+    auto keyValues =
+        Version::getValue(pnorTOC, {{"version", ""}, {"extended_version", ""}});
+    auto& version = keyValues.at("version");
+    if (version.empty())
+    {
+        log<level::ERR>("Failed to read version from pnorTOC",
+                        entry("FILENAME=%s", pnorTOC.c_str()));
+        activationState = server::Activation::Activations::Invalid;
+    }
+
+    auto& extendedVersion = keyValues.at("extended_version");
+    if (extendedVersion.empty())
+    {
+        log<level::ERR>("Failed to read extendedVersion from pnorTOC",
+                        entry("FILENAME=%s", pnorTOC.c_str()));
+        activationState = server::Activation::Activations::Invalid;
+    }
+
+    uint8_t priority = std::numeric_limits<uint8_t>::max();
+    if ((activationState == server::Activation::Activations::Active) &&
+        !restoreFromFile(id, priority))
+    {
+        log<level::ERR>("Unable to restore priority from file.",
+                        entry("VERSIONID=%s", id.c_str()));
+    }
+
+    // The D-Bus objects are created by publishPNORImages()
+    discovered.push_back(
+        {id, version, extendedVersion, activationState, priority});
+}
+
+std::string ItemUpdaterUbi::discoveryFingerprint()
+{
+    static const auto PNOR_RO_PREFIX_LEN = strlen(PNOR_RO_PREFIX);
+
+    // The version id is a hash of the version string, so the same volumes
+    // mounted in the same places hold the same versions. Only the
+    // priorities and the functional version can change underneath them.
+    // The device numbers of the mounts are left out, the ubiblock, dm and
+    // anonymous ubifs ones change across reboots.
+    std::map<std::string, std::string> mounts;
+    std::ifstream mountInfo("/proc/self/mountinfo");
+    std::string line;
+    while (std::getline(mountInfo, line))
+    {
+        // Each line looks like
+        // 36 25 254:0 / /media/pnor-ro-2a1022fe ro,relatime - squashfs
+        // /dev/mapper/pnor-ro-2a1022fe ro
+        auto separator = line.find(" - ");
+        if (separator == std::string::npos)
+        {
+            continue;
+        }
+        std::istringstream fields(line.substr(0, separator));
+        std::string mountId, parentId, devNum, root, mountPoint;
+        fields >> mountId >> parentId >> devNum >> root >> mountPoint;
+        std::istringstream superFields(line.substr(separator + 3));
+        std::string fsType;
+        superFields >> fsType;
+        mounts[mountPoint] = fsType;
+    }
+
+    Digest digest;
+    auto add = [&digest](const std::string& value) {
+        digest.update(value.data(), value.size());
+        digest.update("\n", 1);
+    };
+
+    // The volume ids only change when the volumes are recreated
+    std::map<std::string, int32_t> volumes;
+    auto pnor = findPnorMtd();
+    if (pnor >= 0)
+    {
+        for (const auto& volume : listVolumes(pnor))
+        {
+            volumes[volume.name] = volume.id;
+        }
+    }
+    for (const auto& [name, id] : volumes)
+    {
+        add(name + ' ' + std::to_string(id));
+    }
+
+    std::set<std::string> entries;
+    for (const auto& iter : std::filesystem::directory_iterator(MEDIA_DIR))
+    {
+        const auto& path = iter.path().native();
+        if ((path.compare(0, PNOR_RO_PREFIX_LEN, PNOR_RO_PREFIX) == 0) ||
+            (path.compare(0, strlen(PNOR_RW_PREFIX), PNOR_RW_PREFIX) == 0))
+        {
+            entries.insert(path);
+        }
+    }
+    for (const auto& entry : entries)
+    {
+        add(entry);
+        auto mount = mounts.find(entry);
+        add(mount != mounts.end() ? mount->second : "unmounted");
+
+        if (entry.compare(0, PNOR_RO_PREFIX_LEN, PNOR_RO_PREFIX) == 0)
+        {
+            std::error_code ec;
+            auto priorityFile = std::filesystem::path(paths::persistDir()) /
+                                entry.substr(PNOR_RO_PREFIX_LEN);
+            auto mtime = std::filesystem::last_write_time(priorityFile, ec);
+            if (ec)
             {
-                log<level::ERR>("Failed to read extendedVersion from pnorTOC",
-                                entry("FILENAME=%s", pnorTOC.c_str()));
-                activationState = server::Activation::Activations::Invalid;
+                add("no priority");
+                continue;
             }
+            std::ifstream priority(priorityFile);
+            std::stringstream content;
+            content << priority.rdbuf();
+            add(std::to_string(mtime.time_since_epoch().count()) + ' ' +
+                content.str());
+        }
+    }
 
-            auto purpose = server::Version::VersionPurpose::Host;
-            auto path = std::filesystem::path(SOFTWARE_OBJPATH) / id;
-            AssociationList associations = {};
+    // The links to the functional version
+    for (const auto& link :
+         {PNOR_RO_ACTIVE_PATH, PNOR_RW_ACTIVE_PATH, PNOR_PRSV_ACTIVE_PATH})
+    {
+        std::error_code ec;
+        add(std::filesystem::read_symlink(link, ec).string());
+    }
+    return digest.final();
+}
 
-            if (activationState == server::Activation::Activations::Active)
-            {
-                // Create an association to the host inventory item
-                associations.emplace_back(std::make_tuple(
-                    ACTIVATION_FWD_ASSOCIATION, ACTIVATION_REV_ASSOCIATION,
-                    HOST_INVENTORY_PATH));
+void ItemUpdaterUbi::recoverActivations()
+{
+    for (const auto& id : listJournals())
+    {
+        ActivationJournal journal;
+        if (!restoreJournal(id, journal))
+        {
+            continue;
+        }
 
-                // Create an active association since this image is active
-                createActiveAssociation(path);
-            }
+        // Digesting the image takes seconds, the volumes of the version are
+        // left alone by the discovery until it tells what to do with them.
+        recovering.insert(id);
+        auto matches = std::make_shared<bool>(false);
+        executor.post(
+            [id, digest = journal.imageDigest, matches](std::stop_token) {
+                uint64_t size = 0;
+                *matches = (digestReadOnlyImage(id, size) == digest);
+            },
+            [this, id, matches]() { recoverActivation(id, *matches); });
+    }
+}
 
-            // All updateable firmware components must expose the updateable
-            // association.
-            createUpdateableAssociation(path);
+void ItemUpdaterUbi::recoverActivation(const std::string& id,
+                                       bool imageMatches)
+{
+    recovering.erase(id);
+
+    // The version may have been deleted meanwhile
+    ActivationJournal journal;
+    if (!restoreJournal(id, journal))
+    {
+        return;
+    }
+
+    if (imageMatches)
+    {
+        // The image is still in IMG_DIR, the mount service picks the
+        // write up from the journal.
+        log<level::INFO>("Resuming the interrupted activation",
+                         entry("VERSIONID=%s", id.c_str()));
+        resumeActivation(id);
+        return;
+    }
 
-            // Create Activation instance for this version.
-            activations.insert(
-                std::make_pair(id, std::make_unique<ActivationUbi>(
-                                       bus, path, *this, id, extendedVersion,
-                                       activationState, associations)));
+    if ((journal.stage == ActivationJournal::stageWritten) &&
+        std::filesystem::is_regular_file(
+            std::filesystem::path(PNOR_RO_PREFIX + id) / PNOR_TOC_FILE))
+    {
+        // Only the end of the activation was lost, keep the version
+        removeJournal(id);
+        discoverVersion(id);
+        publishPNORImages();
+        return;
+    }
+
+    log<level::INFO>("Rolling back the interrupted activation",
+                     entry("VERSIONID=%s", id.c_str()));
+    rollBackActivation(id);
+}
 
-            // If Active, create RedundancyPriority instance for this version.
-            if (activationState == server::Activation::Activations::Active)
+void ItemUpdaterUbi::resumeActivation(const std::string& id)
+{
+    auto upload = activations.find(id);
+    if ((upload != activations.end()) &&
+        (upload->second->activation() !=
+         server::Activation::Activations::Ready))
+    {
+        // The upload was activated again meanwhile, its mount service
+        // resumes the write itself
+        return;
+    }
+
+    if (!resumeSignals)
+    {
+        resumeSignals = std::make_unique<sdbusplus::bus::match_t>(
+            bus,
+            MatchRules::type::signal() + MatchRules::member("JobRemoved") +
+                MatchRules::path(SYSTEMD_PATH) +
+                MatchRules::interface(SYSTEMD_INTERFACE),
+            std::bind(std::mem_fn(&ItemUpdaterUbi::resumeStateChange), this,
+                      std::placeholders::_1));
+
+        auto subscribe = bus.new_method_call(SYSTEMD_BUSNAME, SYSTEMD_PATH,
+                                             SYSTEMD_INTERFACE, "Subscribe");
+        try
+        {
+            bus.call_noreply(subscribe);
+        }
+        catch (const sdbusplus::exception::exception& e)
+        {
+            // Already subscribed is fine
+        }
+    }
+
+    auto method = bus.new_method_call(SYSTEMD_BUSNAME, SYSTEMD_PATH,
+                                      SYSTEMD_INTERFACE, "StartUnit");
+    method.append("obmc-flash-bios-ubimount@" + id + ".service", "replace");
+    bus.call_noreply(method);
+
+    if (upload != activations.end())
+    {
+        // The image manager object of the upload is still there, its
+        // Activation follows the write rather than a second one
+        static_cast<ActivationUbi&>(*upload->second).resumeActivation();
+        return;
+    }
+    resuming.insert(id);
+}
+
+void ItemUpdaterUbi::createActivation(sdbusplus::message::message& msg)
+{
+    ItemUpdater::createActivation(msg);
+
+    // An upload whose write is being resumed takes the write over, rather
+    // than staying Ready until the resumed version is published next to it
+    for (auto id = resuming.begin(); id != resuming.end();)
+    {
+        auto upload = activations.find(*id);
+        if ((upload == activations.end()) ||
+            (upload->second->activation() !=
+             server::Activation::Activations::Ready))
+        {
+            ++id;
+            continue;
+        }
+        static_cast<ActivationUbi&>(*upload->second).resumeActivation();
+        id = resuming.erase(id);
+    }
+}
+
+void ItemUpdaterUbi::rollBackActivation(const std::string& versionId)
+{
+    // The volumes are unmounted and removed by a worker thread, the version
+    // is left alone by the discovery until they are.
+    recovering.insert(versionId);
+    executor.post(
+        [versionId](std::stop_token) {
+            auto pnor = findPnorMtd();
+            if (pnor < 0)
             {
-                uint8_t priority = std::numeric_limits<uint8_t>::max();
-                if (!restoreFromFile(id, priority))
+                return;
+            }
+            auto roDir = PNOR_RO_PREFIX + versionId;
+            auto rwDir = PNOR_RW_PREFIX + versionId;
+            std::vector<UbiVolume> volumes;
+            for (auto& volume : listVolumes(pnor))
+            {
+                if (roDir.ends_with("/" + volume.name) ||
+                    rwDir.ends_with("/" + volume.name))
                 {
-                    log<level::ERR>("Unable to restore priority from file.",
-                                    entry("VERSIONID=%s", id.c_str()));
+                    volumes.push_back(std::move(volume));
                 }
-                activations.find(id)->second->redundancyPriority =
-                    std::make_unique<RedundancyPriorityUbi>(
-                        bus, path, *(activations.find(id)->second), priority);
             }
+            removeVolumes(pnor, volumes);
+        },
+        [this, versionId]() {
+            recovering.erase(versionId);
+            removeJournal(versionId);
+            removeFile(versionId);
+            log<level::INFO>("Rolled back the interrupted activation",
+                             entry("VERSIONID=%s", versionId.c_str()));
+        });
+}
 
-            // Create Version instance for this version.
-            auto versionPtr = std::make_unique<Version>(
-                bus, path, *this, id, version, purpose, "",
-                std::bind(&ItemUpdaterUbi::erase, this, std::placeholders::_1));
-            versionPtr->deleteObject =
-                std::make_unique<Delete>(bus, path, *versionPtr);
-            versions.insert(std::make_pair(id, std::move(versionPtr)));
-        }
-        else if (0 == iter.path().native().compare(0, PNOR_RW_PREFIX_LEN,
-                                                   PNOR_RW_PREFIX))
+void ItemUpdaterUbi::resumeStateChange(sdbusplus::message::message& msg)
+{
+    uint32_t newStateID{};
+    sdbusplus::message::object_path newStateObjPath;
+    std::string newStateUnit{};
+    std::string newStateResult{};
+
+    msg.read(newStateID, newStateObjPath, newStateUnit, newStateResult);
+
+    for (const auto& id : resuming)
+    {
+        if (newStateUnit != "obmc-flash-bios-ubimount@" + id + ".service")
         {
-            auto id = iter.path().native().substr(PNOR_RW_PREFIX_LEN);
-            auto roDir = PNOR_RO_PREFIX + id;
-            if (!std::filesystem::is_directory(roDir))
-            {
-                log<level::ERR>("No corresponding read-only volume found.",
-                                entry("DIRNAME=%s", roDir.c_str()));
-                ItemUpdaterUbi::erase(id);
-            }
+            continue;
         }
-    }
 
-    // Look at the RO symlink to determine if there is a functional image
-    auto id = determineId(PNOR_RO_ACTIVE_PATH);
-    if (!id.empty())
-    {
-        updateFunctionalAssociation(id);
+        removeJournal(id);
+        if (newStateResult == "done")
+        {
+            log<level::INFO>("Resumed activation complete",
+                             entry("VERSIONID=%s", id.c_str()));
+            discoverVersion(id);
+            publishPNORImages();
+        }
+        else
+        {
+            // The volumes are removed by the OnFailure services
+            log<level::ERR>("Resumed activation failed",
+                            entry("VERSIONID=%s", id.c_str()));
+        }
+        resuming.erase(id);
+        return;
     }
-    return;
 }
 
 int ItemUpdaterUbi::validateSquashFSImage(const std::string& filePath)
@@ -212,46 +515,112 @@ void ItemUpdaterUbi::removeReadWritePartition(const std::string& versionId)
 
 void ItemUpdaterUbi::reset()
 {
+    if (resetting)
+    {
+        log<level::INFO>("Factory reset already in progress");
+        return;
+    }
+    resetting = true;
+    utils::rebootGuard(bus, true);
     utils::hiomapdSuspend(bus);
 
-    constexpr static auto patchDir = "/usr/local/share/pnor";
-    if (std::filesystem::is_directory(patchDir))
+    std::vector<std::filesystem::path> rwDirs;
+    for (const auto& it : activations)
+    {
+        rwDirs.emplace_back(PNOR_RW_PREFIX + it.first);
+    }
+
+    // The partitions are cleared by a worker thread, hiomapd is resumed
+    // once they are.
+    auto history = std::make_shared<HistoryEntry>("FactoryReset", "");
+    executor.post(
+        [rwDirs](std::stop_token) {
+            constexpr static auto patchDir = "/usr/local/share/pnor";
+            if (std::filesystem::is_directory(patchDir))
+            {
+                for (const auto& iter :
+                     std::filesystem::directory_iterator(patchDir))
+                {
+                    std::filesystem::remove_all(iter);
+                }
+            }
+
+            // Clear the read-write partitions.
+            for (const auto& rwDir : rwDirs)
+            {
+                if (std::filesystem::is_directory(rwDir))
+                {
+                    for (const auto& iter :
+                         std::filesystem::directory_iterator(rwDir))
+                    {
+                        std::filesystem::remove_all(iter);
+                    }
+                }
+            }
+
+            // Clear the preserved partition, except for SECBOOT that
+            // contains keys provisioned for the system.
+            if (std::filesystem::is_directory(PNOR_PRSV))
+            {
+                for (const auto& iter :
+                     std::filesystem::directory_iterator(PNOR_PRSV))
+                {
+                    auto secbootPartition = "SECBOOT";
+                    if (iter.path().stem() == secbootPartition)
+                    {
+                        continue;
+                    }
+                    std::filesystem::remove_all(iter);
+                }
+            }
+        },
+        [this, history]() {
+            utils::hiomapdResume(bus);
+            utils::rebootGuard(bus, false);
+            resetting = false;
+            history->finish(true);
+        });
+}
+
+std::vector<ScrubTarget> ItemUpdaterUbi::scrubTargets()
+{
+    // Map the UBI volume names to their character devices
+    std::map<std::string, std::filesystem::path> volumes;
+    constexpr auto ubiClassDir = "/sys/class/ubi";
+    std::error_code ec;
+    for (const auto& iter :
+         std::filesystem::directory_iterator(ubiClassDir, ec))
     {
-        for (const auto& iter : std::filesystem::directory_iterator(patchDir))
+        std::ifstream nameFile(iter.path() / "name");
+        std::string name;
+        if (std::getline(nameFile, name))
         {
-            std::filesystem::remove_all(iter);
+            volumes.emplace(name, std::filesystem::path("/dev") /
+                                      iter.path().filename());
         }
     }
 
-    // Clear the read-write partitions.
+    std::vector<ScrubTarget> targets;
     for (const auto& it : activations)
     {
-        auto rwDir = PNOR_RW_PREFIX + it.first;
-        if (std::filesystem::is_directory(rwDir))
+        if (it.second->activation() != server::Activation::Activations::Active)
         {
-            for (const auto& iter : std::filesystem::directory_iterator(rwDir))
-            {
-                std::filesystem::remove_all(iter);
-            }
+            continue;
         }
-    }
 
-    // Clear the preserved partition, except for SECBOOT that contains keys
-    // provisioned for the system.
-    if (std::filesystem::is_directory(PNOR_PRSV))
-    {
-        for (const auto& iter : std::filesystem::directory_iterator(PNOR_PRSV))
+        IntegrityRecord record;
+        auto volume = volumes.find("pnor-ro-" + it.first);
+        if ((volume == volumes.end()) || !restoreIntegrity(it.first, record))
         {
-            auto secbootPartition = "SECBOOT";
-            if (iter.path().stem() == secbootPartition)
-            {
-                continue;
-            }
-            std::filesystem::remove_all(iter);
+            continue;
         }
-    }
 
-    utils::hiomapdResume(bus);
+        for (const auto& region : record.regions)
+        {
+            targets.push_back({it.first, volume->second, region});
+        }
+    }
+    return targets;
 }
 
 bool ItemUpdaterUbi::isVersionFunctional(const std::string& versionId)
@@ -323,6 +692,9 @@ bool ItemUpdaterUbi::erase(std::string entryId)
     // Remove priority persistence file
     removeFile(entryId);
 
+    // Remove the journal of an activation that did not complete
+    removeJournal(entryId);
+
     // Removing read-only and read-write partitions
     removeReadWritePartition(entryId);
     removeReadOnlyPartition(entryId);
@@ -334,24 +706,77 @@ void ItemUpdaterUbi::deleteAll()
 {
     auto chassisOn = isChassisOn();
 
+    // The volumes of the erased versions are removed by their umount
+    // services, only the volumes no version refers to are removed here.
+    auto orphans = findOrphanedVolumes();
+
+    std::vector<std::string> ids;
     for (const auto& activationIt : activations)
     {
         if (isVersionFunctional(activationIt.first) && chassisOn)
         {
             continue;
         }
-        else
+        ids.push_back(activationIt.first);
+    }
+    for (const auto& id : ids)
+    {
+        ItemUpdaterUbi::erase(id);
+    }
+
+    if (!orphans.empty())
+    {
+        // Unmounting and removing the volumes blocks, a worker thread does it
+        executor.post(
+            [orphans](std::stop_token) {
+                removeVolumes(findPnorMtd(), orphans);
+            },
+            [count = orphans.size()]() {
+                log<level::INFO>("Removed the orphaned volumes",
+                                 entry("COUNT=%zu", count));
+            });
+    }
+}
+
+std::vector<UbiVolume> ItemUpdaterUbi::findOrphanedVolumes()
+{
+    std::vector<UbiVolume> orphans;
+    auto pnor = findPnorMtd();
+    if (pnor < 0)
+    {
+        return orphans;
+    }
+
+    static const auto roPrefix =
+        std::string(PNOR_RO_PREFIX).substr(strlen(MEDIA_DIR));
+    static const auto rwPrefix =
+        std::string(PNOR_RW_PREFIX).substr(strlen(MEDIA_DIR));
+
+    // The versions being recovered or resumed, or with a journal, have
+    // volumes still being written and no Activation yet
+    auto writing = recovering;
+    writing.insert(resuming.begin(), resuming.end());
+    for (auto& id : listJournals())
+    {
+        writing.insert(std::move(id));
+    }
+
+    for (auto& volume : listVolumes(pnor))
+    {
+        for (const auto& prefix : {roPrefix, rwPrefix})
         {
-            ItemUpdaterUbi::erase(activationIt.first);
+            if (volume.name.rfind(prefix, 0) != 0)
+            {
+                continue;
+            }
+            auto id = volume.name.substr(prefix.size());
+            if (!activations.contains(id) && !writing.contains(id))
+            {
+                orphans.push_back(volume);
+            }
         }
     }
-
-    // Remove any remaining pnor-ro- or pnor-rw- volumes that do not match
-    // the current version.
-    auto method = bus.new_method_call(SYSTEMD_BUSNAME, SYSTEMD_PATH,
-                                      SYSTEMD_INTERFACE, "StartUnit");
-    method.append("obmc-flash-bios-cleanup.service", "replace");
-    bus.call_noreply(method);
+    return orphans;
 }
 
 // TODO: openbmc/openbmc#1402 Monitor flash usage
@@ -419,11 +844,18 @@ std::string ItemUpdaterUbi::determineId(const std::string& symlinkPath)
 
 void GardResetUbi::reset()
 {
+    if (parent.resetInProgress())
+    {
+        log<level::ERR>("Factory reset in progress, GARD reset rejected");
+        return;
+    }
+
     // The GARD partition is currently misspelled "GUARD." This file path will
     // need to be updated in the future.
     auto path = std::filesystem::path(PNOR_PRSV_ACTIVE_PATH);
     path /= "GUARD";
 
+    HistoryEntry history("GardReset", "");
     utils::hiomapdSuspend(bus);
 
     if (std::filesystem::is_regular_file(path))
@@ -432,6 +864,7 @@ void GardResetUbi::reset()
     }
 
     utils::hiomapdResume(bus);
+    history.finish(true);
 }
 
 } // namespace updater
@@ -1,7 +1,10 @@
 #pragma once
 
 #include "item_updater.hpp"
+#include "volumes.hpp"
 
+#include <memory>
+#include <set>
 #include <string>
 
 namespace openpower
@@ -34,7 +37,7 @@ class ItemUpdaterUbi : public ItemUpdater
         ItemUpdater(bus, path)
     {
         processPNORImage();
-        gardReset = std::make_unique<GardResetUbi>(bus, GARD_PATH);
+        gardReset = std::make_unique<GardResetUbi>(bus, GARD_PATH, *this);
         volatileEnable = std::make_unique<ObjectEnable>(bus, volatilePath);
 
         // Emit deferred signal.
@@ -54,6 +57,8 @@ class ItemUpdaterUbi : public ItemUpdater
 
     bool isVersionFunctional(const std::string& versionId) override;
 
+    std::vector<ScrubTarget> scrubTargets() override;
+
     /** @brief Determine the software version id
      *         from the symlink target (e.g. /media/ro-2a1022fe).
      *
@@ -78,8 +83,17 @@ class ItemUpdaterUbi : public ItemUpdater
                                 Version::VersionPurpose versionPurpose,
                             const std::string& filePath) override;
 
+    std::unique_ptr<RedundancyPriority>
+        createRedundancyPriorityObject(const std::string& path,
+                                       Activation& activation,
+                                       uint8_t priority) override;
+
     bool validateImage(const std::string& path) override;
 
+    /** @brief The squashfs image of an upload */
+    std::filesystem::path
+        imageFile(const std::filesystem::path& imageDir) const override;
+
     /** @brief Host factory reset - clears PNOR partitions for each
      * Activation D-Bus object */
     void reset() override;
@@ -109,6 +123,80 @@ class ItemUpdaterUbi : public ItemUpdater
 
     /** @brief Clears preserved PNOR partition */
     void removePreservedPartition();
+
+    /** @brief Find a version installed on flash from its pnor.toc
+     *
+     * @param[in]  id - The version id of the mounted RO volume.
+     */
+    void discoverVersion(const std::string& id);
+
+    /** @brief Summarize the state the versions are discovered from: the
+     *  names and ids of the UBI volumes, the pnor-ro and pnor-rw mounts, the
+     *  priority files and the functional version links, all of which are
+     *  kept across reboots. Nothing is read from the volumes themselves.
+     *
+     * @return The hex encoded digest of the state
+     */
+    std::string discoveryFingerprint();
+
+    /** @brief Resume or roll back the activations that were interrupted,
+     *  as recorded by their activation journal, once their image is
+     *  digested on the executor. An activation is resumed when its image
+     *  is still in IMG_DIR.
+     */
+    void recoverActivations();
+
+    /** @brief Resume, keep or roll back an interrupted activation
+     *
+     * @param[in]  id           - The id of the interrupted version.
+     * @param[in]  imageMatches - Whether the image in IMG_DIR is the one
+     *                            the journal records.
+     */
+    void recoverActivation(const std::string& id, bool imageMatches);
+
+    /** @brief Restart the write of an interrupted activation, followed by
+     *  the Activation of its upload if there is one
+     *
+     * @param[in]  id - The id of the interrupted version.
+     */
+    void resumeActivation(const std::string& id);
+
+    /** @brief Create the Activation of an upload, which takes over the
+     *  write of its version if it is being resumed */
+    void createActivation(sdbusplus::message::message& msg) override;
+
+    /** @brief Remove the volumes, journal and priority of an interrupted
+     *  activation. The volumes are removed on a worker thread.
+     *
+     * @param[in]  versionId - The id of the version to roll back.
+     */
+    void rollBackActivation(const std::string& versionId);
+
+    /** @brief Callback for the systemd jobs, publishes a version once its
+     *  resumed activation is complete.
+     *
+     * @param[in]  msg       - Data associated with subscribed signal
+     */
+    void resumeStateChange(sdbusplus::message::message& msg);
+
+    /** @brief Versions whose interrupted activation is being resumed,
+     *  with no upload to follow it */
+    std::set<std::string> resuming;
+
+    /** @brief Versions with an activation journal whose image is being
+     *  digested, left alone by the discovery */
+    std::set<std::string> recovering;
+
+    /** @brief Used to subscribe to the systemd signals of the resumed
+     *  activations */
+    std::unique_ptr<sdbusplus::bus::match_t> resumeSignals;
+
+    /** @brief Find the pnor-ro and pnor-rw volumes of no known version
+     *
+     * @return The volumes that do not belong to an Activation, nor to a
+     *         version being recovered, resumed or written
+     */
+    std::vector<UbiVolume> findOrphanedVolumes();
 };
 
 } // namespace updater
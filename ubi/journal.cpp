@@ -0,0 +1,116 @@
+#include "config.h"
+
+#include "journal.hpp"
+
+#include "paths.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cereal/archives/json.hpp>
+#include <cereal/types/string.hpp>
+
+#include <filesystem>
+#include <fstream>
+
+namespace openpower
+{
+namespace software
+{
+namespace updater
+{
+
+namespace fs = std::filesystem;
+
+namespace
+{
+
+constexpr auto journalDir = "journal";
+
+fs::path journalPath(const std::string& versionId)
+{
+    return fs::path(paths::persistDir()) / journalDir / versionId;
+}
+
+} // namespace
+
+template <class Archive>
+void serialize(Archive& archive, ActivationJournal& journal)
+{
+    archive(cereal::make_nvp("stage", journal.stage),
+            cereal::make_nvp("volumeId", journal.volumeId),
+            cereal::make_nvp("imageDigest", journal.imageDigest),
+            cereal::make_nvp("size", journal.size),
+            cereal::make_nvp("lebSize", journal.lebSize),
+            cereal::make_nvp("lebsWritten", journal.lebsWritten));
+}
+
+void storeJournal(const std::string& versionId,
+                  const ActivationJournal& journal)
+{
+    auto path = journalPath(versionId);
+    fs::create_directories(path.parent_path());
+
+    // Write a new file and rename it over the old one, so that a reboot
+    // leaves either the previous or the new journal behind.
+    auto tmpPath = fs::path(path).concat(".tmp");
+    {
+        std::ofstream output(tmpPath.c_str());
+        cereal::JSONOutputArchive archive(output);
+        archive(cereal::make_nvp("journal", journal));
+    }
+    int fd = open(tmpPath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd >= 0)
+    {
+        fsync(fd);
+        close(fd);
+    }
+    fs::rename(tmpPath, path);
+}
+
+bool restoreJournal(const std::string& versionId, ActivationJournal& journal)
+{
+    auto path = journalPath(versionId);
+    if (!fs::exists(path))
+    {
+        return false;
+    }
+
+    std::ifstream input(path.c_str(), std::ios::in);
+    try
+    {
+        cereal::JSONInputArchive archive(input);
+        archive(cereal::make_nvp("journal", journal));
+        return true;
+    }
+    catch (const cereal::RapidJSONException& e)
+    {
+        fs::remove(path);
+    }
+    return false;
+}
+
+void removeJournal(const std::string& versionId)
+{
+    std::error_code ec;
+    fs::remove(journalPath(versionId), ec);
+}
+
+std::vector<std::string> listJournals()
+{
+    std::vector<std::string> versionIds;
+    std::error_code ec;
+    for (const auto& entry : fs::directory_iterator(
+             fs::path(paths::persistDir()) / journalDir, ec))
+    {
+        if (entry.path().extension() != ".tmp")
+        {
+            versionIds.push_back(entry.path().filename());
+        }
+    }
+    return versionIds;
+}
+
+} // namespace updater
+} // namespace software
+} // namespace openpower
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace openpower
+{
+namespace software
+{
+namespace updater
+{
+
+/** @struct ActivationJournal
+ *  @brief Progress of the write of a RO volume, kept until the activation
+ *  completes so that an interrupted write can be resumed or rolled back.
+ */
+struct ActivationJournal
+{
+    /** @brief The RO volume is being written */
+    static constexpr auto stageWriting = "writing";
+
+    /** @brief The RO volume is written and being read back */
+    static constexpr auto stageVerifying = "verifying";
+
+    /** @brief The RO volume is written and verified */
+    static constexpr auto stageWritten = "written";
+
+    /** @brief The activation stage */
+    std::string stage;
+
+    /** @brief The UBI volume id of the RO volume */
+    int32_t volumeId = -1;
+
+    /** @brief The sha256 digest of the data written to the RO volume */
+    std::string imageDigest;
+
+    /** @brief The number of bytes written to the RO volume */
+    uint64_t size = 0;
+
+    /** @brief The logical eraseblock size of the UBI device */
+    uint32_t lebSize = 0;
+
+    /** @brief Number of LEBs known to be fully written */
+    uint32_t lebsWritten = 0;
+};
+
+/** @brief Stores the activation journal of a version
+ *  @param[in] versionId - The version being activated.
+ *  @param[in] journal - The journal.
+ */
+void storeJournal(const std::string& versionId,
+                  const ActivationJournal& journal);
+
+/** @brief Restores the activation journal of a version
+ *  @param[in] versionId - The version being activated.
+ *  @param[out] journal - The journal.
+ *  @return true if a journal was restored
+ */
+bool restoreJournal(const std::string& versionId, ActivationJournal& journal);
+
+/** @brief Removes the activation journal of a version, if it exists.
+ *  @param[in] versionId - The version.
+ */
+void removeJournal(const std::string& versionId);
+
+/** @brief Lists the versions that have an activation journal.
+ *  @return The version ids
+ */
+std::vector<std::string> listJournals();
+
+} // namespace updater
+} // namespace software
+} // namespace openpower
@@ -2,6 +2,8 @@
 
 #include "serialize.hpp"
 
+#include "paths.hpp"
+
 #include <cereal/archives/json.hpp>
 #include <sdbusplus/server.hpp>
 
@@ -19,13 +21,13 @@ void storeToFile(const std::string& versionId, uint8_t priority)
 {
     auto bus = sdbusplus::bus::new_default();
 
-    if (!std::filesystem::is_directory(PERSIST_DIR))
+    if (!std::filesystem::is_directory(paths::persistDir()))
     {
-        std::filesystem::create_directories(PERSIST_DIR);
+        std::filesystem::create_directories(paths::persistDir());
     }
 
     // store one copy in /var/lib/obmc/openpower-pnor-code-mgmt/[versionId]
-    auto varPath = PERSIST_DIR + versionId;
+    auto varPath = paths::persistDir() + versionId;
     std::ofstream varOutput(varPath.c_str());
     cereal::JSONOutputArchive varArchive(varOutput);
     varArchive(cereal::make_nvp("priority", priority));
@@ -50,7 +52,7 @@ void storeToFile(const std::string& versionId, uint8_t priority)
 
 bool restoreFromFile(const std::string& versionId, uint8_t& priority)
 {
-    auto varPath = PERSIST_DIR + versionId;
+    auto varPath = paths::persistDir() + versionId;
     if (std::filesystem::exists(varPath))
     {
         std::ifstream varInput(varPath.c_str(), std::ios::in);
@@ -127,7 +129,7 @@ void removeFile(const std::string& versionId)
     // Note that removeFile() is called in the case of a version being deleted,
     // so the file /media/pnor-rw-[versionId]/[versionId] will also be deleted
     // along with its surrounding directory.
-    std::string path = PERSIST_DIR + versionId;
+    std::string path = paths::persistDir() + versionId;
     if (std::filesystem::exists(path))
     {
         std::filesystem::remove(path);
@@ -0,0 +1,744 @@
+#include "config.h"
+
+#include "volumes.hpp"
+
+#include "activation_ubi.hpp"
+#include "buffer_pool.hpp"
+#include "flash_device.hpp"
+#include "image_verify.hpp"
+#include "integrity.hpp"
+#include "journal.hpp"
+#include "paths.hpp"
+
+#include <fcntl.h>
+#include <mtd/ubi-user.h>
+#include <spawn.h>
+#include <sys/ioctl.h>
+#include <sys/mount.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <phosphor-logging/log.hpp>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <set>
+#include <thread>
+
+extern char** environ;
+
+namespace openpower
+{
+namespace software
+{
+namespace updater
+{
+
+namespace fs = std::filesystem;
+using namespace phosphor::logging;
+
+namespace
+{
+
+/** @brief The dm-verity root hash of each RO volume, with its signature and
+ *  the signed MANIFEST and public key, and the hash tree offset, written by
+ *  obmc-flash-bios when the volume is first mounted.
+ */
+constexpr auto verityDir = "verity";
+
+/** @brief Number of LEBs written between two journal updates. Rewriting
+ *  them after a reboot is harmless since a LEB change is atomic.
+ */
+constexpr uint32_t journalInterval = 16;
+
+std::string readName(const fs::path& path)
+{
+    std::ifstream file(path);
+    std::string name;
+    std::getline(file, name);
+    return name;
+}
+
+bool isFormatted(int mtdNum)
+{
+    auto device = "/dev/mtd" + std::to_string(mtdNum);
+    int fd = open(device.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return false;
+    }
+    std::array<char, 3> magic{};
+    auto rc = read(fd, magic.data(), magic.size());
+    close(fd);
+    return (rc == static_cast<ssize_t>(magic.size())) &&
+           (std::string(magic.data(), magic.size()) == "UBI");
+}
+
+bool attach(int mtdNum)
+{
+    if (fs::exists("/sys/class/ubi/ubi" + std::to_string(mtdNum)))
+    {
+        // Already attached
+        return true;
+    }
+
+    int fd = open("/dev/ubi_ctrl", O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        log<level::ERR>("Failed to open the UBI control device",
+                        entry("ERRNO=%d", errno));
+        return false;
+    }
+
+    struct ubi_attach_req req = {};
+    req.ubi_num = mtdNum;
+    req.mtd_num = mtdNum;
+    auto rc = ioctl(fd, UBI_IOCATT, &req);
+    auto err = errno;
+    close(fd);
+    if ((rc != 0) && (err != EEXIST))
+    {
+        log<level::ERR>("Failed to attach the PNOR to UBI",
+                        entry("MTD=%d", mtdNum), entry("ERRNO=%d", err));
+        return false;
+    }
+    return true;
+}
+
+/** @brief Run a command and wait for it, without a shell
+ *
+ *  @return The exit status of the command, or -1 if it could not be run
+ */
+int run(std::vector<std::string> args)
+{
+    std::vector<char*> argv;
+    for (auto& arg : args)
+    {
+        argv.push_back(arg.data());
+    }
+    argv.push_back(nullptr);
+
+    pid_t pid;
+    if (posix_spawnp(&pid, argv[0], nullptr, nullptr, argv.data(), environ) !=
+        0)
+    {
+        return -1;
+    }
+
+    int status = 0;
+    if ((waitpid(pid, &status, 0) != pid) || !WIFEXITED(status))
+    {
+        return -1;
+    }
+    return WEXITSTATUS(status);
+}
+
+/** @brief Open the dm-verity target of a RO volume from its saved root hash,
+ *  whose signature is checked again since the persistent directory is not
+ *  signed
+ *
+ *  @return The device to mount, which is the block device itself if the
+ *          volume has no hash tree, or empty if the target cannot be opened
+ */
+std::string openVerity(const std::string& name, const std::string& device)
+{
+    auto confDir = fs::path(paths::persistDir()) / verityDir / name;
+    if (!fs::exists(confDir))
+    {
+        return device;
+    }
+
+    std::string rootHash, hashOffset;
+    std::ifstream(confDir / squashFSRootHash) >> rootHash;
+    std::ifstream(confDir / "hashoffset") >> hashOffset;
+    if (rootHash.empty() || hashOffset.empty())
+    {
+        log<level::ERR>("The dm-verity root hash of the RO volume is missing",
+                        entry("VOLUME=%s", name.c_str()));
+        return {};
+    }
+
+#ifdef WANT_SIGNATURE_VERIFY
+    using Signature = openpower::software::image::Signature;
+    Signature signature(confDir, squashFSRootHash,
+                        PNOR_SIGNED_IMAGE_CONF_PATH);
+    if (!signature.verify())
+    {
+        log<level::ERR>("The dm-verity root hash signature of the RO volume "
+                        "is not valid",
+                        entry("VOLUME=%s", name.c_str()));
+        return {};
+    }
+#endif
+
+    auto mapper = "/dev/mapper/" + name;
+    if (!fs::exists(mapper) &&
+        (run({"veritysetup", "open", device, name, device, rootHash,
+              "--hash-offset=" + hashOffset}) != 0))
+    {
+        log<level::ERR>("Unable to open dm-verity target for RO volume",
+                        entry("VOLUME=%s", name.c_str()));
+        return {};
+    }
+    return mapper;
+}
+
+bool mountVolume(int ubiNum, const UbiVolume& volume)
+{
+    auto mountDir = fs::path(MEDIA_DIR) / volume.name;
+    std::error_code ec;
+    fs::create_directories(mountDir, ec);
+
+    int rc = 0;
+    if (volume.name.rfind("pnor-ro-", 0) == 0)
+    {
+        auto volumeDev = "/dev/ubi" + std::to_string(ubiNum) + "_" +
+                         std::to_string(volume.id);
+        int fd = open(volumeDev.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+        {
+            log<level::ERR>("Failed to open the RO volume",
+                            entry("VOLUME=%s", volume.name.c_str()),
+                            entry("ERRNO=%d", errno));
+            return false;
+        }
+        struct ubi_blkcreate_req req = {};
+        rc = ioctl(fd, UBI_IOCVOLCRBLK, &req);
+        auto err = errno;
+        close(fd);
+        if ((rc != 0) && (err != EEXIST))
+        {
+            log<level::ERR>("Failed to create the ubiblock of the RO volume",
+                            entry("VOLUME=%s", volume.name.c_str()),
+                            entry("ERRNO=%d", err));
+            return false;
+        }
+
+        auto mountDev = openVerity(volume.name,
+                                   "/dev/ubiblock" + std::to_string(ubiNum) +
+                                       "_" + std::to_string(volume.id));
+        if (mountDev.empty())
+        {
+            return false;
+        }
+        rc = mount(mountDev.c_str(), mountDir.c_str(), "squashfs", MS_RDONLY,
+                   nullptr);
+    }
+    else
+    {
+        auto source = "ubi" + std::to_string(ubiNum) + ":" + volume.name;
+        rc = mount(source.c_str(), mountDir.c_str(), "ubifs", 0, nullptr);
+    }
+
+    if (rc != 0)
+    {
+        log<level::ERR>("Failed to mount the UBI volume",
+                        entry("VOLUME=%s", volume.name.c_str()),
+                        entry("ERRNO=%d", errno));
+        return false;
+    }
+    return true;
+}
+
+/** @brief The files written to the RO volume of a version, in order */
+std::vector<fs::path> readOnlyImageFiles(const std::string& versionId)
+{
+    auto dir = fs::path(paths::imgDir()) / versionId;
+    std::vector<fs::path> files{dir / squashFSImage};
+    auto hashTree = dir / squashFSHashTree;
+    if (fs::exists(hashTree) && fs::exists(dir / squashFSRootHash))
+    {
+        files.push_back(hashTree);
+    }
+    return files;
+}
+
+/** @brief Read from the RO image files as if they were concatenated */
+bool readImage(const std::vector<fs::path>& files, uint64_t offset, char* data,
+               size_t length)
+{
+    for (const auto& file : files)
+    {
+        std::error_code ec;
+        auto size = fs::file_size(file, ec);
+        if (ec)
+        {
+            return false;
+        }
+        if (offset >= size)
+        {
+            offset -= size;
+            continue;
+        }
+
+        int fd = open(file.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+        {
+            return false;
+        }
+        auto want =
+            static_cast<size_t>(std::min<uint64_t>(length, size - offset));
+        size_t done = 0;
+        while (done < want)
+        {
+            auto rc = pread(fd, data + done, want - done, offset + done);
+            if (rc <= 0)
+            {
+                close(fd);
+                return false;
+            }
+            done += rc;
+        }
+        close(fd);
+
+        data += want;
+        length -= want;
+        offset = 0;
+        if (length == 0)
+        {
+            return true;
+        }
+    }
+    return length == 0;
+}
+
+int32_t createVolume(int ubiNum, const std::string& name, uint64_t size)
+{
+    auto ubiDev = "/dev/ubi" + std::to_string(ubiNum);
+    int fd = open(ubiDev.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return -1;
+    }
+
+    // A dynamic volume, since a static volume can only be written in one go
+    struct ubi_mkvol_req req = {};
+    req.vol_id = UBI_VOL_NUM_AUTO;
+    req.alignment = 1;
+    req.bytes = size;
+    req.vol_type = UBI_DYNAMIC_VOLUME;
+    req.name_len = name.size();
+    name.copy(req.name, UBI_MAX_VOLUME_NAME);
+    auto rc = ioctl(fd, UBI_IOCMKVOL, &req);
+    auto err = errno;
+    close(fd);
+    if (rc != 0)
+    {
+        log<level::ERR>("Failed to create the UBI volume",
+                        entry("VOLUME=%s", name.c_str()),
+                        entry("ERRNO=%d", err));
+        return -1;
+    }
+    return req.vol_id;
+}
+
+} // namespace
+
+uint64_t readOnlyImageSize(const std::string& versionId)
+{
+    uint64_t size = 0;
+    for (const auto& file : readOnlyImageFiles(versionId))
+    {
+        std::error_code ec;
+        auto fileSize = fs::file_size(file, ec);
+        if (!ec)
+        {
+            size += fileSize;
+        }
+    }
+    return size;
+}
+
+std::string digestReadOnlyImage(const std::string& versionId, uint64_t& size)
+{
+    auto files = readOnlyImageFiles(versionId);
+    auto buffer = BufferPool::get().acquire();
+    if (!buffer)
+    {
+        return {};
+    }
+
+    Digest digest;
+    size = 0;
+    for (const auto& file : files)
+    {
+        std::ifstream input(file, std::ios::binary);
+        if (!input)
+        {
+            return {};
+        }
+        while (input.read(buffer.data(), buffer.size()) || input.gcount() > 0)
+        {
+            digest.update(buffer.data(), input.gcount());
+            size += input.gcount();
+        }
+    }
+    return digest.final();
+}
+
+bool writeReadOnlyVolume(const std::string& versionId)
+{
+    auto pnor = findPnorMtd();
+    if (pnor < 0)
+    {
+        log<level::ERR>("Unable to find the PNOR flash device");
+        return false;
+    }
+
+    uint64_t size = 0;
+    auto digest = digestReadOnlyImage(versionId, size);
+    if (digest.empty() || size == 0)
+    {
+        log<level::ERR>("Unable to read the RO image",
+                        entry("VERSIONID=%s", versionId.c_str()));
+        return false;
+    }
+
+    auto name = "pnor-ro-" + versionId;
+    auto volumes = listVolumes(pnor);
+    auto existing = std::find_if(
+        volumes.begin(), volumes.end(),
+        [&name](const auto& volume) { return volume.name == name; });
+
+    ActivationJournal journal;
+    auto resume = restoreJournal(versionId, journal) &&
+                  (journal.imageDigest == digest) && (journal.size == size) &&
+                  (existing != volumes.end()) &&
+                  (existing->id == journal.volumeId);
+    if (resume && (journal.stage == ActivationJournal::stageWritten))
+    {
+        return true;
+    }
+
+    if (resume)
+    {
+        log<level::INFO>("Resuming the interrupted write of the RO volume",
+                         entry("VOLUME=%s", name.c_str()),
+                         entry("LEB=%u", journal.lebsWritten));
+    }
+    else
+    {
+        if (existing != volumes.end())
+        {
+            removeVolumes(pnor, {*existing});
+        }
+
+        uint32_t lebSize = 0;
+        std::ifstream lebSizeFile("/sys/class/ubi/ubi" + std::to_string(pnor) +
+                                  "/eraseblock_size");
+        lebSizeFile >> lebSize;
+        if (lebSize == 0)
+        {
+            log<level::ERR>("Unable to get the UBI LEB size");
+            return false;
+        }
+
+        journal = {};
+        journal.stage = ActivationJournal::stageWriting;
+        journal.imageDigest = digest;
+        journal.size = size;
+        journal.lebSize = lebSize;
+        journal.volumeId = createVolume(pnor, name, size);
+        if (journal.volumeId < 0)
+        {
+            return false;
+        }
+        storeJournal(versionId, journal);
+    }
+
+    // A whole LEB is read into a buffer, to be written in one go
+    auto buffer = BufferPool::get().acquire();
+    if (buffer.size() < journal.lebSize)
+    {
+        log<level::ERR>("The I/O buffers are smaller than the UBI LEB",
+                        entry("LEB_SIZE=%u", journal.lebSize),
+                        entry("BUFFER_SIZE=%zu", buffer.size()));
+        return false;
+    }
+
+    auto volumeDev = "/dev/ubi" + std::to_string(pnor) + "_" +
+                     std::to_string(journal.volumeId);
+    int fd = open(volumeDev.c_str(), O_RDWR | O_CLOEXEC);
+    if (fd < 0)
+    {
+        log<level::ERR>("Failed to open the RO volume",
+                        entry("VOLUME=%s", name.c_str()),
+                        entry("ERRNO=%d", errno));
+        return false;
+    }
+
+    auto files = readOnlyImageFiles(versionId);
+    auto lebs = static_cast<uint32_t>((size + journal.lebSize - 1) /
+                                      journal.lebSize);
+    ProgramStats stats;
+    for (auto lnum = journal.lebsWritten; lnum < lebs; lnum++)
+    {
+        uint64_t offset = static_cast<uint64_t>(lnum) * journal.lebSize;
+        auto bytes = static_cast<int32_t>(
+            std::min<uint64_t>(journal.lebSize, size - offset));
+        if (!readImage(files, offset, buffer.data(), bytes))
+        {
+            log<level::ERR>("Failed to read the RO image",
+                            entry("VERSIONID=%s", versionId.c_str()));
+            close(fd);
+            return false;
+        }
+
+        // An unmapped LEB reads as 0xFF, an erased one needs no write
+        if (isErased(buffer.data(), bytes))
+        {
+            if (ioctl(fd, UBI_IOCEBUNMAP, &lnum) != 0)
+            {
+                log<level::ERR>("Failed to unmap the RO volume LEB",
+                                entry("VOLUME=%s", name.c_str()),
+                                entry("LEB=%u", lnum),
+                                entry("ERRNO=%d", errno));
+                close(fd);
+                return false;
+            }
+            stats.skipped += bytes;
+        }
+        else
+        {
+            // The LEB change only takes effect once all its bytes are
+            // written, a LEB is never left half written.
+            struct ubi_leb_change_req req = {};
+            req.lnum = lnum;
+            req.bytes = bytes;
+            if ((ioctl(fd, UBI_IOCEBCH, &req) != 0) ||
+                (write(fd, buffer.data(), bytes) != bytes))
+            {
+                log<level::ERR>("Failed to write the RO volume",
+                                entry("VOLUME=%s", name.c_str()),
+                                entry("LEB=%u", lnum),
+                                entry("ERRNO=%d", errno));
+                close(fd);
+                return false;
+            }
+            stats.written += bytes;
+        }
+
+        if (((lnum + 1) % journalInterval) == 0)
+        {
+            journal.lebsWritten = lnum + 1;
+            storeJournal(versionId, journal);
+        }
+    }
+    close(fd);
+
+    // The read back is a progress stage of its own, a write resumed from
+    // here only reads back
+    journal.stage = ActivationJournal::stageVerifying;
+    journal.lebsWritten = lebs;
+    storeJournal(versionId, journal);
+
+    // Returned before the read back, which takes a buffer of its own
+    buffer = {};
+    if (digestRange(volumeDev, 0, size) != digest)
+    {
+        log<level::ERR>("The RO volume does not match the image",
+                        entry("VOLUME=%s", name.c_str()));
+        removeJournal(versionId);
+        removeVolumes(pnor, {{journal.volumeId, name}});
+        return false;
+    }
+
+    log<level::INFO>("Wrote the RO volume", entry("VOLUME=%s", name.c_str()),
+                     entry("WRITTEN=%llu",
+                           static_cast<unsigned long long>(stats.written)),
+                     entry("SKIPPED=%llu",
+                           static_cast<unsigned long long>(stats.skipped)));
+
+    journal.stage = ActivationJournal::stageWritten;
+    journal.lebsWritten = lebs;
+    storeJournal(versionId, journal);
+    return true;
+}
+
+int findPnorMtd()
+{
+    std::error_code ec;
+    for (const auto& entry : fs::directory_iterator("/sys/class/mtd", ec))
+    {
+        if (readName(entry.path() / "name") == "pnor")
+        {
+            auto mtd = entry.path().filename().string();
+            if (mtd.rfind("mtd", 0) == 0 &&
+                mtd.find_first_not_of("0123456789", 3) == std::string::npos)
+            {
+                return std::stoi(mtd.substr(3));
+            }
+        }
+    }
+    return -1;
+}
+
+std::vector<UbiVolume> listVolumes(int ubiNum)
+{
+    std::vector<UbiVolume> volumes;
+    auto prefix = "ubi" + std::to_string(ubiNum) + "_";
+
+    std::error_code ec;
+    for (const auto& entry : fs::directory_iterator("/sys/class/ubi", ec))
+    {
+        auto node = entry.path().filename().string();
+        if (node.rfind(prefix, 0) != 0)
+        {
+            continue;
+        }
+        auto id = node.substr(prefix.size());
+        if (id.empty() || id.find_first_not_of("0123456789") != id.npos)
+        {
+            continue;
+        }
+        volumes.push_back({std::stoi(id), readName(entry.path() / "name")});
+    }
+    return volumes;
+}
+
+void removeVolumes(int ubiNum, const std::vector<UbiVolume>& volumes)
+{
+    std::vector<int32_t> ids;
+    for (const auto& volume : volumes)
+    {
+        auto mountDir = fs::path(MEDIA_DIR) / volume.name;
+        if ((umount2(mountDir.c_str(), 0) != 0) && (errno != EINVAL) &&
+            (errno != ENOENT))
+        {
+            log<level::ERR>("Failed to unmount the UBI volume, keeping it",
+                            entry("VOLUME=%s", volume.name.c_str()),
+                            entry("ERRNO=%d", errno));
+            continue;
+        }
+
+        if (volume.name.rfind("pnor-ro-", 0) == 0)
+        {
+            if (fs::exists("/dev/mapper/" + volume.name))
+            {
+                run({"veritysetup", "close", volume.name});
+            }
+            std::error_code ec;
+            fs::remove_all(
+                fs::path(paths::persistDir()) / verityDir / volume.name, ec);
+
+            auto volumeDev = "/dev/ubi" + std::to_string(ubiNum) + "_" +
+                             std::to_string(volume.id);
+            int fd = open(volumeDev.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd >= 0)
+            {
+                // Fails with ENOENT if there is no ubiblock on the volume
+                ioctl(fd, UBI_IOCVOLRMBLK);
+                close(fd);
+            }
+        }
+
+        std::error_code ec;
+        fs::remove(mountDir, ec);
+        ids.push_back(volume.id);
+    }
+
+    if (ids.empty())
+    {
+        return;
+    }
+
+    auto ubiDev = "/dev/ubi" + std::to_string(ubiNum);
+    int fd = open(ubiDev.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        log<level::ERR>("Failed to open the UBI device",
+                        entry("DEVICE=%s", ubiDev.c_str()),
+                        entry("ERRNO=%d", errno));
+        return;
+    }
+    for (auto id : ids)
+    {
+        if (ioctl(fd, UBI_IOCRMVOL, &id) != 0)
+        {
+            log<level::ERR>("Failed to remove the UBI volume",
+                            entry("VOLUMEID=%d", id), entry("ERRNO=%d", errno));
+        }
+    }
+    close(fd);
+}
+
+bool remountVolumes()
+{
+    auto start = std::chrono::steady_clock::now();
+
+    auto pnor = findPnorMtd();
+    if (pnor < 0 || !isFormatted(pnor))
+    {
+        // Device not formatted as ubi
+        return true;
+    }
+    if (!attach(pnor))
+    {
+        return false;
+    }
+
+    std::set<std::string> mounted;
+    std::ifstream mounts("/proc/mounts");
+    std::string source, target, line;
+    while (mounts >> source >> target && std::getline(mounts, line))
+    {
+        mounted.insert(target);
+    }
+
+    std::vector<UbiVolume> volumes;
+    for (auto& volume : listVolumes(pnor))
+    {
+        ActivationJournal journal;
+        if ((volume.name.rfind("pnor-ro-", 0) == 0) &&
+            restoreJournal(volume.name.substr(strlen("pnor-ro-")), journal) &&
+            (journal.stage != ActivationJournal::stageWritten))
+        {
+            // Partially written, the updater resumes or removes it
+            continue;
+        }
+
+        if ((volume.name == "pnor-prsv" ||
+             volume.name.rfind("pnor-rw-", 0) == 0 ||
+             volume.name.rfind("pnor-ro-", 0) == 0) &&
+            !mounted.contains((fs::path(MEDIA_DIR) / volume.name).string()))
+        {
+            volumes.push_back(std::move(volume));
+        }
+    }
+
+    // The volumes are independent, mounting them concurrently overlaps the
+    // UBIFS journal replays and squashfs superblock reads.
+    std::atomic<bool> success = true;
+    std::vector<std::thread> workers;
+    for (const auto& volume : volumes)
+    {
+        workers.emplace_back([pnor, &volume, &success]() {
+            if (!mountVolume(pnor, volume))
+            {
+                success = false;
+            }
+        });
+    }
+    for (auto& worker : workers)
+    {
+        worker.join();
+    }
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start);
+    log<level::INFO>("Remounted the PNOR UBI volumes",
+                     entry("VOLUMES=%zu", volumes.size()),
+                     entry("ELAPSED_MS=%lld",
+                           static_cast<long long>(elapsed.count())));
+    return success;
+}
+
+} // namespace updater
+} // namespace software
+} // namespace openpower
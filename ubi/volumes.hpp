@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace openpower
+{
+namespace software
+{
+namespace updater
+{
+
+/** @struct UbiVolume
+ *  @brief A volume of the UBI device attached to the PNOR flash.
+ */
+struct UbiVolume
+{
+    /** @brief The volume id, as in /dev/ubi<device>_<id> */
+    int id;
+
+    /** @brief The volume name */
+    std::string name;
+};
+
+/** @brief Get the number of the PNOR MTD device, which is also the number
+ *  the UBI device is attached as.
+ *
+ *  @return The device number, or -1 if there is no PNOR MTD device
+ */
+int findPnorMtd();
+
+/** @brief List the volumes of a UBI device from sysfs
+ *
+ *  @param[in] ubiNum - The UBI device number
+ *
+ *  @return The volumes of the device
+ */
+std::vector<UbiVolume> listVolumes(int ubiNum);
+
+/** @brief Unmount and remove UBI volumes. The ubiblocks and dm-verity
+ *  targets of the RO volumes are removed along with them, and a volume that
+ *  cannot be unmounted is left in place.
+ *
+ *  @param[in] ubiNum  - The UBI device number
+ *  @param[in] volumes - The volumes to remove
+ */
+void removeVolumes(int ubiNum, const std::vector<UbiVolume>& volumes);
+
+/** @brief Get the size of the data a version writes to its RO volume
+ *
+ *  @param[in] versionId - The version, whose image is in IMG_DIR
+ *
+ *  @return The size in bytes, 0 if the image is not there
+ */
+uint64_t readOnlyImageSize(const std::string& versionId);
+
+/** @brief Get the digest of the data a version writes to its RO volume,
+ *  the squashfs image followed by its dm-verity hash tree if it has one
+ *
+ *  @param[in]  versionId - The version, whose image is in IMG_DIR
+ *  @param[out] size      - The size of the data
+ *
+ *  @return The hex encoded sha256 digest, or empty if the image is not there
+ */
+std::string digestReadOnlyImage(const std::string& versionId, uint64_t& size);
+
+/** @brief Create and write the RO volume of a version one LEB at a time,
+ *  keeping an activation journal so that an interrupted write resumes from
+ *  the last LEB known to be written. The volume is read back and verified
+ *  once written.
+ *
+ *  @param[in] versionId - The version, whose image is in IMG_DIR
+ *
+ *  @return true if the RO volume is written and verified
+ */
+bool writeReadOnlyVolume(const std::string& versionId);
+
+/** @brief Attach the PNOR flash to UBI and mount the pnor-ro, pnor-rw and
+ *  pnor-prsv volumes it holds, the volumes being mounted concurrently.
+ *
+ *  @return true if all the volumes are mounted, or if the PNOR flash is not
+ *          formatted as UBI
+ */
+bool remountVolumes();
+
+} // namespace updater
+} // namespace software
+} // namespace openpower
@@ -76,11 +76,26 @@ std::string getService(sdbusplus::bus::bus& bus, const std::string& path,
     }
 }
 
+namespace
+{
+
+/** @brief The suspends of hiomapd not yet resumed */
+unsigned hiomapdSuspends = 0;
+
+} // namespace
+
 void hiomapdSuspend(sdbusplus::bus::bus& bus)
 {
+    if (hiomapdSuspends > 0)
+    {
+        hiomapdSuspends++;
+        return;
+    }
+
     auto service = getService(bus, HIOMAPD_PATH, HIOMAPD_INTERFACE);
     auto method = bus.new_method_call(service.c_str(), HIOMAPD_PATH,
                                       HIOMAPD_INTERFACE, "Suspend");
+    hiomapdSuspends++;
 
     try
     {
@@ -95,6 +110,13 @@ void hiomapdSuspend(sdbusplus::bus::bus& bus)
 
 void hiomapdResume(sdbusplus::bus::bus& bus)
 {
+    if (hiomapdSuspends > 1)
+    {
+        hiomapdSuspends--;
+        return;
+    }
+    hiomapdSuspends = 0;
+
     auto service = getService(bus, HIOMAPD_PATH, HIOMAPD_INTERFACE);
     auto method = bus.new_method_call(service.c_str(), HIOMAPD_PATH,
                                       HIOMAPD_INTERFACE, "Resume");
@@ -112,8 +134,9 @@ void hiomapdResume(sdbusplus::bus::bus& bus)
     }
 }
 
-void setPendingAttributes(sdbusplus::bus::bus& bus, const std::string& attrName,
-                          const std::string& attrValue)
+void setPendingAttributes(
+    sdbusplus::bus::bus& bus,
+    const std::vector<std::pair<std::string, std::string>>& attributes)
 {
     constexpr auto biosConfigPath = "/xyz/openbmc_project/bios_config/manager";
     constexpr auto biosConfigIntf = "xyz.openbmc_project.BIOSConfig.Manager";
@@ -123,8 +146,11 @@ void setPendingAttributes(sdbusplus::bus::bus& bus, const std::string& attrName,
     using PendingAttributesType = std::vector<std::pair<
         std::string, std::tuple<std::string, std::variant<std::string>>>>;
     PendingAttributesType pendingAttributes;
-    pendingAttributes.emplace_back(
-        std::make_pair(attrName, std::make_tuple(dbusAttrType, attrValue)));
+    for (const auto& [attrName, attrValue] : attributes)
+    {
+        pendingAttributes.emplace_back(
+            std::make_pair(attrName, std::make_tuple(dbusAttrType, attrValue)));
+    }
 
     try
     {
@@ -137,22 +163,25 @@ void setPendingAttributes(sdbusplus::bus::bus& bus, const std::string& attrName,
     }
     catch (const sdbusplus::exception::exception& e)
     {
-        log<level::ERR>("Error setting the bios attribute",
-                        entry("ERROR=%s", e.what()),
-                        entry("ATTRIBUTE=%s", attrName.c_str()),
-                        entry("ATTRIBUTE_VALUE=%s", attrValue.c_str()));
+        for (const auto& [attrName, attrValue] : attributes)
+        {
+            log<level::ERR>("Error setting the bios attribute",
+                            entry("ERROR=%s", e.what()),
+                            entry("ATTRIBUTE=%s", attrName.c_str()),
+                            entry("ATTRIBUTE_VALUE=%s", attrValue.c_str()));
+        }
         return;
     }
 }
 
 void clearHMCManaged(sdbusplus::bus::bus& bus)
 {
-    setPendingAttributes(bus, "pvm_hmc_managed", "Disabled");
+    setPendingAttributes(bus, {{"pvm_hmc_managed", "Disabled"}});
 }
 
 void setClearNvram(sdbusplus::bus::bus& bus)
 {
-    setPendingAttributes(bus, "pvm_clear_nvram", "Enabled");
+    setPendingAttributes(bus, {{"pvm_clear_nvram", "Enabled"}});
 }
 
 void deleteAllErrorLogs(sdbusplus::bus::bus& bus)
@@ -175,4 +204,23 @@ void deleteAllErrorLogs(sdbusplus::bus::bus& bus)
     }
 }
 
+void rebootGuard(sdbusplus::bus::bus& bus, bool enable)
+{
+    auto method = bus.new_method_call(SYSTEMD_BUSNAME, SYSTEMD_PATH,
+                                      SYSTEMD_INTERFACE, "StartUnit");
+    method.append(enable ? "reboot-guard-enable.service"
+                         : "reboot-guard-disable.service",
+                  "replace");
+
+    try
+    {
+        bus.call_noreply(method);
+    }
+    catch (const sdbusplus::exception::exception& e)
+    {
+        log<level::ERR>("Error in the reboot guard call",
+                        entry("ERROR=%s", e.what()));
+    }
+}
+
 } // namespace utils
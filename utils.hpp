@@ -10,6 +10,8 @@
 #include <sdbusplus/bus.hpp>
 
 #include <string>
+#include <utility>
+#include <vector>
 
 extern "C"
 {
@@ -33,18 +35,29 @@ namespace utils
 std::string getService(sdbusplus::bus::bus& bus, const std::string& path,
                        const std::string& intf);
 
-/** @brief Suspend hiomapd.
+/** @brief Suspend hiomapd. Only the first of nested suspends reaches
+ *  hiomapd. Called on the event loop.
  *
  * @param[in] bus - The D-Bus bus object.
  */
 void hiomapdSuspend(sdbusplus::bus::bus& bus);
 
-/** @brief Resume hiomapd.
+/** @brief Resume hiomapd. Only the last of nested suspends resumes it.
+ *  Called on the event loop.
  *
  * @param[in] bus - The D-Bus bus object.
  */
 void hiomapdResume(sdbusplus::bus::bus& bus);
 
+/** @brief Set BIOS pending attributes, all in one property update.
+ *
+ * @param[in] bus        - The D-Bus bus object.
+ * @param[in] attributes - The enumeration attributes and their values.
+ */
+void setPendingAttributes(
+    sdbusplus::bus::bus& bus,
+    const std::vector<std::pair<std::string, std::string>>& attributes);
+
 /** @brief Set the Hardware Management Console Managed bios attribute to
  *         Disabled to clear the indication that the system is HMC-managed.
  *
@@ -65,6 +78,14 @@ void setClearNvram(sdbusplus::bus::bus& bus);
  */
 void deleteAllErrorLogs(sdbusplus::bus::bus& bus);
 
+/** @brief Enable or disable the guard preventing the BMC from rebooting
+ *         while host firmware files are being modified.
+ *
+ * @param[in] bus    - The D-Bus bus object.
+ * @param[in] enable - Whether to enable the guard.
+ */
+void rebootGuard(sdbusplus::bus::bus& bus, bool enable);
+
 } // namespace utils
 
 #endif // OPENSSL_VERSION_NUMBER < 0x10100000L